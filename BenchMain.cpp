@@ -0,0 +1,55 @@
+#include<iostream>
+#include<string>
+
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include<stb/stb_image.h>
+
+#include "Benchmark.h"
+#include "BenchSuite.h"
+#include "GLExt.h"
+
+// Entry point of graphics-bench: the benchmark suite, or "--bench <name>" for one of the
+// microbenchmarks "Graphics --bench <name>" runs
+int main(int argc, char** argv) {
+	std::string benchName;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--bench")
+			benchName = argv[i + 1];
+	}
+	if (benchName.empty()) {
+		// Every argument belongs to the suite here
+		SuiteOptions suite;
+		suite.enabled = true;
+		if (!suite.parse(argc, argv))
+			return -1;
+		if (suite.help)
+			return 0;
+		return runBenchSuite(suite);
+	}
+	if (!benchmarkNeedsGL(benchName))
+		return runBenchmark(benchName, nullptr);
+
+	// The GL microbenchmarks draw to a window, like in the app
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow* window = glfwCreateWindow(1200, 1200, "Benchmark", NULL, NULL);
+	if (window == NULL) {
+		std::cout << "Failed to create GLFW Window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	gladLoadGL();
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	stbi_set_flip_vertically_on_load(true);
+	glViewport(0, 0, 1200, 1200);
+	glEnable(GL_DEPTH_TEST);
+
+	int result = runBenchmark(benchName, window);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return result;
+}
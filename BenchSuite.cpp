@@ -0,0 +1,990 @@
+#include"BenchSuite.h"
+
+#include<glad/glad.h>
+#include<algorithm>
+#include<cctype>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<iomanip>
+#include<iostream>
+#include<memory>
+#include<random>
+#include<sstream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "GLExt.h"
+#include "Headless.h"
+#include "JobSystem.h"
+#include "Object.h"
+#include "Profiler.h"
+#include "Renderer.h"
+#include "GLStats.h"
+#include "ShaderCache.h"
+#include "StaticBatcher.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include<windows.h>
+#include<psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif !defined(__linux__)
+#include<sys/resource.h>
+#endif
+
+// Free video memory, neither extension is in glad's 3.3 core header
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+// Dynamic lights of every scenario, the editor's default
+#define SUITE_LIGHTS 64
+// Scene clock step, independent of how fast frames actually render
+#define SUITE_TIME_STEP (1.0f / 60.0f)
+
+static double msBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool SuiteOptions::parse(int argc, char** argv)
+{
+	static const char* valued[] = { "--scenarios", "--json", "--baseline", "--tolerance", "--seed", "--warmup", "--frames",
+		"--size", "--count", "--textures", "--model", "--camera-path" };
+	std::string unknown;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bench-suite")
+		{
+			enabled = true;
+			continue;
+		}
+		if (arg == "--static-batching")
+		{
+			staticBatching = true;
+			continue;
+		}
+		if (arg == "--no-shader-cache")
+		{
+			shaderCache = false;
+			continue;
+		}
+		if (arg == "--help" || arg == "-h")
+		{
+			help = true;
+			continue;
+		}
+		if (std::find(std::begin(valued), std::end(valued), arg) == std::end(valued))
+		{
+			if (unknown.empty())
+				unknown = arg;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value after " << arg << std::endl;
+			printUsage();
+			return false;
+		}
+		std::string value = argv[++i];
+		if (arg == "--scenarios")
+		{
+			scenarios.clear();
+			std::stringstream list(value);
+			std::string name;
+			while (std::getline(list, name, ','))
+				if (!name.empty())
+					scenarios.push_back(name);
+		}
+		else if (arg == "--json")
+			json = value;
+		else if (arg == "--baseline")
+			baseline = value;
+		else if (arg == "--tolerance")
+			tolerance = std::max(0.0f, (float)atof(value.c_str()));
+		else if (arg == "--seed")
+			seed = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+		else if (arg == "--warmup")
+			warmup = std::max(0, atoi(value.c_str()));
+		else if (arg == "--frames")
+			frames = std::max(1, atoi(value.c_str()));
+		else if (arg == "--size")
+		{
+			if (sscanf(value.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+			{
+				std::cout << "Expected --size WxH, got " << value << std::endl;
+				printUsage();
+				return false;
+			}
+		}
+		else if (arg == "--count")
+			count = std::clamp(atoi(value.c_str()), 1, SUITE_MAX_PRIMITIVES);
+		else if (arg == "--textures")
+			textures = std::clamp(atoi(value.c_str()), 1, MAX_MATERIALS);
+		else if (arg == "--model")
+			model = value;
+		else if (arg == "--camera-path")
+			cameraPath = value;
+	}
+	// The editor's own arguments are none of the suite's business
+	if (!enabled)
+	{
+		help = false;
+		return true;
+	}
+	if (help)
+	{
+		printUsage();
+		return true;
+	}
+	if (!unknown.empty())
+	{
+		std::cout << "Unknown argument " << unknown << std::endl;
+		printUsage();
+		return false;
+	}
+	return true;
+}
+
+void SuiteOptions::printUsage()
+{
+	std::cout << "Usage: graphics-bench [options], or Graphics --bench-suite [options]\n"
+		"  --scenarios a,b     subset to run, default all: primitives, model, textures, flythrough\n"
+		"  --json file         results, default bench_results.json\n"
+		"  --baseline file     results of an earlier run, a regression makes the exit code 1\n"
+		"  --tolerance P       percent a metric may grow before it counts as a regression, default 10\n"
+		"  --seed N            seed of every random placement, default 1\n"
+		"  --warmup N          frames rendered before measuring, default 30\n"
+		"  --frames N          measured frames, default 300\n"
+		"  --size WxH          framebuffer size, default 1280x720\n"
+		"  --count N           cubes and spheres of the primitives scenario, default 2000\n"
+		"  --textures N        distinct textures of the textures scenario, default 256\n"
+		"  --model file        model the model scenario imports, default models/brutalist_interior.glb\n"
+		"  --camera-path file  flythrough keyframes\n"
+		"  --static-batching   merges the meshes of imported models by material\n"
+		"  --no-shader-cache   compiles every program from source\n"
+		"  --help              prints this\n"
+		"graphics-bench --bench <name> runs one microbenchmark instead." << std::endl;
+}
+
+// Distribution of one timing over the measured frames, nearest-rank percentiles
+struct FrameMetric {
+	double mean, p50, p90, p95, p99, max;
+};
+
+static FrameMetric summarize(std::vector<double> values)
+{
+	FrameMetric metric = {};
+	if (values.empty())
+		return metric;
+	std::sort(values.begin(), values.end());
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+	auto rank = [&](double percent) {
+		size_t index = (size_t)std::ceil(percent / 100.0 * values.size());
+		return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+	};
+	metric.mean = sum / values.size();
+	metric.p50 = rank(50.0);
+	metric.p90 = rank(90.0);
+	metric.p95 = rank(95.0);
+	metric.p99 = rank(99.0);
+	metric.max = values.back();
+	return metric;
+}
+
+// Starts a new peak for peakRSSMB(). Only Linux can reset it, elsewhere the peak covers every scenario so far.
+static void resetPeakRSS()
+{
+#if defined(__linux__)
+	// "5" resets VmHWM to the current RSS
+	FILE* file = fopen("/proc/self/clear_refs", "w");
+	if (file)
+	{
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+static double peakRSSMB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	return -1.0;
+#elif defined(__linux__)
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return atof(line.c_str() + 6) / 1024.0;
+	return -1.0;
+#else
+	// Bytes on macOS
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#endif
+}
+
+// Free video memory in KB as the driver reports it, -1 without GL_NVX_gpu_memory_info or GL_ATI_meminfo
+static long long freeVideoMemoryKB()
+{
+	GLint values[4] = { -1, -1, -1, -1 };
+	if (hasGLExtension("GL_NVX_gpu_memory_info"))
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, values);
+	else if (hasGLExtension("GL_ATI_meminfo"))
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, values);
+	return values[0];
+}
+
+// Everything one scenario draws. Built once its context exists, dropped before the context goes.
+struct SuiteScene {
+	std::vector<Object> objects;
+	std::vector<std::unique_ptr<Model>> models;
+	std::vector<glm::mat4> modelTransforms;
+	// Never moves, so it lives in the static shadow caches
+	std::vector<bool> staticModels;
+	std::vector<Light> lights;
+	std::vector<glm::vec3> lightOrigins;
+	LightSrc lightSrc;
+	glm::vec3 lightPos = glm::vec3(7.0f, 7.0f, 0.0f);
+	CameraPath path;
+};
+
+struct ScenarioResult {
+	std::string name;
+	// Empty when the scenario ran
+	std::string error;
+	// Loading phases in order, "total" last
+	std::vector<std::pair<std::string, double>> loadMs;
+	// What was drawn
+	std::vector<std::pair<std::string, long long>> scene;
+	// CPU time to update and submit a frame, GPU time between timestamps around it, and
+	// wall time from one frame to the next with SUITE_FRAMES_IN_FLIGHT frames queued
+	FrameMetric cpu = {}, gpu = {}, frame = {};
+	double peakRSSMB = -1.0;
+	// -1 when the driver doesn't report free memory
+	double gpuMB = -1.0;
+};
+
+// Same scatter the editor uses, the positions only depend on rng
+static void scatterLights(SuiteScene& scene, std::mt19937& rng, int count)
+{
+	std::uniform_real_distribution<float> spread(-15.0f, 15.0f), height(0.2f, 6.0f), unit(0.0f, 1.0f);
+	scene.lights.resize(count);
+	scene.lightOrigins.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		// One draw per statement, argument evaluation order would make the scene compiler dependent
+		float x = spread(rng);
+		float y = height(rng);
+		float z = spread(rng);
+		scene.lightOrigins[i] = glm::vec3(x, y, z);
+		float r = unit(rng);
+		float g = unit(rng);
+		float b = unit(rng);
+		scene.lights[i].pos = scene.lightOrigins[i];
+		scene.lights[i].color = glm::vec3(r, g, b);
+		scene.lights[i].radius = 4.0f;
+		scene.lights[i].intensity = 6.0f;
+		scene.lights[i].type = i % 4 == 3 ? LIGHT_SPOT : LIGHT_POINT;
+	}
+}
+
+// Cubes and spheres from addShape scattered through a 30 x 6 x 30 volume
+static bool buildPrimitives(const SuiteOptions& options, Renderer& /*renderer*/, SuiteScene& scene, std::mt19937& rng, ScenarioResult& result)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::uniform_real_distribution<float> spread(-15.0f, 15.0f), height(0.0f, 6.0f), unit(0.0f, 1.0f), size(0.2f, 0.6f);
+	scene.objects.reserve(options.count);
+	for (int i = 0; i < options.count; i++)
+	{
+		addShape(scene.objects, i % 2);
+		Object& object = scene.objects.back();
+		float x = spread(rng);
+		float y = height(rng);
+		float z = spread(rng);
+		object.pos = glm::vec3(x, y, z);
+		float r = unit(rng);
+		float g = unit(rng);
+		float b = unit(rng);
+		object.col = glm::vec3(r, g, b);
+		object.resize(size(rng));
+		object.angle = unit(rng) * 360.0f;
+	}
+	result.loadMs.push_back({ "scene", msBetween(start, std::chrono::steady_clock::now()) });
+	return true;
+}
+
+// Batching time of the models with --static-batching, the scene's "meshes" count is then the draws after
+static void batchModels(const SuiteOptions& options, const std::vector<Model*>& models, ScenarioResult& result)
+{
+	if (!options.staticBatching)
+		return;
+	double ms = 0.0;
+	for (Model* model : models)
+	{
+		StaticBatcher batcher;
+		batcher.build(*model);
+		ms += batcher.buildMs;
+	}
+	result.loadMs.push_back({ "batching", ms });
+}
+
+// One imported model, timed from the file to packed textures
+static bool buildModel(const SuiteOptions& options, Renderer& renderer, SuiteScene& scene, std::mt19937& /*rng*/, ScenarioResult& result)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<Model> model(new Model(options.model, false, &renderer.materials));
+	auto imported = std::chrono::steady_clock::now();
+	if (model->meshes.empty())
+	{
+		result.error = "failed to load " + options.model;
+		return false;
+	}
+	renderer.materials.build();
+	result.loadMs.push_back({ "import", msBetween(start, imported) });
+	result.loadMs.push_back({ "textures", msBetween(imported, std::chrono::steady_clock::now()) });
+	batchModels(options, { model.get() }, result);
+	scene.models.push_back(std::move(model));
+	scene.modelTransforms.push_back(glm::mat4(1.0f));
+	scene.staticModels.push_back(true);
+	return true;
+}
+
+// A grid of cubes, each with a texture of its own between 32 and 512 pixels square
+static bool buildTextures(const SuiteOptions& options, Renderer& renderer, SuiteScene& scene, std::mt19937& rng, ScenarioResult& result)
+{
+	static const int sizes[] = { 32, 64, 128, 256, 512 };
+	std::uniform_int_distribution<int> pick(0, 4);
+	int side = (int)std::ceil(std::sqrt((double)options.textures));
+
+	auto start = std::chrono::steady_clock::now();
+	MaterialTable& table = renderer.materials;
+	vector<Mesh> meshes;
+	for (int i = 0; i < options.textures; i++)
+	{
+		int size = sizes[pick(rng)];
+		vector<unsigned char> pixels = makeChecker(size, size, (int)(i + options.seed));
+		Material material;
+		material.name = "suite" + std::to_string(i);
+		material.diffuse = table.addTexture(material.name, size, size, pixels.data());
+		table.addMaterial(material);
+		glm::vec3 offset((i % side - side / 2) * 1.5f, 0.5f, (i / side - side / 2) * 1.5f);
+		meshes.push_back(makeCubeMesh(offset, 1.0f));
+		meshes.back().materialIndex = i;
+	}
+	auto generated = std::chrono::steady_clock::now();
+	table.build();
+	result.loadMs.push_back({ "generate", msBetween(start, generated) });
+	result.loadMs.push_back({ "textures", msBetween(generated, std::chrono::steady_clock::now()) });
+	scene.models.emplace_back(new Model(std::move(meshes), &table));
+	scene.modelTransforms.push_back(glm::mat4(1.0f));
+	scene.staticModels.push_back(true);
+	return true;
+}
+
+// Loop through the editor's interior, every key looks at the next one
+static CameraPath flythroughPath()
+{
+	static const glm::vec3 points[] = {
+		glm::vec3(-6.0f, 1.8f, -6.0f), glm::vec3(0.0f, 2.2f, -7.0f), glm::vec3(6.0f, 1.8f, -6.0f),
+		glm::vec3(7.0f, 2.5f, 0.0f), glm::vec3(6.0f, 1.8f, 6.0f), glm::vec3(0.0f, 3.0f, 7.0f),
+		glm::vec3(-6.0f, 1.8f, 6.0f), glm::vec3(-7.0f, 2.5f, 0.0f),
+	};
+	const int count = sizeof(points) / sizeof(points[0]);
+	CameraPath path;
+	path.keys.clear();
+	for (int i = 0; i <= count; i++)
+		path.keys.push_back({ 1.0f * i, points[i % count], points[(i + 1) % count] });
+	return path;
+}
+
+// The editor's scene: the interior, the car, two cubes and a sphere
+static bool buildFlythrough(const SuiteOptions& options, Renderer& renderer, SuiteScene& scene, std::mt19937& /*rng*/, ScenarioResult& result)
+{
+	if (!options.cameraPath.empty() && !scene.path.load(options.cameraPath))
+	{
+		result.error = "failed to load camera path " + options.cameraPath;
+		return false;
+	}
+	if (options.cameraPath.empty())
+		scene.path = flythroughPath();
+
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<Model> car(new Model("models/subaru_impreza.glb", false, &renderer.materials));
+	std::unique_ptr<Model> interior(new Model(options.model, false, &renderer.materials));
+	auto imported = std::chrono::steady_clock::now();
+	if (car->meshes.empty() || interior->meshes.empty())
+	{
+		result.error = "failed to load models/subaru_impreza.glb or " + options.model;
+		return false;
+	}
+	renderer.materials.build();
+	scene.objects.emplace_back(Cube());
+	scene.objects.emplace_back(Cube());
+	scene.objects.emplace_back(Sphere());
+	result.loadMs.push_back({ "import", msBetween(start, imported) });
+	result.loadMs.push_back({ "textures", msBetween(imported, std::chrono::steady_clock::now()) });
+	batchModels(options, { interior.get(), car.get() }, result);
+
+	scene.models.push_back(std::move(interior));
+	scene.modelTransforms.push_back(glm::mat4(1.0f));
+	scene.staticModels.push_back(true);
+	scene.models.push_back(std::move(car));
+	scene.modelTransforms.push_back(glm::scale(glm::mat4(1.0f), glm::vec3(0.007f)));
+	scene.staticModels.push_back(false);
+	return true;
+}
+
+// Snapshot of frame f, only depends on the scene and f
+static void fillFrame(SuiteScene& scene, const Renderer& renderer, FrameSnapshot& frame, int f, float aspect)
+{
+	float time = f * SUITE_TIME_STEP;
+	for (size_t i = 0; i < scene.lights.size(); i++)
+	{
+		float phase = time * 0.5f + i;
+		scene.lights[i].pos = scene.lightOrigins[i] + glm::vec3(cos(phase), 0.0f, sin(phase)) * 2.0f;
+	}
+
+	glm::vec3 eye, target;
+	scene.path.sample(std::fmod(time, std::max(scene.path.keys.back().time, SUITE_TIME_STEP)), eye, target);
+	frame.frame = f;
+	frame.projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+	frame.view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+	frame.viewPos = eye;
+	frame.fov = glm::radians(45.0f);
+	frame.zNear = 0.1f;
+	frame.zFar = 100.0f;
+	frame.lightPos = scene.lightPos;
+	frame.lightColor = glm::vec3(1.0f);
+	frame.background = glm::vec3(0.9f);
+	frame.renderPath = RENDER_FORWARD;
+	const CascadedShadowMap& shadows = renderer.shadows;
+	frame.shadows = { shadows.enabled, shadows.shadowDistance, shadows.splitLambda, shadows.depthBias, shadows.normalBias, false };
+	frame.lights = scene.lights;
+
+	frame.objects.resize(scene.objects.size());
+	jobSystem.parallelFor((int)scene.objects.size(), 64, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			DrawPacket& packet = frame.objects[i];
+			packet = { &scene.objects[i], nullptr, ObjectUniforms(), false };
+			packet.uniforms.model = scene.objects[i].getModelMatrix();
+			packet.uniforms.normalMatrix = normalMatrix(packet.uniforms.model);
+			packet.uniforms.color = glm::vec4(scene.objects[i].col, scene.objects[i].opacity);
+		}
+	});
+
+	frame.models.clear();
+	for (size_t i = 0; i < scene.models.size(); i++)
+	{
+		DrawPacket packet = { nullptr, scene.models[i].get(), ObjectUniforms(), (bool)scene.staticModels[i] };
+		packet.uniforms.model = scene.modelTransforms[i];
+		packet.uniforms.normalMatrix = normalMatrix(scene.modelTransforms[i]);
+		packet.uniforms.color = glm::vec4(1.0f);
+		frame.models.push_back(packet);
+	}
+
+	scene.lightSrc.pos = scene.lightPos;
+	frame.lightSource = { &scene.lightSrc, nullptr, ObjectUniforms(), false };
+	frame.lightSource.uniforms.model = scene.lightSrc.getModelMatrix();
+	frame.lightSource.uniforms.normalMatrix = normalMatrix(frame.lightSource.uniforms.model);
+	frame.lightSource.uniforms.color = glm::vec4(scene.lightSrc.col, 1.0f);
+	frame.clearGui();
+}
+
+// Renders the warmup and measured frames. Fences keep at most SUITE_FRAMES_IN_FLIGHT frames
+// queued, and each frame's timestamps are read once its fence has signalled.
+static void measure(const SuiteOptions& options, Renderer& renderer, SuiteScene& scene, ScenarioResult& result)
+{
+	FrameSnapshot frame;
+	GLuint timeQueries[SUITE_FRAMES_IN_FLIGHT][2];
+	glGenQueries(SUITE_FRAMES_IN_FLIGHT * 2, &timeQueries[0][0]);
+	GLsync fences[SUITE_FRAMES_IN_FLIGHT] = {};
+	std::vector<double> cpuMs, gpuMs, frameMs;
+	float aspect = (float)options.width / (float)options.height;
+	int total = options.warmup + options.frames;
+
+	auto retire = [&](int f) {
+		int slot = f % SUITE_FRAMES_IN_FLIGHT;
+		while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fences[slot]);
+		fences[slot] = nullptr;
+		GLuint64 gpuStart, gpuEnd;
+		glGetQueryObjectui64v(timeQueries[slot][0], GL_QUERY_RESULT, &gpuStart);
+		glGetQueryObjectui64v(timeQueries[slot][1], GL_QUERY_RESULT, &gpuEnd);
+		if (f >= options.warmup)
+			gpuMs.push_back((gpuEnd - gpuStart) / 1.0e6);
+	};
+
+	auto previousStart = std::chrono::steady_clock::now();
+	for (int f = 0; f < total; f++)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+		if (f - 1 >= options.warmup)
+			frameMs.push_back(msBetween(previousStart, frameStart));
+		previousStart = frameStart;
+		if (f >= SUITE_FRAMES_IN_FLIGHT)
+			retire(f - SUITE_FRAMES_IN_FLIGHT);
+
+		auto cpuStart = std::chrono::steady_clock::now();
+		int slot = f % SUITE_FRAMES_IN_FLIGHT;
+		fillFrame(scene, renderer, frame, f, aspect);
+		glQueryCounter(timeQueries[slot][0], GL_TIMESTAMP);
+		renderer.draw(frame);
+		glQueryCounter(timeQueries[slot][1], GL_TIMESTAMP);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		if (f >= options.warmup)
+			cpuMs.push_back(msBetween(cpuStart, std::chrono::steady_clock::now()));
+	}
+	for (int f = std::max(0, total - SUITE_FRAMES_IN_FLIGHT); f < total; f++)
+		retire(f);
+	frameMs.push_back(msBetween(previousStart, std::chrono::steady_clock::now()));
+	glDeleteQueries(SUITE_FRAMES_IN_FLIGHT * 2, &timeQueries[0][0]);
+
+	result.cpu = summarize(cpuMs);
+	result.gpu = summarize(gpuMs);
+	result.frame = summarize(frameMs);
+}
+
+// Fresh context, renderer and scene, so no scenario inherits another one's resources
+static void runScenario(const SuiteOptions& options, ScenarioResult& result, std::string& rendererName)
+{
+	HeadlessContext context;
+	if (!context.create())
+	{
+		result.error = "no headless context";
+		return;
+	}
+	gladLoadGLLoader(context.loader());
+	loadGLExtensions(context.loader());
+	if (rendererName.empty())
+		rendererName = (const char*)glGetString(GL_RENDERER);
+	glViewport(0, 0, options.width, options.height);
+	glEnable(GL_DEPTH_TEST);
+
+	resetPeakRSS();
+	long long freeBefore = freeVideoMemoryKB();
+	long long freeMin = freeBefore;
+	std::mt19937 rng(options.seed);
+	{
+		OffscreenTarget target;
+		auto start = std::chrono::steady_clock::now();
+		std::unique_ptr<Renderer> renderer(new Renderer(options.width, options.height));
+		if (target.create(options.width, options.height))
+		{
+			renderer->targetFBO = target.FBO;
+			result.loadMs.push_back({ "renderer", msBetween(start, std::chrono::steady_clock::now()) });
+
+			SuiteScene scene;
+			bool built = false;
+			if (result.name == "primitives")
+				built = buildPrimitives(options, *renderer, scene, rng, result);
+			else if (result.name == "model")
+				built = buildModel(options, *renderer, scene, rng, result);
+			else if (result.name == "textures")
+				built = buildTextures(options, *renderer, scene, rng, result);
+			else if (result.name == "flythrough")
+				built = buildFlythrough(options, *renderer, scene, rng, result);
+
+			// Shader variants compile while the scene loads, this is only what's left of them
+			auto wait = std::chrono::steady_clock::now();
+			renderer->finishLoading();
+			result.loadMs.push_back({ "shaders", msBetween(wait, std::chrono::steady_clock::now()) });
+			result.loadMs.push_back({ "total", msBetween(start, std::chrono::steady_clock::now()) });
+
+			if (built)
+			{
+				scatterLights(scene, rng, SUITE_LIGHTS);
+				long long meshes = 0, triangles = 0;
+				for (const Object& object : scene.objects)
+					triangles += object.indices.size() / 3;
+				for (const std::unique_ptr<Model>& model : scene.models)
+				{
+					meshes += model->meshes.size();
+					for (const Mesh& mesh : model->meshes)
+						triangles += mesh.indices.size() / 3;
+				}
+				result.scene = { { "objects", (long long)scene.objects.size() }, { "meshes", meshes },
+					{ "textures", (long long)renderer->materials.textures.size() }, { "triangles", triangles },
+					{ "lights", (long long)scene.lights.size() } };
+				freeMin = std::min(freeMin, freeVideoMemoryKB());
+				measure(options, *renderer, scene, result);
+				freeMin = std::min(freeMin, freeVideoMemoryKB());
+			}
+		}
+		else
+			result.error = "offscreen framebuffer is incomplete";
+		renderer->Delete();
+		target.Delete();
+	}
+	profiler.Delete();
+	result.peakRSSMB = peakRSSMB();
+	if (freeBefore >= 0)
+		result.gpuMB = (freeBefore - freeMin) / 1024.0;
+	context.destroy();
+}
+
+static std::string jsonString(const std::string& text)
+{
+	std::string out = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+			continue;
+		}
+		out += c;
+	}
+	return out + "\"";
+}
+
+static std::string jsonNumber(double value)
+{
+	if (value < 0.0 || !std::isfinite(value))
+		return "null";
+	char text[32];
+	snprintf(text, sizeof(text), "%.4f", value);
+	return text;
+}
+
+static void writeMetric(std::ostream& out, const char* name, const FrameMetric& metric)
+{
+	out << "      " << jsonString(name) << ": { \"mean\": " << jsonNumber(metric.mean) << ", \"p50\": " << jsonNumber(metric.p50)
+		<< ", \"p90\": " << jsonNumber(metric.p90) << ", \"p95\": " << jsonNumber(metric.p95) << ", \"p99\": " << jsonNumber(metric.p99)
+		<< ", \"max\": " << jsonNumber(metric.max) << " },\n";
+}
+
+// Everything but the closing brace, so the comparison can be appended
+static void writeResults(std::ostream& out, const SuiteOptions& options, const std::string& rendererName, const std::vector<ScenarioResult>& results)
+{
+	out << "{\n  \"seed\": " << options.seed << ",\n  \"warmup\": " << options.warmup << ",\n  \"frames\": " << options.frames
+		<< ",\n  \"width\": " << options.width << ",\n  \"height\": " << options.height
+		<< ",\n  \"renderer\": " << jsonString(rendererName) << ",\n  \"scenarios\": [\n";
+	for (size_t s = 0; s < results.size(); s++)
+	{
+		const ScenarioResult& result = results[s];
+		out << "    {\n      \"name\": " << jsonString(result.name) << ",\n      \"error\": "
+			<< (result.error.empty() ? "null" : jsonString(result.error)) << ",\n      \"scene\": {";
+		for (size_t i = 0; i < result.scene.size(); i++)
+			out << (i ? ", " : " ") << jsonString(result.scene[i].first) << ": " << result.scene[i].second;
+		out << " },\n      \"load_ms\": {";
+		for (size_t i = 0; i < result.loadMs.size(); i++)
+			out << (i ? ", " : " ") << jsonString(result.loadMs[i].first) << ": " << jsonNumber(result.loadMs[i].second);
+		out << " },\n";
+		if (result.error.empty())
+		{
+			writeMetric(out, "cpu_ms", result.cpu);
+			writeMetric(out, "gpu_ms", result.gpu);
+			writeMetric(out, "frame_ms", result.frame);
+		}
+		out << "      \"memory\": { \"peak_rss_mb\": " << jsonNumber(result.peakRSSMB) << ", \"gpu_mb\": " << jsonNumber(result.gpuMB)
+			<< " }\n    }" << (s + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]";
+}
+
+// Just enough JSON to read a results file back. Object members keep their keys in keys.
+struct JsonValue {
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+	Type type = JSON_NULL;
+	double number = 0.0;
+	std::string string;
+	std::vector<std::string> keys;
+	std::vector<JsonValue> items;
+
+	const JsonValue* get(const std::string& key) const
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+			if (keys[i] == key)
+				return &items[i];
+		return nullptr;
+	}
+};
+
+static void skipSpace(const char*& p)
+{
+	while (*p && isspace((unsigned char)*p))
+		p++;
+}
+
+static bool parseJsonString(const char*& p, std::string& out)
+{
+	if (*p != '"')
+		return false;
+	for (p++; *p && *p != '"'; p++)
+	{
+		if (*p == '\\' && p[1])
+		{
+			p++;
+			out += *p == 'n' ? '\n' : (*p == 't' ? '\t' : *p);
+		}
+		else
+			out += *p;
+	}
+	if (*p != '"')
+		return false;
+	p++;
+	return true;
+}
+
+static bool parseJson(const char*& p, JsonValue& value)
+{
+	skipSpace(p);
+	if (*p == '{' || *p == '[')
+	{
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		value.type = object ? JsonValue::JSON_OBJECT : JsonValue::JSON_ARRAY;
+		p++;
+		skipSpace(p);
+		if (*p == close)
+		{
+			p++;
+			return true;
+		}
+		for (;;)
+		{
+			skipSpace(p);
+			if (object)
+			{
+				std::string key;
+				if (!parseJsonString(p, key))
+					return false;
+				skipSpace(p);
+				if (*p++ != ':')
+					return false;
+				value.keys.push_back(key);
+			}
+			value.items.emplace_back();
+			if (!parseJson(p, value.items.back()))
+				return false;
+			skipSpace(p);
+			if (*p == ',')
+			{
+				p++;
+				continue;
+			}
+			if (*p != close)
+				return false;
+			p++;
+			return true;
+		}
+	}
+	if (*p == '"')
+	{
+		value.type = JsonValue::JSON_STRING;
+		return parseJsonString(p, value.string);
+	}
+	if (strncmp(p, "null", 4) == 0)
+	{
+		p += 4;
+		return true;
+	}
+	if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0)
+	{
+		value.type = JsonValue::JSON_BOOL;
+		value.number = *p == 't' ? 1.0 : 0.0;
+		p += *p == 't' ? 4 : 5;
+		return true;
+	}
+	char* end;
+	value.number = strtod(p, &end);
+	if (end == p)
+		return false;
+	value.type = JsonValue::JSON_NUMBER;
+	p = end;
+	return true;
+}
+
+static bool loadJson(const std::string& path, JsonValue& value)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string contents = text.str();
+	const char* p = contents.c_str();
+	if (!parseJson(p, value) || value.type != JsonValue::JSON_OBJECT)
+	{
+		std::cout << path << " is not a results file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static const JsonValue* findScenario(const JsonValue& results, const std::string& name)
+{
+	const JsonValue* scenarios = results.get("scenarios");
+	if (!scenarios)
+		return nullptr;
+	for (const JsonValue& scenario : scenarios->items)
+	{
+		const JsonValue* scenarioName = scenario.get("name");
+		if (scenarioName && scenarioName->string == name)
+			return &scenario;
+	}
+	return nullptr;
+}
+
+struct Regression {
+	std::string scenario, metric;
+	double baseline, current;
+};
+
+// Compares every metric both runs have. A metric regresses when it grew by more than the
+// tolerance and by more than a noise floor: 0.05 ms for frame times, 5 ms for loading and 1 MB for memory.
+static std::vector<Regression> compare(const JsonValue& current, const JsonValue& baseline, const SuiteOptions& options)
+{
+	static const char* metrics[][2] = { { "frame_ms", "p50" }, { "frame_ms", "p95" }, { "frame_ms", "p99" }, { "cpu_ms", "p50" },
+		{ "cpu_ms", "p95" }, { "gpu_ms", "p50" }, { "gpu_ms", "p95" }, { "load_ms", "total" }, { "memory", "peak_rss_mb" }, { "memory", "gpu_mb" } };
+	std::vector<Regression> regressions;
+
+	for (const char* setting : { "seed", "warmup", "frames", "width", "height" })
+	{
+		const JsonValue* a = current.get(setting);
+		const JsonValue* b = baseline.get(setting);
+		if (a && b && a->number != b->number)
+			std::cout << "WARNING: baseline ran with " << setting << " " << b->number << ", this run with " << a->number << std::endl;
+	}
+	const JsonValue* baselineRenderer = baseline.get("renderer");
+	if (baselineRenderer && current.get("renderer") && baselineRenderer->string != current.get("renderer")->string)
+		std::cout << "WARNING: baseline ran on " << baselineRenderer->string << std::endl;
+
+	std::cout << "\n=== comparison with " << options.baseline << ", tolerance " << options.tolerance << "% ===" << std::endl;
+	std::cout << std::left << std::setw(14) << "scenario" << std::setw(22) << "metric" << std::setw(12) << "baseline"
+		<< std::setw(12) << "current" << "change" << std::endl;
+	for (const JsonValue& scenario : current.get("scenarios")->items)
+	{
+		std::string name = scenario.get("name")->string;
+		const JsonValue* old = findScenario(baseline, name);
+		if (!old)
+		{
+			std::cout << std::setw(14) << name << "not in the baseline" << std::endl;
+			continue;
+		}
+		for (auto& metric : metrics)
+		{
+			const JsonValue* group = scenario.get(metric[0]);
+			const JsonValue* oldGroup = old->get(metric[0]);
+			const JsonValue* value = group ? group->get(metric[1]) : nullptr;
+			const JsonValue* oldValue = oldGroup ? oldGroup->get(metric[1]) : nullptr;
+			if (!value || !oldValue || value->type != JsonValue::JSON_NUMBER || oldValue->type != JsonValue::JSON_NUMBER)
+				continue;
+			double floor = strcmp(metric[0], "memory") == 0 ? 1.0 : (strcmp(metric[0], "load_ms") == 0 ? 5.0 : 0.05);
+			double change = oldValue->number > 0.0 ? (value->number / oldValue->number - 1.0) * 100.0 : 0.0;
+			bool regressed = value->number - oldValue->number > floor && change > options.tolerance;
+			std::string metricName = std::string(metric[0]) + "." + metric[1];
+			std::cout << std::setw(14) << name << std::setw(22) << metricName << std::fixed << std::setprecision(3)
+				<< std::setw(12) << oldValue->number << std::setw(12) << value->number << std::showpos << std::setprecision(1)
+				<< change << "%" << std::noshowpos << (regressed ? "  REGRESSION" : "") << std::endl;
+			if (regressed)
+				regressions.push_back({ name, metricName, oldValue->number, value->number });
+		}
+	}
+	return regressions;
+}
+
+int runBenchSuite(const SuiteOptions& options)
+{
+	static const char* available[] = { "primitives", "model", "textures", "flythrough" };
+	std::vector<std::string> names = options.scenarios;
+	if (names.empty())
+		names.assign(std::begin(available), std::end(available));
+	for (const std::string& name : names)
+	{
+		if (std::find(std::begin(available), std::end(available), name) == std::end(available))
+		{
+			std::cout << "Unknown scenario '" << name << "', available: primitives, model, textures, flythrough" << std::endl;
+			return -1;
+		}
+	}
+
+	JsonValue baseline;
+	if (!options.baseline.empty() && !loadJson(options.baseline, baseline))
+		return -1;
+
+	// The suite reads its own timestamps, the profiler's queries would only add to every pass
+	profiler.enabled = false;
+	shaderCache.enabled = options.shaderCache;
+	stbi_set_flip_vertically_on_load(true);
+
+	std::cout << "=== benchmark suite: " << options.width << "x" << options.height << ", " << options.warmup << " warmup + "
+		<< options.frames << " frames, seed " << options.seed << " ===" << std::endl;
+	std::cout << std::left << std::setw(14) << "scenario" << std::setw(12) << "load ms" << std::setw(12) << "frame p50"
+		<< std::setw(12) << "frame p95" << std::setw(12) << "frame p99" << std::setw(12) << "cpu p50" << std::setw(12) << "gpu p50"
+		<< std::setw(12) << "rss MB" << "gpu MB" << std::endl;
+	std::string rendererName;
+	std::vector<ScenarioResult> results;
+	bool failed = false;
+	for (const std::string& name : names)
+	{
+		ScenarioResult result;
+		result.name = name;
+		runScenario(options, result, rendererName);
+		if (!result.error.empty())
+		{
+			std::cout << std::setw(14) << name << "ERROR: " << result.error << std::endl;
+			failed = true;
+		}
+		else
+			std::cout << std::setw(14) << name << std::fixed << std::setprecision(3) << std::setw(12) << result.loadMs.back().second
+				<< std::setw(12) << result.frame.p50 << std::setw(12) << result.frame.p95 << std::setw(12) << result.frame.p99
+				<< std::setw(12) << result.cpu.p50 << std::setw(12) << result.gpu.p50 << std::setprecision(1) << std::setw(12)
+				<< result.peakRSSMB << (result.gpuMB < 0.0 ? std::string("n/a") : std::to_string((int)result.gpuMB)) << std::endl;
+		results.push_back(result);
+	}
+
+	std::ostringstream json;
+	writeResults(json, options, rendererName, results);
+	std::vector<Regression> regressions;
+	if (!options.baseline.empty())
+	{
+		// The fresh results are compared in their JSON form, exactly as a baseline is read
+		JsonValue current;
+		std::string text = json.str() + "\n}\n";
+		const char* p = text.c_str();
+		parseJson(p, current);
+		regressions = compare(current, baseline, options);
+		json << ",\n  \"baseline\": " << jsonString(options.baseline) << ",\n  \"regressions\": [";
+		for (size_t i = 0; i < regressions.size(); i++)
+			json << (i ? "," : "") << "\n    { \"scenario\": " << jsonString(regressions[i].scenario) << ", \"metric\": "
+				<< jsonString(regressions[i].metric) << ", \"baseline\": " << jsonNumber(regressions[i].baseline)
+				<< ", \"current\": " << jsonNumber(regressions[i].current) << " }";
+		json << (regressions.empty() ? "]" : "\n  ]");
+	}
+	json << "\n}\n";
+
+	std::ofstream file(options.json, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Failed to open " << options.json << " for writing" << std::endl;
+		return -1;
+	}
+	file << json.str();
+	std::cout << "Results written to " << options.json << std::endl;
+	if (!regressions.empty())
+		std::cout << regressions.size() << " metric(s) regressed beyond " << options.tolerance << "%" << std::endl;
+	return failed || !regressions.empty() ? 1 : 0;
+}
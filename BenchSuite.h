@@ -0,0 +1,61 @@
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include<string>
+#include<vector>
+
+// Most primitives of the primitives scenario. Their uniform blocks fit the renderer's first ring
+// section, so the measured frames never include the stall of the ring growing.
+#define SUITE_MAX_PRIMITIVES 4000
+// Frames the GPU may run behind the CPU, like a swap chain allows
+#define SUITE_FRAMES_IN_FLIGHT 2
+
+// "Graphics --bench-suite [options]" renders named scenarios offscreen and writes the results
+// as JSON: frame time percentiles, load times, peak RSS and GPU memory. Every scenario gets a
+// fresh headless context and renderer, random placement comes from a fixed seed and the scene
+// clock advances 1/60 s per frame, so two runs draw the same frames. Options:
+//   --scenarios a,b     subset to run, default all: primitives, model, textures, flythrough
+//   --json file         results, default bench_results.json
+//   --baseline file     results of an earlier run to compare with, a regression makes the exit code 1
+//   --tolerance P       percent a metric may grow before it counts as a regression, default 10
+//   --seed N            seed of every random placement, default 1
+//   --warmup N          frames rendered before measuring, default 30
+//   --frames N          measured frames, default 300
+//   --size WxH          framebuffer size, default 1280x720
+//   --count N           cubes and spheres of the primitives scenario, default 2000
+//   --textures N        distinct textures of the textures scenario, default and at most MAX_MATERIALS
+//   --model file        model the model scenario imports, default models/brutalist_interior.glb
+//   --camera-path file  flythrough keyframes, see CameraPath
+//   --static-batching   merges the meshes of imported models by material, see StaticBatcher
+//   --no-shader-cache   compiles every program from source
+//   --help              prints these options
+// Any other argument is an error once the suite is enabled.
+struct SuiteOptions {
+	bool enabled = false;
+	std::vector<std::string> scenarios;
+	std::string json = "bench_results.json";
+	std::string baseline;
+	float tolerance = 10.0f;
+	unsigned int seed = 1;
+	int warmup = 30;
+	int frames = 300;
+	int width = 1280, height = 720;
+	int count = 2000;
+	int textures = 256;
+	std::string model = "models/brutalist_interior.glb";
+	std::string cameraPath;
+	bool staticBatching = false;
+	bool shaderCache = true;
+	// --help was given and the usage printed, nothing should run
+	bool help = false;
+
+	// Returns false on a malformed or unknown option, after printing why and the usage. Without
+	// --bench-suite the arguments belong to the editor and only the suite's own are read.
+	bool parse(int argc, char** argv);
+	static void printUsage();
+};
+
+// Runs the scenarios and writes the JSON, returns the process exit code
+int runBenchSuite(const SuiteOptions& options);
+
+#endif
@@ -0,0 +1,947 @@
+#include "Benchmark.h"
+
+#include<glad/glad.h>
+#include<atomic>
+#include<iostream>
+#include<iomanip>
+#include<vector>
+#include<random>
+#include<chrono>
+#include<thread>
+#include<algorithm>
+#include<cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "shaderClass.h"
+#include "mesh.h"
+#include "Material.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+#include "LightCluster.h"
+#include "GBuffer.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "GLExt.h"
+#include "JobSystem.h"
+#include "CommandList.h"
+#include "model.h"
+#include "FrameCapture.h"
+#include "Profiler.h"
+
+#define BENCH_WARMUP_FRAMES 50
+#define BENCH_FRAMES 300
+
+// Unit cube with normals and texture coordinates, offset into place so every mesh owns its buffers like a model mesh does
+Mesh makeCubeMesh(glm::vec3 offset, float size)
+{
+	static const float faces[6][3][3] = {
+		// normal, u axis, v axis
+		{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+	};
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	for (int f = 0; f < 6; f++)
+	{
+		glm::vec3 n(faces[f][0][0], faces[f][0][1], faces[f][0][2]);
+		glm::vec3 u(faces[f][1][0], faces[f][1][1], faces[f][1][2]);
+		glm::vec3 v(faces[f][2][0], faces[f][2][1], faces[f][2][2]);
+		unsigned int base = (unsigned int)vertices.size();
+		for (int c = 0; c < 4; c++)
+		{
+			float su = (c == 1 || c == 2) ? 1.0f : 0.0f;
+			float sv = (c >= 2) ? 1.0f : 0.0f;
+			Vertex vertex = {};
+			vertex.Position = offset + (n * 0.5f + u * (su - 0.5f) + v * (sv - 0.5f)) * size;
+			vertex.Normal = n;
+			vertex.TexCoords = glm::vec2(su, sv);
+			vertex.Tangent = u;
+			vertex.Bitangent = v;
+			vertices.push_back(vertex);
+		}
+		unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (unsigned int i : quad)
+			indices.push_back(base + i);
+	}
+	return Mesh(vertices, indices, vector<Texture>());
+}
+
+// Checkerboard so every generated texture is distinct
+vector<unsigned char> makeChecker(int width, int height, int seed)
+{
+	vector<unsigned char> pixels((size_t)width * height * 4);
+	unsigned char r = (unsigned char)(seed * 53 % 256), g = (unsigned char)(seed * 97 % 256), b = (unsigned char)(seed * 151 % 256);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			bool odd = ((x * 8 / width) + (y * 8 / height)) % 2 != 0;
+			unsigned char* p = &pixels[((size_t)y * width + x) * 4];
+			p[0] = odd ? r : 255 - r;
+			p[1] = odd ? g : 255 - g;
+			p[2] = odd ? b : 255 - b;
+			p[3] = 255;
+		}
+	return pixels;
+}
+
+#define BENCH_GRID 64
+#define BENCH_TEXTURES 96
+
+// BENCH_GRID x BENCH_GRID individually textured cubes, the scene shared by the GL benchmarks
+static void buildCubeGrid(MaterialTable& table, vector<Mesh>& meshes)
+{
+	for (int i = 0; i < BENCH_TEXTURES; i++)
+	{
+		// Mix of sizes: two array buckets plus atlas-sized textures
+		int size = i % 3 == 0 ? 512 : (i % 3 == 1 ? 256 : 32);
+		vector<unsigned char> pixels = makeChecker(size, size, i);
+		Material material;
+		material.name = "bench" + std::to_string(i);
+		material.diffuse = table.addTexture(material.name, size, size, pixels.data());
+		table.addMaterial(material);
+	}
+	table.build();
+
+	meshes.reserve(BENCH_GRID * BENCH_GRID);
+	for (int z = 0; z < BENCH_GRID; z++)
+		for (int x = 0; x < BENCH_GRID; x++)
+		{
+			meshes.push_back(makeCubeMesh(glm::vec3(x - BENCH_GRID / 2, 0.0f, -z), 0.8f));
+			meshes.back().materialIndex = (x * 7 + z * 13) % BENCH_TEXTURES;
+		}
+}
+
+// Camera looking down the cube grid
+static FrameUniforms benchFrame()
+{
+	FrameUniforms frameBlock;
+	frameBlock.projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 200.0f);
+	frameBlock.view = glm::lookAt(glm::vec3(0.0f, 20.0f, 12.0f), glm::vec3(0.0f, 0.0f, -BENCH_GRID * 0.4f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frameBlock.viewPos = glm::vec4(0.0f, 20.0f, 12.0f, 1.0f);
+	frameBlock.lightPos = glm::vec4(0.0f, 30.0f, 0.0f, 1.0f);
+	frameBlock.lightColor = glm::vec4(1.0f);
+	frameBlock.clusterParams = glm::vec4(0.1f, 200.0f, 0.0f, 0.0f);
+	for (int i = 0; i < 4; i++)
+		frameBlock.clusterDims[i] = 1;
+	frameBlock.screenSize = glm::vec4(1.0f);
+	return frameBlock;
+}
+
+// Draws a 64x64 grid of individually textured cubes twice: once rebinding each mesh's
+// texture like Mesh::Draw does, once with the material arrays bound up front.
+static int benchMaterials(GLFWwindow* window)
+{
+	const int textureCount = BENCH_TEXTURES;
+
+	// Textured variant without the light loop or shadow lookups
+	Shader shader("lit.vert", "lit.frag", ShaderPermutations::defines(SHADER_TEXTURED));
+	MaterialTable table;
+	vector<Mesh> meshes;
+	buildCubeGrid(table, meshes);
+	table.setupShader(shader);
+
+	RingBuffer ring(GL_UNIFORM_BUFFER, 64 * 1024);
+	GLint materialLocation = glGetUniformLocation(shader.ID, "materialIndex");
+	glfwSwapInterval(0);
+
+	const char* modes[2] = { "per-mesh binds", "material arrays" };
+	double frameMs[2] = { 0.0, 0.0 };
+	int bindsPerFrame[2] = { 0, 0 };
+
+	for (int mode = 0; mode < 2; mode++)
+	{
+		double start = 0.0;
+		for (int frame = 0; frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES; frame++)
+		{
+			if (frame == BENCH_WARMUP_FRAMES)
+			{
+				glFinish();
+				start = glfwGetTime();
+			}
+			ring.beginFrame();
+			GLintptr frameOffset = ring.push(benchFrame());
+			ObjectUniforms objectBlock;
+			objectBlock.model = glm::mat4(1.0f);
+			objectBlock.normalMatrix = glm::mat4(1.0f);
+			objectBlock.color = glm::vec4(1.0f);
+			GLintptr objectOffset = ring.push(objectBlock);
+			ring.commit();
+			ring.bindRange(FRAME_UBO_BINDING, frameOffset, sizeof(FrameUniforms));
+			ring.bindRange(OBJECT_UBO_BINDING, objectOffset, sizeof(ObjectUniforms));
+
+			glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			shader.Activate();
+
+			int binds = 0;
+			if (mode == 0)
+			{
+				glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, table.UBO);
+				for (Mesh& mesh : meshes)
+				{
+					// What Mesh::Draw pays per mesh: unit select, bind and a sampler uniform looked up by name
+					const TextureRef& ref = table.textures[table.materials[mesh.materialIndex].diffuse];
+					glActiveTexture(GL_TEXTURE0 + ref.array);
+					glBindTexture(GL_TEXTURE_2D_ARRAY, table.arrays[ref.array]);
+					shader.setInt("materialArrays[" + std::to_string(ref.array) + "]", ref.array);
+					binds++;
+					mesh.Draw(materialLocation);
+				}
+				glActiveTexture(GL_TEXTURE0);
+			}
+			else
+			{
+				table.bind();
+				binds = table.textureBinds;
+				for (Mesh& mesh : meshes)
+					mesh.Draw(materialLocation);
+			}
+			bindsPerFrame[mode] = binds;
+
+			ring.endFrame();
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		glFinish();
+		frameMs[mode] = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+	}
+
+	std::cout << "\n=== materials benchmark: " << meshes.size() << " meshes, " << textureCount << " textures, "
+		<< table.arrays.size() << " arrays ===" << std::endl;
+	std::cout << std::left << std::setw(18) << "mode" << std::setw(14) << "binds/frame" << "ms/frame" << std::endl;
+	for (int mode = 0; mode < 2; mode++)
+		std::cout << std::left << std::setw(18) << modes[mode] << std::setw(14) << bindsPerFrame[mode]
+			<< std::fixed << std::setprecision(3) << frameMs[mode] << std::endl;
+
+	ring.Delete();
+	table.Delete();
+	shader.Delete();
+	return 0;
+}
+
+// The cube grid lit by a growing number of clustered lights, forward vs deferred.
+// Forward runs the light loop for every rasterized fragment, deferred once per pixel.
+static int benchDeferred(GLFWwindow* window)
+{
+	const int counts[] = { 0, 64, 512, 2048 };
+	const char* paths[2] = { "forward", "deferred" };
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	// Shadows off, both paths run clustered lights only
+	Shader forwardShader("lit.vert", "lit.frag", ShaderPermutations::defines(SHADER_TEXTURED | SHADER_CLUSTERED_LIGHTS));
+	Shader gbufferShader("lit.vert", "lit.frag", ShaderPermutations::defines(SHADER_TEXTURED | SHADER_GBUFFER));
+	Shader lightingShader("lit.vert", "lit.frag", ShaderPermutations::defines(SHADER_DEFERRED_LIGHTING | SHADER_CLUSTERED_LIGHTS));
+	MaterialTable table;
+	vector<Mesh> meshes;
+	buildCubeGrid(table, meshes);
+	table.setupShader(forwardShader);
+	table.setupShader(gbufferShader);
+
+	LightCluster lightCluster;
+	lightCluster.setupShader(forwardShader);
+	lightCluster.setupShader(lightingShader);
+	GBuffer gbuffer;
+	gbuffer.resize(width, height);
+	gbuffer.setupShader(lightingShader);
+
+	RingBuffer ring(GL_UNIFORM_BUFFER, 64 * 1024);
+	GLint forwardMaterial = glGetUniformLocation(forwardShader.ID, "materialIndex");
+	GLint gbufferMaterial = glGetUniformLocation(gbufferShader.ID, "materialIndex");
+	glfwSwapInterval(0);
+
+	FrameUniforms frameBlock = benchFrame();
+	frameBlock.screenSize = glm::vec4((float)width, (float)height, 0.0f, 0.0f);
+
+	std::cout << "\n=== deferred benchmark: " << meshes.size() << " meshes at " << width << "x" << height << " ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "lights" << std::setw(12) << "path" << "ms/frame" << std::endl;
+	for (int count : counts)
+	{
+		// Lights scattered just above the grid
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> spreadX(-BENCH_GRID / 2.0f, BENCH_GRID / 2.0f), spreadZ(-(float)BENCH_GRID, 0.0f), unit(0.0f, 1.0f);
+		std::vector<Light> lights(count);
+		for (Light& light : lights)
+		{
+			light.pos = glm::vec3(spreadX(rng), 1.0f, spreadZ(rng));
+			light.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+			light.radius = 4.0f;
+			light.intensity = 6.0f;
+		}
+		lightCluster.cull(lights, frameBlock.view, frameBlock.projection, 0.1f, 200.0f);
+		lightCluster.upload(lights);
+		frameBlock.clusterParams = glm::vec4(0.1f, 200.0f, lightCluster.sliceScale(), lightCluster.sliceBias());
+		frameBlock.clusterDims[0] = lightCluster.dimX;
+		frameBlock.clusterDims[1] = lightCluster.dimY;
+		frameBlock.clusterDims[2] = lightCluster.dimZ;
+
+		for (int path = 0; path < 2; path++)
+		{
+			Shader& geometryShader = path == RENDER_FORWARD ? forwardShader : gbufferShader;
+			GLint materialLocation = path == RENDER_FORWARD ? forwardMaterial : gbufferMaterial;
+			double start = 0.0;
+			for (int frame = 0; frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES; frame++)
+			{
+				if (frame == BENCH_WARMUP_FRAMES)
+				{
+					glFinish();
+					start = glfwGetTime();
+				}
+				ring.beginFrame();
+				GLintptr frameOffset = ring.push(frameBlock);
+				ObjectUniforms objectBlock;
+				objectBlock.model = glm::mat4(1.0f);
+				objectBlock.normalMatrix = glm::mat4(1.0f);
+				objectBlock.color = glm::vec4(1.0f);
+				GLintptr objectOffset = ring.push(objectBlock);
+				ring.commit();
+				ring.bindRange(FRAME_UBO_BINDING, frameOffset, sizeof(FrameUniforms));
+				ring.bindRange(OBJECT_UBO_BINDING, objectOffset, sizeof(ObjectUniforms));
+				lightCluster.bind();
+				table.bind();
+
+				if (path == RENDER_DEFERRED)
+					gbuffer.bindGeometry();
+				else
+				{
+					glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				}
+				geometryShader.Activate();
+				for (Mesh& mesh : meshes)
+					mesh.Draw(materialLocation);
+				if (path == RENDER_DEFERRED)
+				{
+					glBindFramebuffer(GL_FRAMEBUFFER, 0);
+					glViewport(0, 0, width, height);
+					glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					gbuffer.lightPass(lightingShader);
+				}
+
+				ring.endFrame();
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+			}
+			glFinish();
+			double ms = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+			std::cout << std::left << std::setw(10) << count << std::setw(12) << paths[path]
+				<< std::fixed << std::setprecision(3) << ms << std::endl;
+		}
+	}
+
+	ring.Delete();
+	gbuffer.Delete();
+	lightCluster.Delete();
+	table.Delete();
+	forwardShader.Delete();
+	gbufferShader.Delete();
+	lightingShader.Delete();
+	return 0;
+}
+
+// Creates every program the editor uses four times: one after another from source, all
+// lit variants submitted together so the driver compiles them in parallel, the same
+// while filling an empty cache, and loaded from that cache.
+static int benchShaders()
+{
+	const char* programs[][2] = {
+		{ "light.vert", "light.frag" },
+		{ "shadow.vert", "shadow.frag" },
+	};
+	const int programCount = sizeof(programs) / sizeof(programs[0]);
+	// Same set the editor requests at startup
+	std::vector<unsigned int> variants;
+	for (unsigned int lighting = 0; lighting < 4; lighting++)
+	{
+		unsigned int features = (lighting & 1 ? SHADER_CLUSTERED_LIGHTS : 0) | (lighting & 2 ? SHADER_SHADOWS : 0);
+		variants.push_back(features);
+		variants.push_back(SHADER_TEXTURED | features);
+		variants.push_back(SHADER_DEFERRED_LIGHTING | features);
+	}
+	variants.push_back(SHADER_GBUFFER);
+	variants.push_back(SHADER_TEXTURED | SHADER_GBUFFER);
+	const char* passes[4] = { "serial", "parallel", "cold cache", "warm cache" };
+
+	// Own directory so the editor's cache is left alone
+	std::string editorDirectory = shaderCache.directory;
+	bool editorEnabled = shaderCache.enabled;
+	shaderCache.directory = "shader_cache_bench";
+	shaderCache.clear();
+
+	std::cout << "\n=== shaders benchmark: " << programCount + variants.size() << " programs, program binaries "
+		<< (glExt.programBinary ? "supported" : "NOT supported") << ", parallel compile "
+		<< (glExt.parallelShaderCompile ? "supported" : "NOT supported") << " ===" << std::endl;
+	std::cout << std::left << std::setw(14) << "pass" << std::setw(12) << "ms" << std::setw(8) << "hits" << "misses" << std::endl;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		shaderCache.enabled = pass > 1;
+		shaderCache.hits = shaderCache.misses = 0;
+		shaderCache.totalMs = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < programCount; i++)
+		{
+			Shader shader(programs[i][0], programs[i][1]);
+			shader.Delete();
+		}
+		if (pass == 0)
+		{
+			for (unsigned int features : variants)
+			{
+				Shader shader("lit.vert", "lit.frag", ShaderPermutations::defines(features));
+				shader.Delete();
+			}
+		}
+		else
+		{
+			ShaderPermutations lit("lit.vert", "lit.frag");
+			for (unsigned int features : variants)
+				lit.request(features);
+			lit.build();
+			lit.wait();
+			lit.Delete();
+		}
+		// Wall time, parallel compiles overlap so the per-program times don't add up to it
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::left << std::setw(14) << passes[pass] << std::setw(12) << std::fixed << std::setprecision(2)
+			<< ms << std::setw(8) << shaderCache.hits << shaderCache.misses << std::endl;
+	}
+
+	shaderCache.clear();
+	shaderCache.directory = editorDirectory;
+	shaderCache.enabled = editorEnabled;
+	return 0;
+}
+
+// Latitude/longitude sphere, dense enough that drawing it is bound by vertex work
+static Mesh makeSphereMesh(int sectors, int stacks)
+{
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	for (int i = 0; i <= stacks; i++)
+	{
+		float phi = glm::pi<float>() * (0.5f - (float)i / stacks);
+		for (int j = 0; j <= sectors; j++)
+		{
+			float theta = 2.0f * glm::pi<float>() * j / sectors;
+			Vertex vertex = {};
+			vertex.Normal = glm::vec3(cos(phi) * cos(theta), sin(phi), cos(phi) * sin(theta));
+			vertex.Position = vertex.Normal;
+			vertex.TexCoords = glm::vec2((float)j / sectors, (float)i / stacks);
+			vertices.push_back(vertex);
+		}
+	}
+	for (int i = 0; i < stacks; i++)
+		for (int j = 0; j < sectors; j++)
+		{
+			unsigned int a = i * (sectors + 1) + j, b = a + sectors + 1;
+			unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+			for (unsigned int index : quad)
+				indices.push_back(index);
+		}
+	return Mesh(vertices, indices, vector<Texture>());
+}
+
+// A dense sphere drawn several times into a tiny viewport, so the frame time is mostly
+// vertex shading: normal matrix inverted per vertex vs precomputed once per object.
+static int benchVertices(GLFWwindow* window)
+{
+	const int copies = 8;
+	const char* modes[2] = { "per-vertex inverse", "precomputed" };
+	Shader shaders[2] = {
+		Shader("lit.vert", "lit.frag", "#define INVERSE_NORMAL_MATRIX\n"),
+		Shader("lit.vert", "lit.frag"),
+	};
+	Mesh sphere = makeSphereMesh(512, 256);
+	RingBuffer ring(GL_UNIFORM_BUFFER, 64 * 1024);
+	glfwSwapInterval(0);
+	glViewport(0, 0, 64, 64);
+
+	std::cout << "\n=== vertices benchmark: " << copies << " x " << sphere.vertices.size() << " vertices, "
+		<< sphere.indices.size() / 3 << " triangles each ===" << std::endl;
+	std::cout << std::left << std::setw(22) << "normal matrix" << std::setw(12) << "ms/frame" << "Mverts/s" << std::endl;
+	for (int mode = 0; mode < 2; mode++)
+	{
+		double start = 0.0;
+		for (int frame = 0; frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES; frame++)
+		{
+			if (frame == BENCH_WARMUP_FRAMES)
+			{
+				glFinish();
+				start = glfwGetTime();
+			}
+			ring.beginFrame();
+			FrameUniforms frameBlock = benchFrame();
+			frameBlock.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			GLintptr frameOffset = ring.push(frameBlock);
+			GLintptr objectOffsets[copies];
+			for (int i = 0; i < copies; i++)
+			{
+				// Non-uniform scale, the case where the normal matrix really needs the inverse
+				ObjectUniforms objectBlock;
+				objectBlock.model = glm::translate(glm::mat4(1.0f), glm::vec3(i % 4 * 2.5f - 3.75f, i / 4 * 2.5f - 1.25f, 0.0f));
+				objectBlock.model = glm::rotate(objectBlock.model, frame * 0.01f + i, glm::vec3(0.0f, 1.0f, 0.0f));
+				objectBlock.model = glm::scale(objectBlock.model, glm::vec3(1.0f, 0.6f + i * 0.1f, 1.0f));
+				objectBlock.normalMatrix = normalMatrix(objectBlock.model);
+				objectBlock.color = glm::vec4(1.0f);
+				objectOffsets[i] = ring.push(objectBlock);
+			}
+			ring.commit();
+			ring.bindRange(FRAME_UBO_BINDING, frameOffset, sizeof(FrameUniforms));
+
+			glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			shaders[mode].Activate();
+			for (int i = 0; i < copies; i++)
+			{
+				ring.bindRange(OBJECT_UBO_BINDING, objectOffsets[i], sizeof(ObjectUniforms));
+				sphere.Draw(-1);
+			}
+
+			ring.endFrame();
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		glFinish();
+		double ms = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+		double vertices = (double)sphere.indices.size() * copies;
+		std::cout << std::left << std::setw(22) << modes[mode] << std::setw(12) << std::fixed << std::setprecision(3) << ms
+			<< std::setprecision(1) << vertices / ms / 1000.0 << std::endl;
+	}
+
+	ring.Delete();
+	shaders[0].Delete();
+	shaders[1].Delete();
+	return 0;
+}
+
+// Clustered light assignment for a fixed camera, single threaded and on every core
+static int benchLights()
+{
+	const int iterations = 100;
+	const int counts[] = { 256, 1024, 4096, 16384 };
+	int cores = (int)std::thread::hardware_concurrency();
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::cout << "\n=== lights benchmark: 16x16x24 clusters, " << iterations << " iterations ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "lights" << std::setw(10) << "threads" << std::setw(12) << "ms/cull"
+		<< std::setw(14) << "indices" << "max/cluster" << std::endl;
+	for (int count : counts)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> spread(-30.0f, 30.0f), height(0.0f, 8.0f), radius(1.0f, 6.0f);
+		std::vector<Light> lights(count);
+		for (Light& light : lights)
+		{
+			light.pos = glm::vec3(spread(rng), height(rng), spread(rng));
+			light.radius = radius(rng);
+		}
+
+		for (int threads : { 1, cores })
+		{
+			LightCluster cluster;
+			cluster.threadCount = threads;
+			cluster.cull(lights, view, projection, 0.1f, 100.0f);
+			double total = 0.0;
+			for (int i = 0; i < iterations; i++)
+			{
+				cluster.cull(lights, view, projection, 0.1f, 100.0f);
+				total += cluster.cullMs;
+			}
+			std::cout << std::left << std::setw(10) << count << std::setw(10) << threads << std::setw(12)
+				<< std::fixed << std::setprecision(3) << total / iterations << std::setw(14) << cluster.indices.size()
+				<< cluster.maxClusterLights << std::endl;
+		}
+	}
+	return 0;
+}
+
+// Synthetic model mesh: a vertex grid with normals, texture coordinates and tangents like an imported one
+static aiMesh* makeImportedMesh(int side)
+{
+	aiMesh* mesh = new aiMesh();
+	mesh->mNumVertices = side * side;
+	mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+	mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+	mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+	mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+	mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			int i = y * side + x;
+			float u = (float)x / (side - 1), v = (float)y / (side - 1);
+			mesh->mVertices[i].x = u; mesh->mVertices[i].y = 0.1f * std::sin(u * 20.0f); mesh->mVertices[i].z = v;
+			mesh->mNormals[i].x = 0.0f; mesh->mNormals[i].y = 1.0f; mesh->mNormals[i].z = 0.0f;
+			mesh->mTangents[i].x = 1.0f; mesh->mTangents[i].y = 0.0f; mesh->mTangents[i].z = 0.0f;
+			mesh->mBitangents[i].x = 0.0f; mesh->mBitangents[i].y = 0.0f; mesh->mBitangents[i].z = 1.0f;
+			mesh->mTextureCoords[0][i].x = u; mesh->mTextureCoords[0][i].y = v; mesh->mTextureCoords[0][i].z = 0.0f;
+		}
+	}
+	mesh->mNumFaces = (side - 1) * (side - 1) * 2;
+	mesh->mFaces = new aiFace[mesh->mNumFaces];
+	int face = 0;
+	for (int y = 0; y + 1 < side; y++)
+	{
+		for (int x = 0; x + 1 < side; x++)
+		{
+			unsigned int i = y * side + x;
+			unsigned int quad[2][3] = { { i, i + side, i + 1 }, { i + 1, i + side, i + side + 1 } };
+			for (auto& triangle : quad)
+			{
+				mesh->mFaces[face].mNumIndices = 3;
+				mesh->mFaces[face].mIndices = new unsigned int[3] { triangle[0], triangle[1], triangle[2] };
+				face++;
+			}
+		}
+	}
+	return mesh;
+}
+
+static double benchMs(std::chrono::steady_clock::time_point start, int iterations)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+// Scaling of the job system workloads from one thread to every core, CPU only
+static int benchJobs()
+{
+	const int lightCount = 4096;
+	const int objectCount = 100000;
+	const int meshCount = 64;
+	const int meshSide = 128;
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> spread(-30.0f, 30.0f), height(0.0f, 8.0f), radius(1.0f, 6.0f), turn(0.0f, 360.0f);
+	std::vector<Light> lights(lightCount);
+	for (Light& light : lights)
+	{
+		light.pos = glm::vec3(spread(rng), height(rng), spread(rng));
+		light.radius = radius(rng);
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<glm::vec3> positions(objectCount), angles(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		positions[i] = glm::vec3(spread(rng), height(rng), spread(rng));
+		angles[i] = glm::vec3(turn(rng), turn(rng), turn(rng));
+	}
+	std::vector<ObjectUniforms> transforms(objectCount);
+
+	std::vector<aiMesh*> meshes;
+	for (int i = 0; i < meshCount; i++)
+		meshes.push_back(makeImportedMesh(meshSide));
+	std::vector<std::vector<Vertex>> vertices(meshCount);
+	std::vector<std::vector<unsigned int>> indices(meshCount);
+
+	std::cout << "\n=== jobs benchmark: " << lightCount << " lights culled, " << objectCount << " transforms, "
+		<< meshCount << " meshes of " << meshSide * meshSide << " vertices ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::setw(12) << "cull ms" << std::setw(10) << "speedup"
+		<< std::setw(14) << "transform ms" << std::setw(10) << "speedup" << std::setw(12) << "meshes ms" << "speedup" << std::endl;
+	double base[3] = { 0.0, 0.0, 0.0 };
+	for (int threads : threadCounts)
+	{
+		jobSystem.start(threads);
+
+		LightCluster cluster;
+		cluster.cull(lights, view, projection, 0.1f, 100.0f);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < 50; i++)
+			cluster.cull(lights, view, projection, 0.1f, 100.0f);
+		double cullMs = benchMs(start, 50);
+
+		start = std::chrono::steady_clock::now();
+		for (int iteration = 0; iteration < 20; iteration++)
+		{
+			jobSystem.parallelFor(objectCount, 64, [&](int begin, int end) {
+				for (int i = begin; i < end; i++)
+				{
+					glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+					model = glm::rotate(model, glm::radians(angles[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+					model = glm::rotate(model, glm::radians(angles[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
+					model = glm::rotate(model, glm::radians(angles[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
+					model = glm::scale(model, glm::vec3(1.0f, 2.0f, 1.0f));
+					transforms[i].model = model;
+					transforms[i].normalMatrix = normalMatrix(model);
+				}
+			});
+		}
+		double transformMs = benchMs(start, 20);
+
+		start = std::chrono::steady_clock::now();
+		for (int iteration = 0; iteration < 5; iteration++)
+		{
+			jobSystem.parallelFor(meshCount, 1, [&](int begin, int end) {
+				for (int i = begin; i < end; i++)
+					Model::processVertices(meshes[i], glm::scale(glm::mat4(1.0f), glm::vec3(2.0f)), vertices[i], indices[i]);
+			});
+		}
+		double meshMs = benchMs(start, 5);
+
+		if (threads == 1)
+		{
+			base[0] = cullMs;
+			base[1] = transformMs;
+			base[2] = meshMs;
+		}
+		std::cout << std::left << std::fixed << std::setw(10) << threads
+			<< std::setprecision(3) << std::setw(12) << cullMs << std::setprecision(2) << std::setw(10) << base[0] / cullMs
+			<< std::setprecision(3) << std::setw(14) << transformMs << std::setprecision(2) << std::setw(10) << base[1] / transformMs
+			<< std::setprecision(3) << std::setw(12) << meshMs << std::setprecision(2) << base[2] / meshMs << std::endl;
+	}
+
+	for (aiMesh* mesh : meshes)
+		delete mesh;
+	// Back to one thread per core for whatever runs next
+	jobSystem.start();
+	return 0;
+}
+
+// Records a synthetic scene of one program, per-mesh materials and vertex arrays, and an
+// object block every 64 meshes like a model packet
+static void recordSyntheticDraws(CommandList& list, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		list.useProgram(3);
+		list.bindUniformRange(OBJECT_UBO_BINDING, 7, (GLintptr)(i / 64) * 256, sizeof(ObjectUniforms));
+		list.setInt(5, i % 37);
+		list.bindVertexArray(100 + i);
+		list.drawElements(36 + i % 100);
+	}
+}
+
+// Serial vs parallel command recording, replayed into the counting backend (CPU only)
+static int benchCommands()
+{
+	const int drawCount = 50000;
+	const int iterations = 20;
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	// Reference: one list recorded on this thread
+	CommandList serial;
+	recordSyntheticDraws(serial, 0, drawCount);
+	CountingBackend reference;
+	serial.execute(reference);
+
+	std::cout << "\n=== commands benchmark: " << drawCount << " draws, " << iterations << " iterations ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::setw(14) << "record ms" << std::setw(10) << "speedup"
+		<< std::setw(12) << "commands" << std::setw(14) << "replay ms" << "draws match" << std::endl;
+	int result = 0;
+	double base = 0.0;
+	for (int threads : threadCounts)
+	{
+		jobSystem.start(threads);
+		ParallelRecorder recorder;
+		CommandList list;
+		double recordMs = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			list.clear();
+			recorder.record(list, drawCount, 256, recordSyntheticDraws);
+			recordMs += recorder.recordMs;
+		}
+		recordMs /= iterations;
+
+		CountingBackend counted;
+		auto start = std::chrono::steady_clock::now();
+		list.execute(counted);
+		double replayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		bool match = counted.hash == reference.hash && counted.calls[CMD_DRAW_ELEMENTS] == drawCount
+			&& counted.elements == reference.elements;
+		if (!match)
+			result = 1;
+
+		if (threads == 1)
+			base = recordMs;
+		std::cout << std::left << std::fixed << std::setw(10) << threads << std::setprecision(3) << std::setw(14) << recordMs
+			<< std::setprecision(2) << std::setw(10) << base / recordMs << std::setw(12) << list.commands.size()
+			<< std::setprecision(3) << std::setw(14) << replayMs << (match ? "yes" : "NO") << std::endl;
+	}
+	jobSystem.start();
+	return result;
+}
+
+// Cost of a CPU scope, with the profiler off and on, from 1..N threads at once, and of
+// collecting them in endFrame() (CPU only)
+static int benchProfiler()
+{
+	const int scopes = 200000;
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	std::cout << "\n=== profiler benchmark: " << scopes << " nested scope pairs per thread ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::setw(14) << "off ns" << std::setw(14) << "on ns" << "collect ms" << std::endl;
+	for (int threads : threadCounts)
+	{
+		double ns[2] = { 0.0, 0.0 };
+		double collectMs = 0.0;
+		for (int on = 0; on < 2; on++)
+		{
+			profiler.enabled = on == 1;
+			std::vector<std::thread> workers;
+			std::atomic<long long> totalNs(0);
+			for (int t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&]() {
+					auto start = std::chrono::steady_clock::now();
+					for (int i = 0; i < scopes; i++)
+					{
+						PROFILE_SCOPE("Outer");
+						PROFILE_SCOPE("Inner");
+					}
+					totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				});
+			}
+			for (std::thread& worker : workers)
+				worker.join();
+			ns[on] = (double)totalNs / threads / (scopes * 2.0);
+
+			auto start = std::chrono::steady_clock::now();
+			profiler.endFrame(0);
+			if (on)
+				collectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(10) << threads << std::setw(14) << ns[0]
+			<< std::setw(14) << ns[1] << std::setprecision(3) << collectMs << std::endl;
+	}
+	profiler.enabled = true;
+	return 0;
+}
+
+// The material arrays cube grid drawn without capture, with a glReadPixels of every frame
+// and through the FrameCapture pixel buffer ring. Frames are encoded as raw RGB into the
+// null device so the disk doesn't decide the result.
+static int benchReadback(GLFWwindow* window)
+{
+	const char* modes[3] = { "no capture", "glReadPixels", "PBO ring" };
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	Shader shader("lit.vert", "lit.frag", ShaderPermutations::defines(SHADER_TEXTURED));
+	MaterialTable table;
+	vector<Mesh> meshes;
+	buildCubeGrid(table, meshes);
+	table.setupShader(shader);
+	RingBuffer ring(GL_UNIFORM_BUFFER, 64 * 1024);
+	GLint materialLocation = glGetUniformLocation(shader.ID, "materialIndex");
+	glfwSwapInterval(0);
+
+#ifdef _WIN32
+	const char* nullDevice = "NUL";
+#else
+	const char* nullDevice = "/dev/null";
+#endif
+
+	std::cout << "\n=== readback benchmark: " << width << "x" << height << ", " << CAPTURE_RING << " buffer ring ===" << std::endl;
+	std::cout << std::left << std::setw(16) << "mode" << std::setw(12) << "ms/frame" << std::setw(12) << "read ms"
+		<< std::setw(14) << "latency ms" << std::setw(10) << "MB/s" << std::setw(10) << "stalls" << "dropped" << std::endl;
+	for (int mode = 0; mode < 3; mode++)
+	{
+		FrameCapture capture;
+		CaptureSettings settings = { true, mode == 1, false, nullDevice, "raw", 60.0f };
+		if (mode > 0 && !capture.start(width, height, settings))
+			return -1;
+
+		double start = 0.0;
+		double readMs = 0.0;
+		for (int frame = 0; frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES; frame++)
+		{
+			if (frame == BENCH_WARMUP_FRAMES)
+			{
+				glFinish();
+				start = glfwGetTime();
+			}
+			ring.beginFrame();
+			GLintptr frameOffset = ring.push(benchFrame());
+			ObjectUniforms objectBlock;
+			objectBlock.model = glm::mat4(1.0f);
+			objectBlock.normalMatrix = glm::mat4(1.0f);
+			objectBlock.color = glm::vec4(1.0f);
+			GLintptr objectOffset = ring.push(objectBlock);
+			ring.commit();
+			ring.bindRange(FRAME_UBO_BINDING, frameOffset, sizeof(FrameUniforms));
+			ring.bindRange(OBJECT_UBO_BINDING, objectOffset, sizeof(ObjectUniforms));
+
+			glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			shader.Activate();
+			table.bind();
+			for (Mesh& mesh : meshes)
+				mesh.Draw(materialLocation);
+
+			capture.capture(0, frame);
+			if (frame >= BENCH_WARMUP_FRAMES)
+				readMs += capture.stats().readMs;
+			ring.endFrame();
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+		glFinish();
+		double ms = (glfwGetTime() - start) * 1000.0 / BENCH_FRAMES;
+		capture.stop();
+		CaptureStats stats = capture.stats();
+		std::cout << std::left << std::setw(16) << modes[mode] << std::fixed << std::setprecision(3) << std::setw(12) << ms
+			<< std::setw(12) << readMs / BENCH_FRAMES << std::setw(14) << stats.latencyMs << std::setprecision(1)
+			<< std::setw(10) << stats.writtenMBs << std::setw(10) << stats.stalls << stats.dropped << std::endl;
+	}
+
+	ring.Delete();
+	table.Delete();
+	shader.Delete();
+	return 0;
+}
+
+bool benchmarkNeedsGL(const std::string& name)
+{
+	return name != "lights" && name != "jobs" && name != "commands" && name != "profiler";
+}
+
+int runBenchmark(const std::string& name, GLFWwindow* window)
+{
+	if (name == "materials")
+		return benchMaterials(window);
+	if (name == "lights")
+		return benchLights();
+	if (name == "deferred")
+		return benchDeferred(window);
+	if (name == "shaders")
+		return benchShaders();
+	if (name == "vertices")
+		return benchVertices(window);
+	if (name == "jobs")
+		return benchJobs();
+	if (name == "commands")
+		return benchCommands();
+	if (name == "readback")
+		return benchReadback(window);
+	if (name == "profiler")
+		return benchProfiler();
+
+	std::cout << "Unknown benchmark '" << name << "', available: materials, lights, deferred, shaders, vertices, jobs, commands, readback, profiler" << std::endl;
+	return -1;
+}
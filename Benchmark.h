@@ -0,0 +1,31 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include<string>
+#include<vector>
+#include<GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Scripted performance scenes, started with "Graphics --bench <name>".
+// Each one prints a small table to stdout and returns the process exit code.
+//
+//   materials   per-mesh texture binds vs material arrays on a few thousand meshes
+//   lights      clustered light culling cost vs light and thread count (CPU only)
+//   deferred    forward vs deferred shading of the same scene as the light count grows
+//   shaders     program creation time serial, parallel, into and from the program binary cache
+//   vertices    per-vertex normal matrix inverse vs the precomputed one on a dense mesh
+//   jobs        light culling, transform updates and model mesh processing on 1..N job threads (CPU only)
+//   commands    serial vs parallel command list recording, checked against a counting backend (CPU only)
+//   readback    frame time without capture, with glReadPixels and with the pixel buffer ring
+//   profiler    cost of a profiler scope off and on, on 1..N threads, and of collecting them (CPU only)
+int runBenchmark(const std::string& name, GLFWwindow* window);
+// Benchmarks that return false here run before any window or GL context exists
+bool benchmarkNeedsGL(const std::string& name);
+
+// Generated geometry and textures, shared with the benchmark suite
+Mesh makeCubeMesh(glm::vec3 offset, float size);
+std::vector<unsigned char> makeChecker(int width, int height, int seed);
+
+#endif
@@ -0,0 +1,261 @@
+#include"CommandList.h"
+#include"JobSystem.h"
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<chrono>
+
+CountingBackend::CountingBackend()
+{
+	reset();
+}
+
+void CountingBackend::reset()
+{
+	for (int i = 0; i < CMD_TYPE_COUNT; i++)
+		calls[i] = 0;
+	elements = 0;
+	hash = 1469598103934665603ull;
+	program = vertexArray = uniformBuffer = 0;
+	uniformBinding = intLocation = -1;
+	intValue = 0;
+	uniformOffset = 0;
+	uniformSize = 0;
+}
+
+// FNV-1a over 64 bit values
+void CountingBackend::mix(uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= 1099511628211ull;
+	}
+}
+
+void CountingBackend::useProgram(GLuint program)
+{
+	calls[CMD_USE_PROGRAM]++;
+	this->program = program;
+}
+
+void CountingBackend::bindVertexArray(GLuint vertexArray)
+{
+	calls[CMD_BIND_VERTEX_ARRAY]++;
+	this->vertexArray = vertexArray;
+}
+
+void CountingBackend::bindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	calls[CMD_BIND_UNIFORM_RANGE]++;
+	uniformBinding = (GLint)binding;
+	uniformBuffer = buffer;
+	uniformOffset = offset;
+	uniformSize = size;
+}
+
+void CountingBackend::setInt(GLint location, GLint value)
+{
+	calls[CMD_SET_INT]++;
+	intLocation = location;
+	intValue = value;
+}
+
+void CountingBackend::drawElements(GLsizei count, GLintptr offset)
+{
+	calls[CMD_DRAW_ELEMENTS]++;
+	elements += count;
+	mix(program);
+	mix(vertexArray);
+	mix((uint64_t)uniformBinding);
+	mix(uniformBuffer);
+	mix((uint64_t)uniformOffset);
+	mix((uint64_t)uniformSize);
+	mix((uint64_t)intLocation);
+	mix((uint64_t)intValue);
+	mix((uint64_t)count);
+	mix((uint64_t)offset);
+}
+
+CommandList::CommandList()
+{
+	clear();
+}
+
+void CommandList::clear()
+{
+	commands.clear();
+	currentProgram = 0;
+	currentVertexArray = 0;
+	currentUniformBinding = -1;
+	currentUniformBuffer = 0;
+	currentUniformOffset = 0;
+	currentUniformSize = 0;
+}
+
+void CommandList::useProgram(GLuint program)
+{
+	if (program == currentProgram)
+		return;
+	currentProgram = program;
+	Command command = {};
+	command.type = CMD_USE_PROGRAM;
+	command.name = program;
+	commands.push_back(command);
+}
+
+void CommandList::bindVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == currentVertexArray)
+		return;
+	currentVertexArray = vertexArray;
+	Command command = {};
+	command.type = CMD_BIND_VERTEX_ARRAY;
+	command.name = vertexArray;
+	commands.push_back(command);
+}
+
+void CommandList::bindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if ((GLint)binding == currentUniformBinding && buffer == currentUniformBuffer && offset == currentUniformOffset && size == currentUniformSize)
+		return;
+	currentUniformBinding = (GLint)binding;
+	currentUniformBuffer = buffer;
+	currentUniformOffset = offset;
+	currentUniformSize = size;
+	Command command = {};
+	command.type = CMD_BIND_UNIFORM_RANGE;
+	command.name = buffer;
+	command.index = (GLint)binding;
+	command.offset = offset;
+	command.size = size;
+	commands.push_back(command);
+}
+
+void CommandList::setInt(GLint location, GLint value)
+{
+	Command command = {};
+	command.type = CMD_SET_INT;
+	command.index = location;
+	command.value = value;
+	commands.push_back(command);
+}
+
+void CommandList::drawElements(GLsizei count, GLintptr offset)
+{
+	Command command = {};
+	command.type = CMD_DRAW_ELEMENTS;
+	command.value = count;
+	command.offset = offset;
+	commands.push_back(command);
+}
+
+void CommandList::append(const CommandList& other)
+{
+	commands.insert(commands.end(), other.commands.begin(), other.commands.end());
+	// The filter continues from where the other list stopped
+	currentProgram = other.currentProgram;
+	currentVertexArray = other.currentVertexArray;
+	currentUniformBinding = other.currentUniformBinding;
+	currentUniformBuffer = other.currentUniformBuffer;
+	currentUniformOffset = other.currentUniformOffset;
+	currentUniformSize = other.currentUniformSize;
+}
+
+void CommandList::execute() const
+{
+	for (const Command& command : commands)
+	{
+		switch (command.type)
+		{
+		case CMD_USE_PROGRAM:
+			glUseProgram(command.name);
+			break;
+		case CMD_BIND_VERTEX_ARRAY:
+			glBindVertexArray(command.name);
+			break;
+		case CMD_BIND_UNIFORM_RANGE:
+			glBindBufferRange(GL_UNIFORM_BUFFER, command.index, command.name, command.offset, command.size);
+			break;
+		case CMD_SET_INT:
+			glUniform1i(command.index, command.value);
+			break;
+		case CMD_DRAW_ELEMENTS:
+			glDrawElements(GL_TRIANGLES, command.value, GL_UNSIGNED_INT, (void*)command.offset);
+			break;
+		default:
+			break;
+		}
+	}
+	glBindVertexArray(0);
+}
+
+void CommandList::execute(CommandBackend& backend) const
+{
+	for (const Command& command : commands)
+	{
+		switch (command.type)
+		{
+		case CMD_USE_PROGRAM:
+			backend.useProgram(command.name);
+			break;
+		case CMD_BIND_VERTEX_ARRAY:
+			backend.bindVertexArray(command.name);
+			break;
+		case CMD_BIND_UNIFORM_RANGE:
+			backend.bindUniformRange(command.index, command.name, command.offset, command.size);
+			break;
+		case CMD_SET_INT:
+			backend.setInt(command.index, command.value);
+			break;
+		case CMD_DRAW_ELEMENTS:
+			backend.drawElements(command.value, command.offset);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+ParallelRecorder::ParallelRecorder()
+	: recordMs(0.0)
+{
+}
+
+void ParallelRecorder::record(CommandList& out, int count, int grain, const std::function<void(CommandList&, int, int)>& record)
+{
+	auto start = std::chrono::steady_clock::now();
+	if (count <= 0)
+	{
+		recordMs = 0.0;
+		return;
+	}
+	grain = std::max(grain, 1);
+
+	// Small ranges are recorded straight into out
+	int threads = jobSystem.threadCount();
+	if (count <= grain || threads == 1)
+	{
+		record(out, 0, count);
+		recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	int chunkCount = std::min((count + grain - 1) / grain, threads * 4);
+	int size = (count + chunkCount - 1) / chunkCount;
+	chunkCount = (count + size - 1) / size;
+	if ((int)chunks.size() < chunkCount)
+		chunks.resize(chunkCount);
+	jobSystem.parallelFor(chunkCount, 1, [&](int first, int last) {
+		PROFILE_SCOPE("Record chunks");
+		for (int c = first; c < last; c++)
+		{
+			chunks[c].clear();
+			record(chunks[c], c * size, std::min((c + 1) * size, count));
+		}
+	});
+	for (int c = 0; c < chunkCount; c++)
+		out.append(chunks[c]);
+	recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
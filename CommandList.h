@@ -0,0 +1,122 @@
+#ifndef COMMAND_LIST_CLASS_H
+#define COMMAND_LIST_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<functional>
+#include<vector>
+
+enum CommandType {
+	CMD_USE_PROGRAM,
+	CMD_BIND_VERTEX_ARRAY,
+	CMD_BIND_UNIFORM_RANGE,
+	CMD_SET_INT,
+	CMD_DRAW_ELEMENTS,
+	CMD_TYPE_COUNT
+};
+
+// One recorded GL call. Plain data, so lists can be built on any thread and copied freely.
+struct Command {
+	CommandType type;
+	GLuint name;        // program, vertex array or buffer
+	GLint index;        // uniform location or buffer binding point
+	GLint value;        // int uniform value or element count
+	GLintptr offset;    // buffer range or index offset, in bytes
+	GLsizeiptr size;
+};
+
+// Receives the calls of a replayed list. The GL context thread uses CommandList::execute()
+// instead, other backends let recording be checked without a context.
+class CommandBackend
+{
+public:
+	virtual ~CommandBackend() {}
+	virtual void useProgram(GLuint program) = 0;
+	virtual void bindVertexArray(GLuint vertexArray) = 0;
+	virtual void bindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size) = 0;
+	virtual void setInt(GLint location, GLint value) = 0;
+	virtual void drawElements(GLsizei count, GLintptr offset) = 0;
+};
+
+// Counts what a replay would have done. The hash covers the state every draw sees,
+// so recordings that only differ in redundant binds hash the same.
+class CountingBackend : public CommandBackend
+{
+public:
+	int calls[CMD_TYPE_COUNT];
+	long long elements;
+	uint64_t hash;
+
+	CountingBackend();
+	void reset();
+
+	void useProgram(GLuint program) override;
+	void bindVertexArray(GLuint vertexArray) override;
+	void bindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+	void setInt(GLint location, GLint value) override;
+	void drawElements(GLsizei count, GLintptr offset) override;
+
+private:
+	GLuint program, vertexArray, uniformBuffer;
+	GLint uniformBinding, intLocation, intValue;
+	GLintptr uniformOffset;
+	GLsizeiptr uniformSize;
+	void mix(uint64_t value);
+};
+
+// Draw calls recorded ahead of time and replayed later on the GL thread.
+//
+// Recording drops binds of the program, vertex array and uniform ranges that are
+// already current within the list. Each list starts from unknown state, so the
+// first binds of a list are always kept and lists can be replayed in any context.
+class CommandList
+{
+public:
+	std::vector<Command> commands;
+
+	CommandList();
+	void clear();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	void bindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void setInt(GLint location, GLint value);
+	// GL_TRIANGLES with GL_UNSIGNED_INT indices from the bound vertex array
+	void drawElements(GLsizei count, GLintptr offset = 0);
+
+	// Appends the commands of other, keeping their order
+	void append(const CommandList& other);
+
+	// Issues the commands straight to GL, needs the context current
+	void execute() const;
+	void execute(CommandBackend& backend) const;
+
+private:
+	// Redundant bind filter, reset by clear()
+	GLuint currentProgram;
+	GLuint currentVertexArray;
+	// Last uniform range, only one binding point is tracked
+	GLint currentUniformBinding;
+	GLuint currentUniformBuffer;
+	GLintptr currentUniformOffset;
+	GLsizeiptr currentUniformSize;
+};
+
+// Records a range of items on the job system, one list per chunk, and merges the
+// chunks in item order. The calls match a serial recording, apart from a few
+// redundant binds at chunk starts. The chunk lists are kept to reuse their memory.
+class ParallelRecorder
+{
+public:
+	// Time the last record() spent recording and merging
+	double recordMs;
+
+	ParallelRecorder();
+	// Calls record(list, begin, end) over [0, count) and appends everything to out
+	void record(CommandList& out, int count, int grain, const std::function<void(CommandList&, int, int)>& record);
+
+private:
+	std::vector<CommandList> chunks;
+};
+
+#endif
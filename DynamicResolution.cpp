@@ -0,0 +1,133 @@
+#include"DynamicResolution.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+
+DynamicResolution::DynamicResolution()
+	: FBO(0), depth(0), width(0), height(0), scale(1.0f), gpuMs(0.0), color(0), queryFrame(0), framesSinceChange(0), measured(false)
+{
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		timeQueries[i][0] = timeQueries[i][1] = 0;
+		queryPending[i] = false;
+	}
+}
+
+bool DynamicResolution::begin(const ResolutionSettings& settings, int windowWidth, int windowHeight, bool offscreen)
+{
+	float minScale = std::min(settings.minScale, settings.maxScale);
+	float maxScale = std::max(settings.minScale, settings.maxScale);
+	if (!settings.enabled)
+		scale = 1.0f;
+	else if (measured && ++framesSinceChange >= RESOLUTION_SETTLE_FRAMES)
+	{
+		// GPU time grows with the pixel count, the square of the scale
+		float fit = scale * (float)std::sqrt(settings.targetMs / std::max(gpuMs, 0.01));
+		float wanted = scale;
+		if (gpuMs > settings.targetMs)
+			wanted = std::floor(fit / RESOLUTION_STEP) * RESOLUTION_STEP;
+		else if (gpuMs < settings.targetMs * RESOLUTION_GROW_BELOW)
+			wanted = std::min(std::floor(fit / RESOLUTION_STEP) * RESOLUTION_STEP, scale + 4 * RESOLUTION_STEP);
+		wanted = std::clamp(wanted, minScale, maxScale);
+		if (std::fabs(wanted - scale) >= RESOLUTION_STEP * 0.5f)
+		{
+			scale = wanted;
+			framesSinceChange = 0;
+		}
+	}
+	// Bounds may have changed without a new measurement
+	if (settings.enabled)
+		scale = std::clamp(scale, minScale, maxScale);
+
+	if (!offscreen && std::fabs(scale - 1.0f) < RESOLUTION_STEP * 0.5f)
+		return false;
+	resize(std::max(1, (int)std::lround(windowWidth * scale)), std::max(1, (int)std::lround(windowHeight * scale)));
+	return true;
+}
+
+void DynamicResolution::resize(int width, int height)
+{
+	if (FBO && width == this->width && height == this->height)
+		return;
+	this->width = width;
+	this->height = height;
+	if (!FBO)
+	{
+		glGenFramebuffers(1, &FBO);
+		glGenRenderbuffers(1, &color);
+		glGenRenderbuffers(1, &depth);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR: dynamic resolution framebuffer is incomplete" << std::endl;
+}
+
+// Reads the pair issued RING_FRAMES frames ago, normally done by now
+void DynamicResolution::collect()
+{
+	if (!queryPending[queryFrame])
+		return;
+	GLint available = 0;
+	glGetQueryObjectiv(timeQueries[queryFrame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(timeQueries[queryFrame][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(timeQueries[queryFrame][1], GL_QUERY_RESULT, &end);
+	double ms = (end - start) / 1e6;
+	gpuMs = measured ? gpuMs * 0.75 + ms * 0.25 : ms;
+	measured = true;
+}
+
+void DynamicResolution::beginScene()
+{
+	if (!timeQueries[0][0])
+		glGenQueries(RING_FRAMES * 2, &timeQueries[0][0]);
+	collect();
+	// Timestamps don't collide with the profiler's GL_TIME_ELAPSED queries
+	glQueryCounter(timeQueries[queryFrame][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::endScene()
+{
+	glQueryCounter(timeQueries[queryFrame][1], GL_TIMESTAMP);
+	queryPending[queryFrame] = true;
+	queryFrame = (queryFrame + 1) % RING_FRAMES;
+}
+
+void DynamicResolution::resolve(GLuint framebuffer, int windowWidth, int windowHeight)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void DynamicResolution::Delete()
+{
+	if (FBO)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &color);
+		glDeleteRenderbuffers(1, &depth);
+	}
+	if (timeQueries[0][0])
+		glDeleteQueries(RING_FRAMES * 2, &timeQueries[0][0]);
+	FBO = color = depth = 0;
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		timeQueries[i][0] = timeQueries[i][1] = 0;
+		queryPending[i] = false;
+	}
+}
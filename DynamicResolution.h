@@ -0,0 +1,65 @@
+#ifndef DYNAMIC_RESOLUTION_CLASS_H
+#define DYNAMIC_RESOLUTION_CLASS_H
+
+#include<glad/glad.h>
+
+#include "RingBuffer.h"
+
+// Scales are multiples of this, so the target isn't reallocated for every small change
+#define RESOLUTION_STEP 0.05f
+// Frames after a change before the next one, the GPU time of the new size arrives RING_FRAMES frames late
+#define RESOLUTION_SETTLE_FRAMES (RING_FRAMES + 3)
+// Grows only below this share of the budget, between it and the budget the scale holds
+#define RESOLUTION_GROW_BELOW 0.85f
+
+// Resolution scaling edited by the simulation, handed to the render thread with every snapshot
+struct ResolutionSettings {
+	bool enabled;
+	float targetMs;          // GPU time budget of the 3D scene
+	float minScale, maxScale; // per axis, of the window size
+};
+
+// Offscreen target of the 3D scene whose size follows the scene's GPU time. The scene passes
+// are bracketed with timestamp queries, and every RESOLUTION_SETTLE_FRAMES frames the scale moves
+// towards the size that fits the budget, assuming GPU time grows with the pixel count. Drops
+// happen at once, growth is capped to a few steps at a time and only once well under budget, so
+// the scale doesn't oscillate around the budget. resolve() upscales into the window
+// bilinearly, anything drawn after it, like the GUI, stays at native resolution.
+class DynamicResolution
+{
+public:
+	GLuint FBO;
+	// Depth renderbuffer of the target
+	GLuint depth;
+	// Of the scene target while enabled
+	int width, height;
+	float scale;
+	// Scene GPU time, smoothed over a few frames
+	double gpuMs;
+
+	DynamicResolution();
+
+	// Picks this frame's scale and sizes the target. False when the scene should be drawn
+	// straight into the window, because scaling is off or the scale is 1. offscreen keeps the
+	// target at scale 1 too, for passes that attach its depth buffer to framebuffers of their own.
+	bool begin(const ResolutionSettings& settings, int windowWidth, int windowHeight, bool offscreen = false);
+	// Timestamps around the scene passes, measured whether scaling is on or not
+	void beginScene();
+	void endScene();
+	// Upscales the scene into framebuffer, which is left bound
+	void resolve(GLuint framebuffer, int windowWidth, int windowHeight);
+	void Delete();
+
+private:
+	GLuint color;
+	GLuint timeQueries[RING_FRAMES][2];
+	bool queryPending[RING_FRAMES];
+	int queryFrame;
+	int framesSinceChange;
+	bool measured;
+
+	void resize(int width, int height);
+	void collect();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include"EBO.h"
+#include"GLStats.h"
 
 // Constructor that generates a Elements Buffer Object and links it to indices
 EBO::EBO()
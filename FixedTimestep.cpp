@@ -0,0 +1,43 @@
+#include"FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(int rate, int maxSteps)
+	: step(1.0 / rate), maxSteps(maxSteps), ticks(0), droppedSeconds(0.0), lastSteps(0), accumulator(0.0), elapsed(0.0)
+{
+}
+
+void FixedTimestep::setRate(int rate)
+{
+	// Keeps the blend position when the tick length changes
+	double fraction = accumulator / step;
+	step = 1.0 / rate;
+	accumulator = fraction * step;
+}
+
+int FixedTimestep::advance(double frameSeconds)
+{
+	if (frameSeconds > 0.0)
+		accumulator += frameSeconds;
+	int steps = (int)(accumulator / step);
+	if (steps > maxSteps)
+	{
+		// Catching up would make the next frame longer still, the scene slows down instead
+		droppedSeconds += (steps - maxSteps) * step;
+		accumulator -= (steps - maxSteps) * step;
+		steps = maxSteps;
+	}
+	accumulator -= steps * step;
+	ticks += steps;
+	elapsed += steps * step;
+	lastSteps = steps;
+	return steps;
+}
+
+float FixedTimestep::alpha() const
+{
+	return (float)(accumulator / step);
+}
+
+double FixedTimestep::time() const
+{
+	return elapsed;
+}
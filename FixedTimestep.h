@@ -0,0 +1,42 @@
+#ifndef FIXED_TIMESTEP_CLASS_H
+#define FIXED_TIMESTEP_CLASS_H
+
+// Default simulation rate of the editor, in ticks per second
+#define TIMESTEP_RATE 60
+// Ticks one frame may run at most, the rest of a long frame is dropped
+#define TIMESTEP_MAX_STEPS 5
+
+// Accumulates frame time and hands it out as whole simulation ticks of a fixed length, so
+// movement doesn't depend on the frame rate and a long frame can't jump the scene. What
+// doesn't make a whole tick stays for the next frame, alpha() tells how far into the
+// next tick the frame is, to blend the last two simulation states for display. Past
+// maxSteps ticks in one frame the leftover time is dropped instead of piling up.
+class FixedTimestep
+{
+public:
+	// Seconds per tick
+	double step;
+	int maxSteps;
+
+	// Counters since start
+	long long ticks;
+	double droppedSeconds;
+	// Ticks of the last advance()
+	int lastSteps;
+
+	FixedTimestep(int rate = TIMESTEP_RATE, int maxSteps = TIMESTEP_MAX_STEPS);
+
+	void setRate(int rate);
+	// Adds the time of a frame, returns the ticks to run before drawing it
+	int advance(double frameSeconds);
+	// 0 shows the state before the last tick, 1 the state after it
+	float alpha() const;
+	// Simulation time of the last tick
+	double time() const;
+
+private:
+	double accumulator;
+	double elapsed;
+};
+
+#endif
@@ -0,0 +1,506 @@
+#include"FrameCapture.h"
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<cstring>
+#include<filesystem>
+#include<iostream>
+
+#ifdef _WIN32
+#include<fcntl.h>
+#include<io.h>
+#endif
+
+static double msBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+FrameWriter::FrameWriter()
+	: bytes(0), fps(60.0f), stream(nullptr), headerWritten(false)
+{
+}
+
+bool FrameWriter::open(const std::string& output, const std::string& format, float fps)
+{
+	this->output = output;
+	this->format = format;
+	this->fps = fps;
+	bytes = 0;
+	headerWritten = false;
+	if (output == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		stream = stdout;
+		return true;
+	}
+	if (format == "png")
+	{
+		std::error_code error;
+		std::filesystem::create_directories(output, error);
+		if (error)
+		{
+			std::cout << "Failed to create frame directory " << output << ": " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+	stream = fopen(output.c_str(), "wb");
+	if (!stream)
+	{
+		std::cout << "Failed to open " << output << " for writing" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool FrameWriter::write(long long frame, int width, int height, const unsigned char* rgba)
+{
+	flipToRGB(width, height, rgba, rgb);
+	const std::vector<unsigned char>* data = &rgb;
+	if (format == "png")
+	{
+		encodePNG(width, height, rgb, encoded);
+		data = &encoded;
+	}
+	else if (format == "y4m")
+	{
+		// The stream header goes in front of the first frame, every frame gets its own marker
+		std::string header;
+		if (!headerWritten)
+		{
+			char line[96];
+			snprintf(line, sizeof(line), "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg\n", width, height, (int)(fps * 1000.0f + 0.5f));
+			header = line;
+			headerWritten = true;
+		}
+		header += "FRAME\n";
+		encodeYUV420(width, height, rgb, encoded);
+		encoded.insert(encoded.begin(), header.begin(), header.end());
+		data = &encoded;
+	}
+
+	FILE* file = stream;
+	if (!file)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%05lld.png", frame);
+		std::string path = output + "/" + name;
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			std::cout << "Failed to open " << path << " for writing" << std::endl;
+			return false;
+		}
+	}
+	bool written = fwrite(data->data(), 1, data->size(), file) == data->size();
+	if (file != stream)
+		fclose(file);
+	else
+		fflush(file);
+	bytes += data->size();
+	return written;
+}
+
+void FrameWriter::close()
+{
+	if (stream && stream != stdout)
+		fclose(stream);
+	stream = nullptr;
+}
+
+void FrameWriter::flipToRGB(int width, int height, const unsigned char* rgba, std::vector<unsigned char>& rgb)
+{
+	rgb.resize((size_t)width * height * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* src = rgba + (size_t)(height - 1 - y) * width * 4;
+		unsigned char* dst = rgb.data() + (size_t)y * width * 3;
+		for (int x = 0; x < width; x++)
+		{
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+}
+
+struct CrcTable {
+	uint32_t entries[256];
+	CrcTable()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			entries[i] = c;
+		}
+	}
+};
+
+static uint32_t crc32(const unsigned char* data, size_t size)
+{
+	static const CrcTable table;
+	uint32_t crc = 0xffffffffu;
+	for (size_t i = 0; i < size; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBig32(std::vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void putChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data)
+{
+	putBig32(png, (uint32_t)data.size());
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	putBig32(png, crc32(png.data() + start, png.size() - start));
+}
+
+void FrameWriter::encodePNG(int width, int height, const std::vector<unsigned char>& rgb, std::vector<unsigned char>& png)
+{
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	png.assign(signature, signature + 8);
+
+	std::vector<unsigned char> header;
+	putBig32(header, width);
+	putBig32(header, height);
+	header.push_back(8);    // bits per channel
+	header.push_back(2);    // RGB
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	putChunk(png, "IHDR", header);
+
+	// Filter byte 0 in front of every row, then a zlib stream of stored blocks
+	size_t rowBytes = (size_t)width * 3;
+	size_t rawSize = (rowBytes + 1) * height;
+	std::vector<unsigned char> zlib;
+	zlib.reserve(rawSize + rawSize / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	uint32_t a = 1, b = 0;
+	size_t done = 0;
+	size_t blockLeft = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = rgb.data() + (size_t)y * rowBytes;
+		for (size_t i = 0; i <= rowBytes; i++)
+		{
+			if (blockLeft == 0)
+			{
+				size_t size = std::min<size_t>(65535, rawSize - done);
+				zlib.push_back(done + size == rawSize ? 1 : 0);
+				zlib.push_back((unsigned char)size);
+				zlib.push_back((unsigned char)(size >> 8));
+				zlib.push_back((unsigned char)~size);
+				zlib.push_back((unsigned char)(~size >> 8));
+				blockLeft = size;
+			}
+			unsigned char value = i == 0 ? 0 : row[i - 1];
+			zlib.push_back(value);
+			a += value;
+			b += a;
+			// 5552 bytes is the most that can be summed before b overflows
+			if (++done % 5552 == 0)
+			{
+				a %= 65521;
+				b %= 65521;
+			}
+			blockLeft--;
+		}
+	}
+	a %= 65521;
+	b %= 65521;
+	putBig32(zlib, (b << 16) | a);
+	putChunk(png, "IDAT", zlib);
+	putChunk(png, "IEND", std::vector<unsigned char>());
+}
+
+void FrameWriter::encodeYUV420(int width, int height, const std::vector<unsigned char>& rgb, std::vector<unsigned char>& yuv)
+{
+	int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height, chromaSize = (size_t)chromaWidth * chromaHeight;
+	yuv.resize(lumaSize + 2 * chromaSize);
+	unsigned char* luma = yuv.data();
+	unsigned char* cb = luma + lumaSize;
+	unsigned char* cr = cb + chromaSize;
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = rgb.data() + (size_t)y * width * 3;
+		for (int x = 0; x < width; x++)
+		{
+			float r = row[x * 3], g = row[x * 3 + 1], b = row[x * 3 + 2];
+			luma[(size_t)y * width + x] = (unsigned char)std::clamp(0.299f * r + 0.587f * g + 0.114f * b + 0.5f, 0.0f, 255.0f);
+		}
+	}
+	// Chroma of each 2x2 block from its average color
+	for (int cy = 0; cy < chromaHeight; cy++)
+	{
+		for (int cx = 0; cx < chromaWidth; cx++)
+		{
+			float r = 0.0f, g = 0.0f, b = 0.0f;
+			int samples = 0;
+			for (int dy = 0; dy < 2; dy++)
+			{
+				for (int dx = 0; dx < 2; dx++)
+				{
+					int x = std::min(cx * 2 + dx, width - 1), y = std::min(cy * 2 + dy, height - 1);
+					const unsigned char* pixel = rgb.data() + ((size_t)y * width + x) * 3;
+					r += pixel[0];
+					g += pixel[1];
+					b += pixel[2];
+					samples++;
+				}
+			}
+			r /= samples;
+			g /= samples;
+			b /= samples;
+			size_t index = (size_t)cy * chromaWidth + cx;
+			cb[index] = (unsigned char)std::clamp(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f, 255.0f);
+			cr[index] = (unsigned char)std::clamp(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f, 255.0f);
+		}
+	}
+}
+
+FrameCapture::FrameCapture()
+	: width(0), height(0), running(false), readSynchronously(false), lossless(false), head(0), stopping(false),
+	current(), latencyTotal(0.0), encodeTotal(0.0)
+{
+	for (Slot& slot : slots)
+		slot = { 0, 0, 0, TimePoint() };
+}
+
+bool FrameCapture::start(int width, int height, const CaptureSettings& settings)
+{
+	stop();
+	if (!writer.open(settings.output, settings.format, settings.fps))
+		return false;
+	this->width = width;
+	this->height = height;
+	readSynchronously = settings.synchronous;
+	lossless = settings.lossless;
+	head = 0;
+	if (!readSynchronously)
+	{
+		// GL_STREAM_READ: written by the GPU once, read back by us once
+		for (Slot& slot : slots)
+		{
+			glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+			slot.fence = 0;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	current = CaptureStats();
+	current.active = true;
+	latencyTotal = encodeTotal = 0.0;
+	startTime = std::chrono::steady_clock::now();
+	stopping = false;
+	running = true;
+	encoder = std::thread(&FrameCapture::encodeLoop, this);
+	return true;
+}
+
+bool FrameCapture::active() const
+{
+	return running;
+}
+
+bool FrameCapture::synchronous() const
+{
+	return readSynchronously;
+}
+
+void FrameCapture::capture(GLuint framebuffer, long long frame)
+{
+	if (!running)
+		return;
+	auto start = std::chrono::steady_clock::now();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	if (readSynchronously)
+	{
+		// Waits for the GPU to finish the frame, then copies it out
+		PendingFrame pending = { frame, start, takeBuffer() };
+		pending.rgba.resize((size_t)width * height * 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pending.rgba.data());
+		enqueue(std::move(pending));
+	}
+	else
+	{
+		// The slot about to be reused holds the oldest frame, normally long finished
+		Slot& slot = slots[head];
+		if (slot.fence)
+			collect(slot, true);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frame = frame;
+		slot.captured = start;
+		head = (head + 1) % CAPTURE_RING;
+
+		// Hand over whatever already finished, oldest first, without waiting
+		for (int i = 0; i < CAPTURE_RING; i++)
+		{
+			Slot& older = slots[(head + i) % CAPTURE_RING];
+			if (older.fence && !collect(older, false))
+				break;
+		}
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	current.captured++;
+	current.readMs = msBetween(start, std::chrono::steady_clock::now());
+}
+
+bool FrameCapture::collect(Slot& slot, bool wait)
+{
+	GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		if (!wait)
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current.stalls++;
+		}
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+
+	PendingFrame pending = { slot.frame, slot.captured, takeBuffer() };
+	size_t size = (size_t)width * height * 4;
+	pending.rgba.resize(size);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		memcpy(pending.rgba.data(), mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (mapped)
+		enqueue(std::move(pending));
+	return true;
+}
+
+std::vector<unsigned char> FrameCapture::takeBuffer()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (spare.empty())
+		return std::vector<unsigned char>();
+	std::vector<unsigned char> buffer = std::move(spare.back());
+	spare.pop_back();
+	return buffer;
+}
+
+void FrameCapture::enqueue(PendingFrame pending)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (lossless)
+			space.wait(lock, [this] { return queue.size() < CAPTURE_QUEUE; });
+		// A slow disk loses frames, live captures never wait for the encoder
+		if (queue.size() >= CAPTURE_QUEUE)
+		{
+			current.dropped++;
+			spare.push_back(std::move(pending.rgba));
+			return;
+		}
+		queue.push_back(std::move(pending));
+	}
+	ready.notify_one();
+}
+
+void FrameCapture::encodeLoop()
+{
+	PROFILE_THREAD("Encoder");
+	while (true)
+	{
+		PendingFrame pending;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock, [this] { return !queue.empty() || stopping; });
+			if (queue.empty())
+				break;
+			pending = std::move(queue.front());
+			queue.pop_front();
+		}
+		space.notify_one();
+
+		PROFILE_SCOPE("Encode frame");
+		auto start = std::chrono::steady_clock::now();
+		bool written = writer.write(pending.frame, width, height, pending.rgba.data());
+		auto end = std::chrono::steady_clock::now();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(std::move(pending.rgba));
+		if (!written)
+			continue;
+		current.written++;
+		latencyTotal += msBetween(pending.captured, end);
+		encodeTotal += msBetween(start, end);
+		current.latencyMs = latencyTotal / current.written;
+		current.encodeMs = encodeTotal / current.written;
+		double seconds = msBetween(startTime, end) / 1000.0;
+		current.encodedFps = current.written / seconds;
+		current.writtenMBs = writer.bytes / (1024.0 * 1024.0) / seconds;
+	}
+}
+
+void FrameCapture::stop()
+{
+	if (!running)
+		return;
+	// Everything still in the ring, oldest first
+	for (int i = 0; i < CAPTURE_RING; i++)
+	{
+		Slot& slot = slots[(head + i) % CAPTURE_RING];
+		if (slot.fence)
+			collect(slot, true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	ready.notify_all();
+	encoder.join();
+	writer.close();
+
+	for (Slot& slot : slots)
+	{
+		if (slot.buffer)
+			glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+	spare.clear();
+	running = false;
+	std::lock_guard<std::mutex> lock(mutex);
+	current.active = false;
+}
+
+CaptureStats FrameCapture::stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return current;
+}
@@ -0,0 +1,138 @@
+#ifndef FRAME_CAPTURE_CLASS_H
+#define FRAME_CAPTURE_CLASS_H
+
+#include<glad/glad.h>
+#include<chrono>
+#include<condition_variable>
+#include<cstdio>
+#include<deque>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+// Pixel buffers in flight, a frame is mapped CAPTURE_RING - 1 frames after it was read
+#define CAPTURE_RING 3
+// Frames waiting for the encoder, more than this are dropped instead of stalling the renderer
+#define CAPTURE_QUEUE 8
+
+// Writes finished frames as PNG files, one raw RGB24 stream or one Y4M stream
+class FrameWriter
+{
+public:
+	// Bytes written so far
+	long long bytes;
+
+	FrameWriter();
+	// fps only goes into the Y4M header
+	bool open(const std::string& output, const std::string& format, float fps = 60.0f);
+	// rgba is bottom-up as read from GL
+	bool write(long long frame, int width, int height, const unsigned char* rgba);
+	void close();
+
+	// Top-down RGB24 rows from bottom-up RGBA8 ones
+	static void flipToRGB(int width, int height, const unsigned char* rgba, std::vector<unsigned char>& rgb);
+	// Uncompressed PNG, stored deflate blocks keep the encoder tiny and fast
+	static void encodePNG(int width, int height, const std::vector<unsigned char>& rgb, std::vector<unsigned char>& png);
+	// Full range BT.601 4:2:0 planes (Y4M's C420jpeg) of top-down RGB24
+	static void encodeYUV420(int width, int height, const std::vector<unsigned char>& rgb, std::vector<unsigned char>& yuv);
+
+private:
+	std::string output, format;
+	float fps;
+	FILE* stream;
+	bool headerWritten;
+	std::vector<unsigned char> rgb, encoded;
+};
+
+// What the simulation asks the render thread to record
+struct CaptureSettings {
+	bool enabled;
+	// glReadPixels straight into memory, the stalling path the ring is compared against
+	bool synchronous;
+	// Waits for the encoder instead of dropping frames when it falls behind, for offline runs
+	bool lossless;
+	std::string output;
+	std::string format;    // png, raw or y4m, see FrameWriter
+	float fps;             // only goes into the Y4M header
+};
+
+struct CaptureStats {
+	bool active;
+	long long captured;
+	long long written;
+	long long dropped;     // encoder queue was full
+	long long stalls;      // a ring slot was reused before its fence signalled
+	double readMs;         // render thread time of the last capture()
+	double latencyMs;      // average from capture() to the frame being written
+	double encodeMs;       // average encoder time per frame
+	double encodedFps;
+	double writtenMBs;     // output throughput
+};
+
+// Continuous readback of a framebuffer without stalling the GL thread.
+//
+// capture() issues glReadPixels into the next pixel buffer of a ring and fences it.
+// A buffer is only mapped once its fence signalled, at the latest when the ring wraps
+// around, so the copy overlaps the next frames. The mapped pixels go to a queue that
+// a background thread encodes and writes, GL calls stay on the thread that owns the
+// context.
+class FrameCapture
+{
+public:
+	FrameCapture();
+	// Needs the context current. Drops the previous capture.
+	bool start(int width, int height, const CaptureSettings& settings);
+	bool active() const;
+	bool synchronous() const;
+	// Reads the color buffer of framebuffer, 0 reads the window's back buffer before the swap
+	void capture(GLuint framebuffer, long long frame);
+	// Maps what is still in flight, waits for the encoder and closes the output
+	void stop();
+	CaptureStats stats();
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	struct Slot {
+		GLuint buffer;
+		GLsync fence;
+		long long frame;
+		TimePoint captured;
+	};
+	struct PendingFrame {
+		long long frame;
+		TimePoint captured;
+		std::vector<unsigned char> rgba;
+	};
+
+	int width, height;
+	bool running;
+	bool readSynchronously;
+	bool lossless;
+	Slot slots[CAPTURE_RING];
+	// Next slot to read into, the oldest one in flight
+	int head;
+
+	FrameWriter writer;
+	std::thread encoder;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable space;
+	std::deque<PendingFrame> queue;
+	// Pixel vectors the encoder is done with, reused by the next frames
+	std::vector<std::vector<unsigned char>> spare;
+	bool stopping;
+
+	// Shared with the encoder, under mutex
+	CaptureStats current;
+	double latencyTotal, encodeTotal;
+	TimePoint startTime;
+
+	// Maps a slot once its fence signalled, or waits for it
+	bool collect(Slot& slot, bool wait);
+	std::vector<unsigned char> takeBuffer();
+	void enqueue(PendingFrame pending);
+	void encodeLoop();
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include"FramePacing.h"
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include<windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+static double msBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+FrameLimiter::FrameLimiter()
+	: waitMs(0.0), next(std::chrono::steady_clock::now())
+{
+#if defined(_WIN32)
+	// 1 ms scheduler ticks instead of 15.6 ms
+	timeBeginPeriod(1);
+#endif
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#if defined(_WIN32)
+	timeEndPeriod(1);
+#endif
+}
+
+void FrameLimiter::wait(float fps)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	waitMs = 0.0;
+	if (fps <= 0.0f)
+	{
+		next = start;
+		return;
+	}
+
+	PROFILE_SCOPE("Frame limiter");
+	std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps));
+	next += period;
+	// More than a frame behind, e.g. after a stall or a lower cap: start over instead of rushing to catch up
+	if (next + period < start)
+		next = start;
+	std::chrono::steady_clock::duration spin = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(PACING_SPIN_MS));
+	if (next - start > spin)
+		std::this_thread::sleep_for(next - start - spin);
+	while (std::chrono::steady_clock::now() < next)
+		std::this_thread::yield();
+	waitMs = msBetween(start, std::chrono::steady_clock::now());
+}
+
+FrameFences::FrameFences()
+	: waitMs(0.0), inFlight(0), latencyMs(0.0), latencyMaxMs(0.0), latencyCount(0), latencyNext(0)
+{
+}
+
+void FrameFences::frameSwapped(std::chrono::steady_clock::time_point inputTime, int maxFrames)
+{
+	fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime });
+
+	PROFILE_SCOPE("Frame fences");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (!fences.empty())
+	{
+		bool tooMany = (int)fences.size() > std::max(maxFrames, 1);
+		// Only waits for the oldest frame when too many are queued, otherwise just checks
+		GLuint64 timeout = tooMany ? 1000000000ull : 0;
+		GLenum result = glClientWaitSync(fences.front().sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (result == GL_TIMEOUT_EXPIRED && !tooMany)
+			break;
+		finished(fences.front());
+		fences.pop_front();
+	}
+	waitMs = msBetween(start, std::chrono::steady_clock::now());
+	inFlight = (int)fences.size();
+}
+
+void FrameFences::finished(const Fence& fence)
+{
+	glDeleteSync(fence.sync);
+	latencies[latencyNext] = msBetween(fence.inputTime, std::chrono::steady_clock::now());
+	latencyNext = (latencyNext + 1) % PACING_LATENCY_FRAMES;
+	latencyCount = std::min(latencyCount + 1, PACING_LATENCY_FRAMES);
+
+	double sum = 0.0;
+	latencyMaxMs = 0.0;
+	for (int i = 0; i < latencyCount; i++)
+	{
+		sum += latencies[i];
+		latencyMaxMs = std::max(latencyMaxMs, latencies[i]);
+	}
+	latencyMs = sum / latencyCount;
+}
+
+void FrameFences::Delete()
+{
+	for (const Fence& fence : fences)
+		glDeleteSync(fence.sync);
+	fences.clear();
+	inFlight = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef FRAME_PACING_CLASS_H
+#define FRAME_PACING_CLASS_H
+
+#include<glad/glad.h>
+#include<chrono>
+#include<deque>
+
+// Frames the latency average covers
+#define PACING_LATENCY_FRAMES 64
+// The frame limiter sleeps until this close to the deadline and spins the rest, in ms
+#define PACING_SPIN_MS 1.5
+
+enum VsyncMode { VSYNC_OFF, VSYNC_ON, VSYNC_ADAPTIVE };
+
+// Frame pacing edited by the simulation, handed to the render thread with every snapshot
+struct PacingSettings {
+	int vsync;              // VsyncMode, adaptive tears late frames instead of waiting a whole refresh
+	float fpsCap;           // 0 is uncapped
+	// Swapped frames the GPU may still be working on before the render thread waits for the oldest
+	int maxFramesInFlight;
+	// Polls events again right before the camera matrices are built
+	bool lateInput;
+};
+
+// Caps the simulation loop's rate. Sleeps most of the way to the next deadline and spins
+// the last PACING_SPIN_MS, plain sleeps overshoot by up to a scheduler tick.
+class FrameLimiter
+{
+public:
+	// Time the last wait() spent
+	double waitMs;
+
+	FrameLimiter();
+	~FrameLimiter();
+	// Returns at 1/fps after the previous deadline, right away when fps is 0
+	void wait(float fps);
+
+private:
+	std::chrono::steady_clock::time_point next;
+};
+
+// Fences of the swapped frames the GPU may still be working on. Measures latency as the
+// time from a frame's input sample until its fence is seen signalled, which is an
+// estimate of input to photon that leaves out the display's own scanout.
+class FrameFences
+{
+public:
+	// Last frame
+	double waitMs;
+	int inFlight;
+	// Over the last PACING_LATENCY_FRAMES frames
+	double latencyMs, latencyMaxMs;
+
+	FrameFences();
+	// After the swap: fences the frame, collects the finished ones and waits while more than maxFrames are queued
+	void frameSwapped(std::chrono::steady_clock::time_point inputTime, int maxFrames);
+	void Delete();
+
+private:
+	struct Fence {
+		GLsync sync;
+		std::chrono::steady_clock::time_point inputTime;
+	};
+	std::deque<Fence> fences;
+	double latencies[PACING_LATENCY_FRAMES];
+	int latencyCount;
+	int latencyNext;
+
+	void finished(const Fence& fence);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include"GBuffer.h"
+#include"GLStats.h"
+
+GBuffer::GBuffer()
+	: FBO(0), albedo(0), normal(0), depth(0), width(0), height(0), emptyVAO(0)
+{
+}
+
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	// The lighting pass reads exactly one texel per pixel
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void GBuffer::resize(int width, int height)
+{
+	if (FBO && width == this->width && height == this->height)
+		return;
+	Delete();
+	this->width = width;
+	this->height = height;
+
+	albedo = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	normal = createTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+	depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR: G-buffer framebuffer is incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+void GBuffer::bindGeometry()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, width, height);
+	// Pixels left at the far plane are skipped by the lighting pass and keep the background
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::setupShader(Shader& shader)
+{
+	shader.Activate();
+	shader.setInt("gAlbedo", GBUFFER_ALBEDO_UNIT);
+	shader.setInt("gNormal", GBUFFER_NORMAL_UNIT);
+	shader.setInt("gDepth", GBUFFER_DEPTH_UNIT);
+}
+
+void GBuffer::lightPass(Shader& shader)
+{
+	const int units[3] = { GBUFFER_ALBEDO_UNIT, GBUFFER_NORMAL_UNIT, GBUFFER_DEPTH_UNIT };
+	const GLuint targets[3] = { albedo, normal, depth };
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_2D, targets[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	// Every pixel passes, the lighting pass writes the G-buffer depth back through gl_FragDepth
+	glDepthFunc(GL_ALWAYS);
+	shader.Activate();
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+}
+
+void GBuffer::Delete()
+{
+	if (FBO)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		GLuint targets[3] = { albedo, normal, depth };
+		glDeleteTextures(3, targets);
+		glDeleteVertexArrays(1, &emptyVAO);
+	}
+	FBO = albedo = normal = depth = emptyVAO = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef GBUFFER_CLASS_H
+#define GBUFFER_CLASS_H
+
+#include<glad/glad.h>
+
+#include "shaderClass.h"
+
+// Texture units of the G-buffer targets, after the material arrays and light buffers
+#define GBUFFER_ALBEDO_UNIT 11
+#define GBUFFER_NORMAL_UNIT 12
+#define GBUFFER_DEPTH_UNIT 13
+
+enum RenderPath {
+	RENDER_FORWARD = 0,
+	RENDER_DEFERRED = 1
+};
+
+// Render targets of the deferred path:
+//   albedo  RGBA8    rgb albedo, a ambient strength
+//   normal  RGBA16F  xy octahedral normal, z specular strength, w shininess
+//   depth   DEPTH24  world position is reconstructed from it in the lighting pass
+//
+// The geometry pass fills them with the GBUFFER variants of lit.frag, then
+// lightPass() shades every pixel once with its DEFERRED_LIGHTING variant. That pass reuses the
+// light clusters, so overdrawn fragments never pay for the light loop.
+class GBuffer
+{
+public:
+	GLuint FBO;
+	GLuint albedo, normal, depth;
+	int width, height;
+
+	GBuffer();
+
+	// (Re)creates the targets, a no-op when the size didn't change
+	void resize(int width, int height);
+	// Binds and clears the targets for the geometry pass
+	void bindGeometry();
+	// Points the G-buffer samplers of the lighting program at their units, once per program
+	void setupShader(Shader& shader);
+	// Shades the G-buffer into the currently bound framebuffer with a fullscreen triangle.
+	// Depth is written back too, so forward passes after it still depth test against the scene.
+	void lightPass(Shader& shader);
+	void Delete();
+
+private:
+	// Core profile needs a VAO bound even when the vertex shader makes up its vertices
+	GLuint emptyVAO;
+};
+
+#endif
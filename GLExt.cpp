@@ -0,0 +1,59 @@
+#include"GLExt.h"
+
+#include<cstring>
+#include<iostream>
+
+GLExtensions glExt;
+
+bool hasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && std::strcmp(ext, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	int version = major * 10 + minor;
+
+	if (version >= 44 || hasGLExtension("GL_ARB_buffer_storage"))
+	{
+		glExt.BufferStorage = (GLExtBufferStorageProc)load("glBufferStorage");
+		glExt.bufferStorage = glExt.BufferStorage != nullptr;
+	}
+
+	if (version >= 41 || hasGLExtension("GL_ARB_get_program_binary"))
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		glExt.GetProgramBinary = (GLExtGetProgramBinaryProc)load("glGetProgramBinary");
+		glExt.ProgramBinary = (GLExtProgramBinaryProc)load("glProgramBinary");
+		glExt.ProgramParameteri = (GLExtProgramParameteriProc)load("glProgramParameteri");
+		glExt.programBinary = formats > 0 && glExt.GetProgramBinary && glExt.ProgramBinary && glExt.ProgramParameteri;
+	}
+
+	if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+		glExt.MaxShaderCompilerThreads = (GLExtMaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+		glExt.MaxShaderCompilerThreads = (GLExtMaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+	if (glExt.MaxShaderCompilerThreads)
+	{
+		glExt.parallelShaderCompile = true;
+		// Let the driver pick as many threads as it likes
+		glExt.MaxShaderCompilerThreads(0xFFFFFFFF);
+	}
+
+	std::cout << "OpenGL " << major << "." << minor
+		<< " | buffer storage: " << (glExt.bufferStorage ? "yes" : "no")
+		<< " | program binaries: " << (glExt.programBinary ? "yes" : "no")
+		<< " | parallel compile: " << (glExt.parallelShaderCompile ? "yes" : "no") << std::endl;
+}
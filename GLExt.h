@@ -0,0 +1,62 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include<glad/glad.h>
+
+// glad was generated for plain 3.3 core, so anything newer is loaded here by hand
+// and only used when the driver reports it.
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP GLExtBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP GLExtGetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP GLExtProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP GLExtProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP GLExtMaxShaderCompilerThreadsProc)(GLuint count);
+
+struct GLExtensions {
+	// GL 4.4 / GL_ARB_buffer_storage
+	bool bufferStorage = false;
+	GLExtBufferStorageProc BufferStorage = nullptr;
+
+	// GL 4.1 / GL_ARB_get_program_binary, and the driver offers at least one format
+	bool programBinary = false;
+	GLExtGetProgramBinaryProc GetProgramBinary = nullptr;
+	GLExtProgramBinaryProc ProgramBinary = nullptr;
+	GLExtProgramParameteriProc ProgramParameteri = nullptr;
+
+	// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile: compiles and links
+	// run on driver threads and GL_COMPLETION_STATUS_KHR polls them without blocking
+	bool parallelShaderCompile = false;
+	GLExtMaxShaderCompilerThreadsProc MaxShaderCompilerThreads = nullptr;
+};
+
+extern GLExtensions glExt;
+
+// Checks the driver's extension list (core profile style, via glGetStringi)
+bool hasGLExtension(const char* name);
+// Loads the optional entry points, must be called after gladLoadGL with a current context
+void loadGLExtensions(GLADloadproc load);
+
+#endif
@@ -0,0 +1,155 @@
+#include"GLStats.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+GLStats glStats;
+
+long long GLStatsFrame::total(int counter) const
+{
+	long long sum = 0;
+	for (int pass = 0; pass < STATS_PASS_COUNT; pass++)
+		sum += values[pass][counter];
+	return sum;
+}
+
+GLStats::GLStats()
+	: historyCount(0), historyHead(0), currentPass(STATS_PASS_SETUP), csv(nullptr)
+{
+	memset(&current, 0, sizeof(current));
+	memset(&rolling, 0, sizeof(rolling));
+}
+
+void GLStats::setPass(int pass)
+{
+	currentPass = pass;
+}
+
+int GLStats::pass() const
+{
+	return currentPass;
+}
+
+void GLStats::add(int counter, long long value)
+{
+	current.values[currentPass][counter] += value;
+}
+
+void GLStats::draw(GLenum mode, GLsizei count)
+{
+	long long* values = current.values[currentPass];
+	values[STAT_DRAWS]++;
+	values[STAT_VERTICES] += count;
+	if (mode == GL_TRIANGLES)
+		values[STAT_TRIANGLES] += count / 3;
+	else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2)
+		values[STAT_TRIANGLES] += count - 2;
+}
+
+void GLStats::textureUpload(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+{
+	add(STAT_UPLOADS);
+	// Allocations without data, render targets and array storage, upload nothing
+	if (!pixels)
+		return;
+	int components = 4;
+	if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+		components = 1;
+	else if (format == GL_RG)
+		components = 2;
+	else if (format == GL_RGB)
+		components = 3;
+	int size = 1;
+	if (type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT)
+		size = 4;
+	else if (type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT || type == GL_SHORT)
+		size = 2;
+	add(STAT_UPLOAD_BYTES, (long long)width * height * depth * components * size);
+}
+
+void GLStats::endFrame(long long frame)
+{
+	history[historyHead] = current;
+	historyHead = (historyHead + 1) % GL_STATS_HISTORY;
+	historyCount = std::min(historyCount + 1, GL_STATS_HISTORY);
+
+	rolling.frames = historyCount;
+	rolling.last = current;
+	for (int row = 0; row <= STATS_PASS_COUNT; row++)
+	{
+		for (int counter = 0; counter < STAT_COUNT; counter++)
+		{
+			long long low = 0, high = 0, sum = 0;
+			for (int i = 0; i < historyCount; i++)
+			{
+				const GLStatsFrame& past = history[i];
+				long long value = row == STATS_PASS_COUNT ? past.total(counter) : past.values[row][counter];
+				low = i == 0 ? value : std::min(low, value);
+				high = std::max(high, value);
+				sum += value;
+			}
+			rolling.min[row][counter] = low;
+			rolling.max[row][counter] = high;
+			rolling.avg[row][counter] = historyCount ? (double)sum / historyCount : 0.0;
+		}
+	}
+
+	if (csv)
+	{
+		for (int pass = 0; pass < STATS_PASS_COUNT; pass++)
+		{
+			fprintf(csv, "%lld,%s", frame, passName(pass));
+			for (int counter = 0; counter < STAT_COUNT; counter++)
+				fprintf(csv, ",%lld", current.values[pass][counter]);
+			fprintf(csv, "\n");
+		}
+	}
+	memset(&current, 0, sizeof(current));
+}
+
+void GLStats::reset()
+{
+	memset(&current, 0, sizeof(current));
+}
+
+const GLStatsSummary& GLStats::summary() const
+{
+	return rolling;
+}
+
+bool GLStats::openCSV(const std::string& path)
+{
+	closeCSV();
+	csv = fopen(path.c_str(), "w");
+	if (!csv)
+	{
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	fprintf(csv, "frame,pass");
+	for (int counter = 0; counter < STAT_COUNT; counter++)
+		fprintf(csv, ",%s", counterName(counter));
+	fprintf(csv, "\n");
+	return true;
+}
+
+void GLStats::closeCSV()
+{
+	if (csv)
+		fclose(csv);
+	csv = nullptr;
+}
+
+const char* GLStats::passName(int pass)
+{
+	static const char* names[STATS_PASS_COUNT] = { "setup", "shadows", "prepass", "objects", "models", "lighting", "light_source", "transparent", "ui" };
+	return pass < STATS_PASS_COUNT ? names[pass] : "frame";
+}
+
+const char* GLStats::counterName(int counter)
+{
+	static const char* names[STAT_COUNT] = { "draws", "triangles", "vertices", "programs", "vertex_arrays", "buffer_binds",
+		"texture_binds", "framebuffers", "state", "uniforms", "uploads", "upload_bytes" };
+	return names[counter];
+}
@@ -0,0 +1,318 @@
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+#include<glad/glad.h>
+#include<cstdio>
+#include<string>
+
+// Counting every GL call costs a little on each one, so release builds (NDEBUG) compile
+// the counters out unless GL_STATS=1 is defined
+#ifndef GL_STATS
+#ifdef NDEBUG
+#define GL_STATS 0
+#else
+#define GL_STATS 1
+#endif
+#endif
+
+// Frames the rolling min/avg/max cover
+#define GL_STATS_HISTORY 120
+
+// Where the renderer is in the frame, calls are counted against the current pass
+enum GLStatsPass {
+	STATS_PASS_SETUP,       // everything outside the passes below: uploads, culling, clears
+	STATS_PASS_SHADOWS,
+	STATS_PASS_PREPASS,     // depth only, before the lit passes
+	STATS_PASS_OBJECTS,
+	STATS_PASS_MODELS,
+	STATS_PASS_LIGHTING,    // deferred light pass
+	STATS_PASS_LIGHT_SOURCE,
+	STATS_PASS_TRANSPARENT, // blended draws after the opaque scene
+	STATS_PASS_UI,
+	STATS_PASS_COUNT
+};
+
+enum GLStatsCounter {
+	STAT_DRAWS,
+	STAT_TRIANGLES,
+	STAT_VERTICES,          // indices for indexed draws
+	STAT_PROGRAMS,          // glUseProgram
+	STAT_VERTEX_ARRAYS,
+	STAT_BUFFER_BINDS,      // glBindBuffer and indexed uniform buffer binds
+	STAT_TEXTURE_BINDS,
+	STAT_FRAMEBUFFERS,      // binds, blits and pixel reads
+	STAT_STATE,             // enables, depth, blend and polygon state, viewports, clears, texture units, fences and queries
+	STAT_UNIFORMS,          // glUniform* calls
+	STAT_UPLOADS,           // buffer and texture data calls, buffer maps, persistent ring writes
+	STAT_UPLOAD_BYTES,
+	STAT_COUNT
+};
+
+struct GLStatsFrame {
+	long long values[STATS_PASS_COUNT][STAT_COUNT];
+	long long total(int counter) const;
+};
+
+// Rolling statistics over the last GL_STATS_HISTORY frames, frame totals in row STATS_PASS_COUNT
+struct GLStatsSummary {
+	int frames;
+	GLStatsFrame last;
+	long long min[STATS_PASS_COUNT + 1][STAT_COUNT];
+	long long max[STATS_PASS_COUNT + 1][STAT_COUNT];
+	double avg[STATS_PASS_COUNT + 1][STAT_COUNT];
+};
+
+// Counts the GL calls of the engine per frame and pass. Only the thread that owns the
+// context issues GL calls, so the counters are plain integers.
+//
+// GLStats.h redirects each counted GL entry point to a wrapper that counts and then calls
+// glad's function pointer. Every file that issues GL calls includes it after glad.h.
+// ImGui's backend draws outside of the engine, the renderer counts its draws from the
+// draw data instead.
+class GLStats
+{
+public:
+	GLStats();
+
+	void setPass(int pass);
+	int pass() const;
+	void add(int counter, long long value = 1);
+	void draw(GLenum mode, GLsizei count);
+	void textureUpload(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels);
+
+	// Closes the frame: updates the rolling statistics, writes the CSV rows and starts over
+	void endFrame(long long frame);
+	// Drops what was counted so far, e.g. the uploads of loading
+	void reset();
+	const GLStatsSummary& summary() const;
+
+	// One "frame,pass,counter..." row per pass and frame until closeCSV()
+	bool openCSV(const std::string& path);
+	void closeCSV();
+
+	static const char* passName(int pass);
+	static const char* counterName(int counter);
+
+private:
+	GLStatsFrame current;
+	GLStatsFrame history[GL_STATS_HISTORY];
+	int historyCount, historyHead;
+	int currentPass;
+	GLStatsSummary rolling;
+	FILE* csv;
+};
+
+extern GLStats glStats;
+
+// Switches the counted pass for the enclosing block and restores the previous one after it
+class GLStatsPassScope
+{
+public:
+	GLStatsPassScope(int pass)
+		: previous(glStats.pass())
+	{
+		glStats.setPass(pass);
+	}
+	~GLStatsPassScope()
+	{
+		glStats.setPass(previous);
+	}
+
+private:
+	int previous;
+};
+
+#if GL_STATS
+#define GL_STATS_CONCAT_(a, b) a##b
+#define GL_STATS_CONCAT(a, b) GL_STATS_CONCAT_(a, b)
+#define GL_STATS_PASS(pass) GLStatsPassScope GL_STATS_CONCAT(glStatsPass, __LINE__)(pass)
+#define GL_STATS_ADD(counter, value) glStats.add(counter, value)
+
+// Draws
+inline void glStatsDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) { glStats.draw(mode, count); glad_glDrawElements(mode, count, type, indices); }
+inline void glStatsDrawArrays(GLenum mode, GLint first, GLsizei count) { glStats.draw(mode, count); glad_glDrawArrays(mode, first, count); }
+#undef glDrawElements
+#define glDrawElements glStatsDrawElements
+#undef glDrawArrays
+#define glDrawArrays glStatsDrawArrays
+
+// Binds
+inline void glStatsUseProgram(GLuint program) { glStats.add(STAT_PROGRAMS); glad_glUseProgram(program); }
+inline void glStatsBindVertexArray(GLuint array) { glStats.add(STAT_VERTEX_ARRAYS); glad_glBindVertexArray(array); }
+inline void glStatsBindBuffer(GLenum target, GLuint buffer) { glStats.add(STAT_BUFFER_BINDS); glad_glBindBuffer(target, buffer); }
+inline void glStatsBindBufferBase(GLenum target, GLuint index, GLuint buffer) { glStats.add(STAT_BUFFER_BINDS); glad_glBindBufferBase(target, index, buffer); }
+inline void glStatsBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) { glStats.add(STAT_BUFFER_BINDS); glad_glBindBufferRange(target, index, buffer, offset, size); }
+inline void glStatsBindTexture(GLenum target, GLuint texture) { glStats.add(STAT_TEXTURE_BINDS); glad_glBindTexture(target, texture); }
+inline void glStatsBindFramebuffer(GLenum target, GLuint framebuffer) { glStats.add(STAT_FRAMEBUFFERS); glad_glBindFramebuffer(target, framebuffer); }
+#undef glUseProgram
+#define glUseProgram glStatsUseProgram
+#undef glBindVertexArray
+#define glBindVertexArray glStatsBindVertexArray
+#undef glBindBuffer
+#define glBindBuffer glStatsBindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase glStatsBindBufferBase
+#undef glBindBufferRange
+#define glBindBufferRange glStatsBindBufferRange
+#undef glBindTexture
+#define glBindTexture glStatsBindTexture
+#undef glBindFramebuffer
+#define glBindFramebuffer glStatsBindFramebuffer
+
+// Framebuffers
+inline void glStatsBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) { glStats.add(STAT_FRAMEBUFFERS); glad_glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter); }
+inline void glStatsReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) { glStats.add(STAT_FRAMEBUFFERS); glad_glReadPixels(x, y, width, height, format, type, pixels); }
+#undef glBlitFramebuffer
+#define glBlitFramebuffer glStatsBlitFramebuffer
+#undef glReadPixels
+#define glReadPixels glStatsReadPixels
+
+// Fixed function state
+inline void glStatsActiveTexture(GLenum texture) { glStats.add(STAT_STATE); glad_glActiveTexture(texture); }
+inline void glStatsEnable(GLenum cap) { glStats.add(STAT_STATE); glad_glEnable(cap); }
+inline void glStatsDisable(GLenum cap) { glStats.add(STAT_STATE); glad_glDisable(cap); }
+inline void glStatsDepthFunc(GLenum func) { glStats.add(STAT_STATE); glad_glDepthFunc(func); }
+inline void glStatsPolygonMode(GLenum face, GLenum mode) { glStats.add(STAT_STATE); glad_glPolygonMode(face, mode); }
+inline void glStatsPolygonOffset(GLfloat factor, GLfloat units) { glStats.add(STAT_STATE); glad_glPolygonOffset(factor, units); }
+inline void glStatsViewport(GLint x, GLint y, GLsizei width, GLsizei height) { glStats.add(STAT_STATE); glad_glViewport(x, y, width, height); }
+inline void glStatsClear(GLbitfield mask) { glStats.add(STAT_STATE); glad_glClear(mask); }
+inline void glStatsClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { glStats.add(STAT_STATE); glad_glClearColor(red, green, blue, alpha); }
+inline void glStatsClearBufferfv(GLenum buffer, GLint drawbuffer, const GLfloat* value) { glStats.add(STAT_STATE); glad_glClearBufferfv(buffer, drawbuffer, value); }
+inline void glStatsDepthMask(GLboolean flag) { glStats.add(STAT_STATE); glad_glDepthMask(flag); }
+inline void glStatsColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) { glStats.add(STAT_STATE); glad_glColorMask(red, green, blue, alpha); }
+inline void glStatsBlendFunc(GLenum sfactor, GLenum dfactor) { glStats.add(STAT_STATE); glad_glBlendFunc(sfactor, dfactor); }
+inline void glStatsBlendFuncSeparate(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha) { glStats.add(STAT_STATE); glad_glBlendFuncSeparate(sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha); }
+#undef glActiveTexture
+#define glActiveTexture glStatsActiveTexture
+#undef glEnable
+#define glEnable glStatsEnable
+#undef glDisable
+#define glDisable glStatsDisable
+#undef glDepthFunc
+#define glDepthFunc glStatsDepthFunc
+#undef glPolygonMode
+#define glPolygonMode glStatsPolygonMode
+#undef glPolygonOffset
+#define glPolygonOffset glStatsPolygonOffset
+#undef glViewport
+#define glViewport glStatsViewport
+#undef glClear
+#define glClear glStatsClear
+#undef glClearColor
+#define glClearColor glStatsClearColor
+#undef glClearBufferfv
+#define glClearBufferfv glStatsClearBufferfv
+#undef glDepthMask
+#define glDepthMask glStatsDepthMask
+#undef glColorMask
+#define glColorMask glStatsColorMask
+#undef glBlendFunc
+#define glBlendFunc glStatsBlendFunc
+#undef glBlendFuncSeparate
+#define glBlendFuncSeparate glStatsBlendFuncSeparate
+
+// Fences and queries
+inline GLsync glStatsFenceSync(GLenum condition, GLbitfield flags) { glStats.add(STAT_STATE); return glad_glFenceSync(condition, flags); }
+inline GLenum glStatsClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) { glStats.add(STAT_STATE); return glad_glClientWaitSync(sync, flags, timeout); }
+inline void glStatsBeginQuery(GLenum target, GLuint id) { glStats.add(STAT_STATE); glad_glBeginQuery(target, id); }
+inline void glStatsEndQuery(GLenum target) { glStats.add(STAT_STATE); glad_glEndQuery(target); }
+#undef glFenceSync
+#define glFenceSync glStatsFenceSync
+#undef glClientWaitSync
+#define glClientWaitSync glStatsClientWaitSync
+#undef glBeginQuery
+#define glBeginQuery glStatsBeginQuery
+#undef glEndQuery
+#define glEndQuery glStatsEndQuery
+
+// Uniforms
+inline void glStatsUniform1i(GLint location, GLint v0) { glStats.add(STAT_UNIFORMS); glad_glUniform1i(location, v0); }
+inline void glStatsUniform1f(GLint location, GLfloat v0) { glStats.add(STAT_UNIFORMS); glad_glUniform1f(location, v0); }
+inline void glStatsUniform2f(GLint location, GLfloat v0, GLfloat v1) { glStats.add(STAT_UNIFORMS); glad_glUniform2f(location, v0, v1); }
+inline void glStatsUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { glStats.add(STAT_UNIFORMS); glad_glUniform3f(location, v0, v1, v2); }
+inline void glStatsUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { glStats.add(STAT_UNIFORMS); glad_glUniform4f(location, v0, v1, v2, v3); }
+inline void glStatsUniform2fv(GLint location, GLsizei count, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniform2fv(location, count, value); }
+inline void glStatsUniform3fv(GLint location, GLsizei count, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniform3fv(location, count, value); }
+inline void glStatsUniform4fv(GLint location, GLsizei count, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniform4fv(location, count, value); }
+inline void glStatsUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniformMatrix2fv(location, count, transpose, value); }
+inline void glStatsUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniformMatrix3fv(location, count, transpose, value); }
+inline void glStatsUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glStats.add(STAT_UNIFORMS); glad_glUniformMatrix4fv(location, count, transpose, value); }
+#undef glUniform1i
+#define glUniform1i glStatsUniform1i
+#undef glUniform1f
+#define glUniform1f glStatsUniform1f
+#undef glUniform2f
+#define glUniform2f glStatsUniform2f
+#undef glUniform3f
+#define glUniform3f glStatsUniform3f
+#undef glUniform4f
+#define glUniform4f glStatsUniform4f
+#undef glUniform2fv
+#define glUniform2fv glStatsUniform2fv
+#undef glUniform3fv
+#define glUniform3fv glStatsUniform3fv
+#undef glUniform4fv
+#define glUniform4fv glStatsUniform4fv
+#undef glUniformMatrix2fv
+#define glUniformMatrix2fv glStatsUniformMatrix2fv
+#undef glUniformMatrix3fv
+#define glUniformMatrix3fv glStatsUniformMatrix3fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv glStatsUniformMatrix4fv
+
+// Uploads
+inline void glStatsBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	glStats.add(STAT_UPLOADS);
+	if (data)
+		glStats.add(STAT_UPLOAD_BYTES, size);
+	glad_glBufferData(target, size, data, usage);
+}
+inline void glStatsBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	glStats.add(STAT_UPLOADS);
+	glStats.add(STAT_UPLOAD_BYTES, size);
+	glad_glBufferSubData(target, offset, size, data);
+}
+inline void glStatsTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	glStats.textureUpload(width, height, 1, format, type, pixels);
+	glad_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+inline void glStatsTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	glStats.textureUpload(width, height, depth, format, type, pixels);
+	glad_glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+}
+inline void glStatsTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+{
+	glStats.textureUpload(width, height, depth, format, type, pixels);
+	glad_glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+}
+inline void glStatsTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) { glStats.add(STAT_UPLOADS); glad_glTexBuffer(target, internalformat, buffer); }
+// Mapped bytes are counted by whoever writes them, see RingBuffer
+inline void* glStatsMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) { glStats.add(STAT_UPLOADS); return glad_glMapBufferRange(target, offset, length, access); }
+inline GLboolean glStatsUnmapBuffer(GLenum target) { glStats.add(STAT_UPLOADS); return glad_glUnmapBuffer(target); }
+#undef glBufferData
+#define glBufferData glStatsBufferData
+#undef glBufferSubData
+#define glBufferSubData glStatsBufferSubData
+#undef glTexImage2D
+#define glTexImage2D glStatsTexImage2D
+#undef glTexImage3D
+#define glTexImage3D glStatsTexImage3D
+#undef glTexSubImage3D
+#define glTexSubImage3D glStatsTexSubImage3D
+#undef glTexBuffer
+#define glTexBuffer glStatsTexBuffer
+#undef glMapBufferRange
+#define glMapBufferRange glStatsMapBufferRange
+#undef glUnmapBuffer
+#define glUnmapBuffer glStatsUnmapBuffer
+
+#else
+#define GL_STATS_PASS(pass)
+#define GL_STATS_ADD(counter, value)
+#endif
+
+#endif
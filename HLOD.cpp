@@ -0,0 +1,275 @@
+#include"HLOD.h"
+#include"model.h"
+#include"JobSystem.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<unordered_map>
+#include<unordered_set>
+
+HLOD::HLOD()
+	: paletteMaterial(-1), sourceTriangles(0), proxyTriangles(0), buildMs(0.0)
+{
+}
+
+void HLOD::build(const Model& model, MaterialTable& table)
+{
+	auto start = std::chrono::steady_clock::now();
+	nodes.clear();
+	meshIndices.clear();
+	proxies.clear();
+	sourceTriangles = proxyTriangles = 0;
+	paletteMaterial = -1;
+	const std::vector<Mesh>& meshes = model.meshes;
+
+	// Without a slot for the palette every proxy would fall back to material 0
+	if (table.materials.size() >= MAX_MATERIALS)
+	{
+		std::cout << "HLOD_NO_PALETTE: the material table is full, " << model.sourcePath << " is drawn without proxies" << std::endl;
+		return;
+	}
+
+	// Mean colour of every material so far, textured ones were averaged when they loaded
+	const int blocks = HLOD_PALETTE_SIZE / HLOD_PALETTE_BLOCK;
+	std::vector<unsigned char> pixels((size_t)HLOD_PALETTE_SIZE * HLOD_PALETTE_SIZE * 4, 255);
+	int materialCount = std::min((int)table.materials.size(), blocks * blocks);
+	for (int m = 0; m < materialCount; m++)
+	{
+		const Material& material = table.materials[m];
+		glm::vec4 color = glm::clamp(material.diffuse < 0 ? material.baseColor : material.meanColor, 0.0f, 1.0f);
+		for (int y = 0; y < HLOD_PALETTE_BLOCK; y++)
+		{
+			for (int x = 0; x < HLOD_PALETTE_BLOCK; x++)
+			{
+				size_t texel = ((size_t)(m / blocks * HLOD_PALETTE_BLOCK + y) * HLOD_PALETTE_SIZE + m % blocks * HLOD_PALETTE_BLOCK + x) * 4;
+				for (int c = 0; c < 4; c++)
+					pixels[texel + c] = (unsigned char)std::lround(color[c] * 255.0f);
+			}
+		}
+	}
+	Material palette;
+	palette.name = model.sourcePath + "#hlod";
+	palette.diffuse = table.addTexture(palette.name, HLOD_PALETTE_SIZE, HLOD_PALETTE_SIZE, pixels.data());
+	paletteMaterial = table.addMaterial(palette);
+
+	std::vector<glm::vec3> meshLow(meshes.size()), meshHigh(meshes.size());
+	for (int i = 0; i < (int)meshes.size(); i++)
+	{
+		const Mesh& mesh = meshes[i];
+		if (mesh.blended || mesh.indices.empty())
+			continue;
+		meshLow[i] = meshHigh[i] = mesh.vertices[0].Position;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			meshLow[i] = glm::min(meshLow[i], vertex.Position);
+			meshHigh[i] = glm::max(meshHigh[i], vertex.Position);
+		}
+		meshIndices.push_back(i);
+		sourceTriangles += mesh.indices.size() / 3;
+	}
+	if (meshIndices.empty())
+		return;
+	split(meshLow, meshHigh, 0, (int)meshIndices.size(), 0);
+
+	// Every node merges all meshes under it, the nodes are simplified in parallel
+	std::vector<std::vector<Vertex>> proxyVertices(nodes.size());
+	std::vector<std::vector<unsigned int>> proxyIndices(nodes.size());
+	jobSystem.parallelFor((int)nodes.size(), 1, [&](int begin, int end) {
+		for (int n = begin; n < end; n++)
+		{
+			HLODNode& node = nodes[n];
+			std::vector<HLODInput> inputs;
+			long long triangles = 0;
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				const Mesh& mesh = meshes[meshIndices[i]];
+				int material = std::clamp(mesh.materialIndex, 0, materialCount - 1);
+				glm::vec2 uv = (glm::vec2(material % blocks, material / blocks) * (float)HLOD_PALETTE_BLOCK + HLOD_PALETTE_BLOCK * 0.5f) / (float)HLOD_PALETTE_SIZE;
+				inputs.push_back({ &mesh.vertices, &mesh.indices, uv });
+				triangles += mesh.indices.size() / 3;
+			}
+			glm::vec3 size = node.high - node.low;
+			float cell = std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f)) / HLOD_GRID;
+			simplify(inputs, node.low, cell, proxyVertices[n], proxyIndices[n]);
+			node.error = cell * std::sqrt(3.0f);
+			// A proxy that keeps most of the triangles isn't worth the memory
+			if (proxyIndices[n].empty() || (long long)proxyIndices[n].size() / 3 > triangles / 2)
+			{
+				proxyVertices[n].clear();
+				proxyIndices[n].clear();
+			}
+		}
+	});
+
+	// GL objects are made on this thread
+	proxies.reserve(nodes.size());
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		if (proxyIndices[n].empty())
+			continue;
+		nodes[n].proxy = (int)proxies.size();
+		proxyTriangles += proxyIndices[n].size() / 3;
+		proxies.emplace_back(proxyVertices[n], proxyIndices[n], vector<Texture>());
+		proxies.back().materialIndex = paletteMaterial;
+	}
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Splits meshIndices[first, first + count) by the mesh centres into quadrants around the
+// middle of the node, returns the node's index
+int HLOD::split(const std::vector<glm::vec3>& meshLow, const std::vector<glm::vec3>& meshHigh, int first, int count, int depth)
+{
+	HLODNode node;
+	node.low = meshLow[meshIndices[first]];
+	node.high = meshHigh[meshIndices[first]];
+	for (int i = first; i < first + count; i++)
+	{
+		node.low = glm::min(node.low, meshLow[meshIndices[i]]);
+		node.high = glm::max(node.high, meshHigh[meshIndices[i]]);
+	}
+	node.first = first;
+	node.count = count;
+	node.children[0] = node.children[1] = node.children[2] = node.children[3] = -1;
+	node.proxy = -1;
+	node.error = 0.0f;
+	int index = (int)nodes.size();
+	nodes.push_back(node);
+	if (count <= HLOD_LEAF_MESHES || depth >= HLOD_MAX_DEPTH)
+		return index;
+
+	glm::vec3 middle = (node.low + node.high) * 0.5f;
+	auto centre = [&](int mesh) { return (meshLow[mesh] + meshHigh[mesh]) * 0.5f; };
+	std::vector<int>::iterator begin = meshIndices.begin() + first, end = begin + count;
+	std::vector<int>::iterator xSplit = std::partition(begin, end, [&](int mesh) { return centre(mesh).x < middle.x; });
+	std::vector<int>::iterator zSplits[2] = {
+		std::partition(begin, xSplit, [&](int mesh) { return centre(mesh).z < middle.z; }),
+		std::partition(xSplit, end, [&](int mesh) { return centre(mesh).z < middle.z; })
+	};
+	int bounds[5] = { first, (int)(zSplits[0] - meshIndices.begin()), (int)(xSplit - meshIndices.begin()),
+		(int)(zSplits[1] - meshIndices.begin()), first + count };
+	// Meshes all in one quadrant, e.g. stacked floors, can't be split on this plane
+	for (int q = 0; q < 4; q++)
+	{
+		if (bounds[q + 1] - bounds[q] == count)
+			return index;
+	}
+	for (int q = 0; q < 4; q++)
+	{
+		if (bounds[q + 1] > bounds[q])
+		{
+			int child = split(meshLow, meshHigh, bounds[q], bounds[q + 1] - bounds[q], depth + 1);
+			nodes[index].children[q] = child;
+		}
+	}
+	return index;
+}
+
+int HLOD::select(const glm::vec3& eye, float pixelsPerUnit, float maxPixels, const std::vector<Mesh>& sources, std::vector<const Mesh*>& out) const
+{
+	// Nothing was built, every opaque source mesh is drawn
+	if (nodes.empty())
+	{
+		for (const Mesh& mesh : sources)
+		{
+			if (!mesh.blended)
+				out.push_back(&mesh);
+		}
+		return 0;
+	}
+	return selectNode(0, eye, pixelsPerUnit, maxPixels, sources, out);
+}
+
+int HLOD::selectNode(int index, const glm::vec3& eye, float pixelsPerUnit, float maxPixels, const std::vector<Mesh>& sources, std::vector<const Mesh*>& out) const
+{
+	const HLODNode& node = nodes[index];
+	// Nearest point of the bounds, a camera inside a node always opens it
+	float distance = glm::length(eye - glm::clamp(eye, node.low, node.high));
+	if (node.proxy >= 0 && node.error * pixelsPerUnit <= maxPixels * distance)
+	{
+		out.push_back(&proxies[node.proxy]);
+		return 1;
+	}
+	bool leaf = node.children[0] < 0 && node.children[1] < 0 && node.children[2] < 0 && node.children[3] < 0;
+	if (leaf)
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+			out.push_back(&sources[meshIndices[i]]);
+		return 0;
+	}
+	int proxyCount = 0;
+	for (int child : node.children)
+	{
+		if (child >= 0)
+			proxyCount += selectNode(child, eye, pixelsPerUnit, maxPixels, sources, out);
+	}
+	return proxyCount;
+}
+
+void HLOD::simplify(const std::vector<HLODInput>& inputs, const glm::vec3& low, float cell, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	struct Cluster {
+		glm::vec3 position;
+		glm::vec3 normal;
+		int count;
+	};
+	std::vector<Cluster> clusters;
+	std::unordered_map<uint64_t, unsigned int> cellClusters;
+	std::unordered_set<uint64_t> triangles;
+	std::vector<unsigned int> remap;
+	vertices.clear();
+	indices.clear();
+
+	for (const HLODInput& input : inputs)
+	{
+		remap.resize(input.vertices->size());
+		for (size_t v = 0; v < input.vertices->size(); v++)
+		{
+			const Vertex& vertex = (*input.vertices)[v];
+			glm::ivec3 coord = glm::ivec3(glm::floor((vertex.Position - low) / cell)) + (1 << 20);
+			uint64_t key = ((uint64_t)(coord.x & 0x1FFFFF) << 42) | ((uint64_t)(coord.y & 0x1FFFFF) << 21) | (uint64_t)(coord.z & 0x1FFFFF);
+			auto found = cellClusters.emplace(key, (unsigned int)clusters.size());
+			if (found.second)
+			{
+				// The first vertex in a cell picks its colour
+				clusters.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), 0 });
+				Vertex merged = {};
+				merged.TexCoords = input.uv;
+				vertices.push_back(merged);
+			}
+			Cluster& cluster = clusters[found.first->second];
+			cluster.position += vertex.Position;
+			cluster.normal += vertex.Normal;
+			cluster.count++;
+			remap[v] = found.first->second;
+		}
+
+		const std::vector<unsigned int>& source = *input.indices;
+		for (size_t i = 0; i + 2 < source.size(); i += 3)
+		{
+			unsigned int a = remap[source[i]], b = remap[source[i + 1]], c = remap[source[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			// The same three cells with the same winding are one triangle. A node has at most
+			// (HLOD_GRID + 1)^3 cells, so the cluster indices fit 21 bits each.
+			unsigned int first = std::min(a, std::min(b, c));
+			unsigned int rotated[3] = { a, b, c };
+			while (rotated[0] != first)
+				std::rotate(rotated, rotated + 1, rotated + 3);
+			uint64_t key = ((uint64_t)rotated[0] << 42) | ((uint64_t)rotated[1] << 21) | rotated[2];
+			if (!triangles.insert(key).second)
+				continue;
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+	}
+
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		vertices[i].Position = clusters[i].position / (float)clusters[i].count;
+		// Opposite faces of thin walls cancel out, those point up
+		float length = glm::length(clusters[i].normal);
+		vertices[i].Normal = length > 1e-6f ? clusters[i].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+}
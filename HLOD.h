@@ -0,0 +1,86 @@
+#ifndef HLOD_CLASS_H
+#define HLOD_CLASS_H
+
+#include <glm/glm.hpp>
+#include<vector>
+
+#include "mesh.h"
+#include "Material.h"
+
+class Model;
+
+// Source meshes a node keeps as a leaf instead of splitting further
+#define HLOD_LEAF_MESHES 16
+#define HLOD_MAX_DEPTH 10
+// Vertex clustering cells along the longest side of a node, sets how coarse its proxy is
+#define HLOD_GRID 64
+// The palette holds one 4x4 block per material, so the first mip levels don't mix neighbours
+#define HLOD_PALETTE_BLOCK 4
+#define HLOD_PALETTE_SIZE (16 * HLOD_PALETTE_BLOCK)
+
+// Level of detail selection edited by the simulation
+struct HLODSettings {
+	bool enabled;
+	// A proxy is drawn once its simplification error covers at most this many pixels
+	float maxPixelError;
+};
+
+// One node of the quadtree over the xz plane, bounds and errors are in model space
+struct HLODNode {
+	glm::vec3 low, high;
+	// Range of HLOD::meshIndices under this node
+	int first, count;
+	int children[4];   // -1 where a quadrant is empty, all -1 for a leaf
+	int proxy;         // index into HLOD::proxies, -1 when simplifying didn't pay off
+	float error;       // how far the proxy's vertices moved at most
+};
+
+// Geometry of one source mesh for simplify(), in model space
+struct HLODInput {
+	const std::vector<Vertex>* vertices;
+	const std::vector<unsigned int>* indices;
+	// Texel of the mesh's material in the palette
+	glm::vec2 uv;
+};
+
+// Hierarchical level of detail of a large static model, such as a city.
+//
+// build() sorts the opaque meshes into a quadtree over the ground plane and gives every node a
+// proxy: all meshes under it merged into one mesh and simplified by vertex clustering. Proxies
+// are textured with a palette of the mean colour of every material, so a proxy of any number
+// of meshes and materials is one draw. select() walks the tree from the root and stops at the
+// first node whose proxy error projects under the pixel budget, near nodes open up down to
+// the source meshes, a far district costs one draw. Blended meshes stay out of the tree.
+class HLOD
+{
+public:
+	// nodes[0] is the root
+	std::vector<HLODNode> nodes;
+	std::vector<int> meshIndices;
+	std::vector<Mesh> proxies;
+	int paletteMaterial;
+
+	// Totals of the last build()
+	long long sourceTriangles, proxyTriangles;
+	double buildMs;
+
+	HLOD();
+
+	// Needs the GL context and the model's material table before MaterialTable::build(), the
+	// palette is added to it. With the table full no proxies are built.
+	void build(const Model& model, MaterialTable& table);
+	// Appends the meshes to draw for a camera at eye in model space. pixelsPerUnit is the
+	// viewport height over 2 tan(fov / 2). Returns how many of them are proxies.
+	int select(const glm::vec3& eye, float pixelsPerUnit, float maxPixels, const std::vector<Mesh>& sources, std::vector<const Mesh*>& out) const;
+
+	// Vertex clustering (Rossignac and Borrel): vertices snap to a grid of cells of size cell
+	// starting at low, each occupied cell becomes one vertex at the mean of its members and
+	// triangles that collapse are dropped. Pure CPU work.
+	static void simplify(const std::vector<HLODInput>& inputs, const glm::vec3& low, float cell, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+private:
+	int split(const std::vector<glm::vec3>& meshLow, const std::vector<glm::vec3>& meshHigh, int first, int count, int depth);
+	int selectNode(int index, const glm::vec3& eye, float pixelsPerUnit, float maxPixels, const std::vector<Mesh>& sources, std::vector<const Mesh*>& out) const;
+};
+
+#endif
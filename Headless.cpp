@@ -0,0 +1,252 @@
+#include"Headless.h"
+#include"GLStats.h"
+
+#include<GLFW/glfw3.h>
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+
+#if defined(__linux__)
+#include<EGL/egl.h>
+#include<EGL/eglext.h>
+#define HEADLESS_EGL 1
+#endif
+
+bool HeadlessOptions::parse(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--headless")
+		{
+			enabled = true;
+			continue;
+		}
+		if (arg != "--size" && arg != "--frames" && arg != "--fps" && arg != "--camera-path" && arg != "--out" && arg != "--format" && arg != "--trace" && arg != "--stats-csv")
+			continue;
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value after " << arg << std::endl;
+			return false;
+		}
+		std::string value = argv[++i];
+		if (arg == "--size")
+		{
+			if (sscanf(value.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+			{
+				std::cout << "Expected --size WxH, got " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--frames")
+			frames = std::max(1, atoi(value.c_str()));
+		else if (arg == "--fps")
+			fps = std::max(1.0f, (float)atof(value.c_str()));
+		else if (arg == "--camera-path")
+			cameraPath = value;
+		else if (arg == "--out")
+			output = value;
+		else if (arg == "--trace")
+			trace = value;
+		else if (arg == "--stats-csv")
+			statsCSV = value;
+		else if (arg == "--format")
+		{
+			if (value != "png" && value != "raw" && value != "y4m")
+			{
+				std::cout << "Unknown --format " << value << ", expected png, raw or y4m" << std::endl;
+				return false;
+			}
+			format = value;
+		}
+	}
+	return true;
+}
+
+HeadlessContext::HeadlessContext()
+	: display(nullptr), context(nullptr), window(nullptr)
+{
+}
+
+bool HeadlessContext::create()
+{
+#ifdef HEADLESS_EGL
+	// Surfaceless Mesa first, it needs neither a display server nor a GPU
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cout << "ERROR: no EGL display for headless rendering" << std::endl;
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configCount = 0;
+	eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configCount);
+	const EGLint contextAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext eglContext = configCount ? eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs) : EGL_NO_CONTEXT;
+	// Everything is drawn into framebuffer objects, the context never needs a surface
+	if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "ERROR: failed to create a surfaceless OpenGL 3.3 context (EGL " << major << "." << minor << ")" << std::endl;
+		eglTerminate(eglDisplay);
+		return false;
+	}
+	display = eglDisplay;
+	context = eglContext;
+	return true;
+#else
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* hidden = glfwCreateWindow(1, 1, "OpenGL", NULL, NULL);
+	if (hidden == NULL)
+	{
+		std::cout << "ERROR: failed to create a hidden window for headless rendering" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(hidden);
+	window = hidden;
+	return true;
+#endif
+}
+
+void HeadlessContext::destroy()
+{
+#ifdef HEADLESS_EGL
+	if (display)
+	{
+		eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+		eglTerminate((EGLDisplay)display);
+	}
+#else
+	if (window)
+	{
+		glfwDestroyWindow((GLFWwindow*)window);
+		glfwTerminate();
+	}
+#endif
+	display = context = window = nullptr;
+}
+
+GLADloadproc HeadlessContext::loader() const
+{
+#ifdef HEADLESS_EGL
+	return (GLADloadproc)eglGetProcAddress;
+#else
+	return (GLADloadproc)glfwGetProcAddress;
+#endif
+}
+
+OffscreenTarget::OffscreenTarget()
+	: FBO(0), width(0), height(0), color(0), depth(0)
+{
+}
+
+bool OffscreenTarget::create(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (!complete)
+		std::cout << "ERROR: offscreen framebuffer is incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+void OffscreenTarget::Delete()
+{
+	if (FBO)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &color);
+		glDeleteRenderbuffers(1, &depth);
+	}
+	FBO = color = depth = 0;
+}
+
+CameraPath::CameraPath()
+{
+	for (int i = 0; i <= 16; i++)
+	{
+		float angle = glm::radians(22.5f * i);
+		keys.push_back({ 0.5f * i, glm::vec3(12.0f * std::sin(angle), 4.0f, 12.0f * std::cos(angle)), glm::vec3(0.0f, 1.0f, 0.0f) });
+	}
+}
+
+bool CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Failed to open camera path " << path << std::endl;
+		return false;
+	}
+	std::vector<Key> loaded;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream in(line);
+		Key key;
+		if (in >> key.time >> key.pos.x >> key.pos.y >> key.pos.z >> key.target.x >> key.target.y >> key.target.z)
+			loaded.push_back(key);
+	}
+	if (loaded.empty())
+	{
+		std::cout << "Camera path " << path << " has no keys" << std::endl;
+		return false;
+	}
+	std::sort(loaded.begin(), loaded.end(), [](const Key& a, const Key& b) { return a.time < b.time; });
+	keys = loaded;
+	return true;
+}
+
+void CameraPath::sample(float time, glm::vec3& pos, glm::vec3& target) const
+{
+	// Holds the first and last key outside the path
+	size_t next = 0;
+	while (next < keys.size() && keys[next].time < time)
+		next++;
+	if (next == 0 || next == keys.size())
+	{
+		const Key& key = keys[next == 0 ? 0 : keys.size() - 1];
+		pos = key.pos;
+		target = key.target;
+		return;
+	}
+	const Key& a = keys[next - 1];
+	const Key& b = keys[next];
+	float t = (time - a.time) / std::max(b.time - a.time, 1e-6f);
+	pos = glm::mix(a.pos, b.pos, t);
+	target = glm::mix(a.target, b.target, t);
+}
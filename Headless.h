@@ -0,0 +1,87 @@
+#ifndef HEADLESS_CLASS_H
+#define HEADLESS_CLASS_H
+
+#include<glad/glad.h>
+#include <glm/glm.hpp>
+#include<cstdio>
+#include<string>
+#include<vector>
+
+#include "FrameCapture.h"
+
+// "Graphics --headless [options]" renders a scripted camera path offscreen and writes every
+// frame out, without a window or any input. Options:
+//   --size WxH          framebuffer size, default 1200x1200
+//   --frames N          frames to render, default 120
+//   --fps N             simulated frame rate, the scene and the camera path advance 1/N s per frame
+//   --camera-path file  keyframes, one "time px py pz tx ty tz" line each (position and target)
+//   --out path          png: directory for frame_00000.png..., raw and y4m: one file, "-" streams to stdout
+//   --format png|raw|y4m  raw is packed top-down RGB24, e.g. for ffmpeg -f rawvideo -pix_fmt rgb24
+//   --trace file        Chrome trace JSON of the whole run, see Profiler.h
+//   --stats-csv file    GL calls of every frame and pass, see GLStats.h
+// Frames are read back through a FrameCapture. Per-frame CPU and GPU timings go to stderr.
+struct HeadlessOptions {
+	bool enabled = false;
+	int width = 1200, height = 1200;
+	int frames = 120;
+	float fps = 60.0f;
+	std::string cameraPath;
+	std::string output;
+	std::string format = "png";
+	std::string trace;
+	std::string statsCSV;
+
+	// Returns false on a malformed option, after printing why
+	bool parse(int argc, char** argv);
+};
+
+// An OpenGL 3.3 core context without a window. Uses a surfaceless EGL display where EGL
+// exists (Mesa llvmpipe works on machines without a GPU), a hidden GLFW window elsewhere.
+class HeadlessContext
+{
+public:
+	HeadlessContext();
+	bool create();
+	void destroy();
+	// Loader for gladLoadGLLoader and loadGLExtensions
+	GLADloadproc loader() const;
+
+private:
+	void* display;
+	void* context;
+	void* window;
+};
+
+// Color and depth renderbuffers the renderer draws into instead of a window
+class OffscreenTarget
+{
+public:
+	GLuint FBO;
+	int width, height;
+
+	OffscreenTarget();
+	bool create(int width, int height);
+	void Delete();
+
+private:
+	GLuint color, depth;
+};
+
+// Keyframed camera, positions and targets are interpolated linearly between keys
+class CameraPath
+{
+public:
+	struct Key {
+		float time;
+		glm::vec3 pos;
+		glm::vec3 target;
+	};
+	std::vector<Key> keys;
+
+	// Without a file the camera circles the scene once every 8 seconds
+	CameraPath();
+	bool load(const std::string& path);
+	void sample(float time, glm::vec3& pos, glm::vec3& target) const;
+};
+
+#endif
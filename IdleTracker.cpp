@@ -0,0 +1,173 @@
+#include"IdleTracker.h"
+
+#include<cstdio>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<sys/resource.h>
+#endif
+
+// FNV-1a offset basis, the hash of no tracked state
+#define IDLE_HASH_START 14695981039346656037ull
+
+static double secondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// User plus system time of the whole process, all threads
+static double processCpuSeconds()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+static double readNumber(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return -1.0;
+	double value = -1.0;
+	if (fscanf(file, "%lf", &value) != 1)
+		value = -1.0;
+	fclose(file);
+	return value;
+}
+
+// Energy of the CPU package so far in joules, -1 when RAPL is missing or root only
+static double packageJoules()
+{
+#if defined(__linux__)
+	double microjoules = readNumber("/sys/class/powercap/intel-rapl:0/energy_uj");
+	return microjoules < 0.0 ? -1.0 : microjoules * 1e-6;
+#else
+	return -1.0;
+#endif
+}
+
+// The counter wraps around at max_energy_range_uj
+static double packageJoulesRange()
+{
+	double microjoules = readNumber("/sys/class/powercap/intel-rapl:0/max_energy_range_uj");
+	return microjoules < 0.0 ? 0.0 : microjoules * 1e-6;
+}
+
+// Whole system draw while on battery, -1 otherwise
+static double batteryWatts()
+{
+#if defined(__linux__)
+	double microwatts = readNumber("/sys/class/power_supply/BAT0/power_now");
+	return microwatts <= 0.0 ? -1.0 : microwatts * 1e-6;
+#else
+	return -1.0;
+#endif
+}
+
+IdleTracker::IdleTracker()
+	: enabled(true), hash(IDLE_HASH_START), drawnHash(0), inputSeen(true), animated(false), settle(0),
+	windowDrawn(0), windowIdleSeconds(0.0)
+{
+	current = { 0, 0, 0.0, 0.0, 0.0, -1.0, "none" };
+	windowStart = std::chrono::steady_clock::now();
+	windowCpuSeconds = processCpuSeconds();
+	windowJoules = packageJoules();
+}
+
+void IdleTracker::begin()
+{
+	hash = IDLE_HASH_START;
+	animated = false;
+}
+
+void IdleTracker::animating(bool animating)
+{
+	animated = animated || animating;
+}
+
+void IdleTracker::input()
+{
+	inputSeen = true;
+}
+
+bool IdleTracker::needsFrame()
+{
+	bool changed = !enabled || inputSeen || animated || hash != drawnHash;
+	inputSeen = false;
+	drawnHash = hash;
+	if (changed)
+		settle = IDLE_SETTLE_FRAMES;
+	else if (settle > 0)
+		settle--;
+	else
+	{
+		idleStart = std::chrono::steady_clock::now();
+		return false;
+	}
+	return true;
+}
+
+void IdleTracker::frameDrawn()
+{
+	current.drawn++;
+	sample();
+}
+
+// Called after the wait for events returned, the time since needsFrame() counts as idle
+void IdleTracker::frameSkipped()
+{
+	current.skipped++;
+	windowIdleSeconds += secondsBetween(idleStart, std::chrono::steady_clock::now());
+	sample();
+}
+
+IdleStats IdleTracker::stats() const
+{
+	return current;
+}
+
+// Turns the totals of the last second into rates
+void IdleTracker::sample()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double seconds = secondsBetween(windowStart, now);
+	if (seconds < 1.0)
+		return;
+
+	double cpuSeconds = processCpuSeconds();
+	double joules = packageJoules();
+	current.drawnFps = (current.drawn - windowDrawn) / seconds;
+	current.idlePercent = 100.0 * windowIdleSeconds / seconds;
+	current.cpuPercent = 100.0 * (cpuSeconds - windowCpuSeconds) / seconds;
+	if (joules >= 0.0 && windowJoules >= 0.0)
+	{
+		double used = joules - windowJoules;
+		if (used < 0.0)
+			used += packageJoulesRange();
+		current.watts = used / seconds;
+		current.powerSource = "CPU package";
+	}
+	else
+	{
+		current.watts = batteryWatts();
+		current.powerSource = current.watts < 0.0 ? "none" : "battery";
+	}
+
+	windowStart = now;
+	windowDrawn = current.drawn;
+	windowIdleSeconds = 0.0;
+	windowCpuSeconds = cpuSeconds;
+	windowJoules = joules;
+}
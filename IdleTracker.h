@@ -0,0 +1,82 @@
+#ifndef IDLE_TRACKER_CLASS_H
+#define IDLE_TRACKER_CLASS_H
+
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<type_traits>
+
+// Frames still drawn after the last change, so ImGui hover highlights can settle before going idle
+#define IDLE_SETTLE_FRAMES 3
+// Longest an idle loop waits for events before checking the scene again, in seconds
+#define IDLE_WAIT_SECONDS 0.25
+
+// Counters of the editor loop, rates over the last second
+struct IdleStats {
+	long long drawn;       // frames submitted
+	long long skipped;     // loop iterations that waited instead
+	double drawnFps;
+	double idlePercent;    // of wall time spent waiting for events
+	double cpuPercent;     // process CPU time, 100 is one core busy
+	double watts;          // -1 without a readable sensor
+	const char* powerSource;
+};
+
+// Decides whether the editor loop has to draw.
+//
+// Everything that changes the picture is hashed each iteration with track(), and the GLFW
+// input callbacks call input(). A frame is drawn when the hash differs from the last drawn
+// one, input arrived or something animates, and for IDLE_SETTLE_FRAMES after that. Any
+// other iteration waits for events instead, and the window keeps showing the last
+// presented frame. Power comes from the RAPL package counter or the battery on Linux,
+// both are often unreadable without root.
+class IdleTracker
+{
+public:
+	// When false every iteration draws
+	bool enabled;
+
+	IdleTracker();
+
+	// Starts hashing this iteration's state
+	void begin();
+	// Plain values only, their bytes are hashed
+	template<typename T>
+	void track(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "track() hashes the value's bytes");
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		for (unsigned char byte : bytes)
+			hash = (hash ^ byte) * 1099511628211ull;
+	}
+	// Something moves on its own this iteration, e.g. animated lights or a recording
+	void animating(bool animating);
+	// From the GLFW callbacks, on the thread that polls events
+	void input();
+	// Ends tracking, true when this iteration has to draw
+	bool needsFrame();
+
+	void frameDrawn();
+	void frameSkipped();
+	IdleStats stats() const;
+
+private:
+	uint64_t hash, drawnHash;
+	bool inputSeen;
+	bool animated;
+	int settle;
+
+	// Totals at the start of the current one second window
+	std::chrono::steady_clock::time_point windowStart;
+	long long windowDrawn;
+	double windowIdleSeconds;
+	double windowCpuSeconds;
+	double windowJoules;
+	std::chrono::steady_clock::time_point idleStart;
+	IdleStats current;
+
+	void sample();
+};
+
+#endif
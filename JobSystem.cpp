@@ -0,0 +1,244 @@
+#include"JobSystem.h"
+#include"Profiler.h"
+
+#include<algorithm>
+
+JobSystem jobSystem;
+
+// Deque owned by the current thread, -1 outside the pool
+static thread_local int workerIndex = -1;
+
+JobCounter::JobCounter()
+	: pending(0)
+{
+}
+
+bool JobCounter::done() const
+{
+	return pending.load() == 0;
+}
+
+JobSystem::JobSystem()
+	: running(false), nextWorker(0), queued(0), started(false)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+void JobSystem::start(int threads)
+{
+	std::lock_guard<std::mutex> lock(startMutex);
+	stopWorkers();
+	startWorkers(threads);
+}
+
+void JobSystem::stop()
+{
+	std::lock_guard<std::mutex> lock(startMutex);
+	stopWorkers();
+}
+
+void JobSystem::startWorkers(int threads)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	threads = std::max(threads, 1);
+
+	// Deque 0 has no thread of its own, it collects the jobs of threads outside the pool
+	running = true;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::make_unique<Worker>());
+	for (int i = 1; i < threads; i++)
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	started = true;
+}
+
+void JobSystem::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+	{
+		if (worker->thread.joinable())
+			worker->thread.join();
+	}
+	workers.clear();
+	queued = 0;
+	started = false;
+}
+
+void JobSystem::ensureStarted()
+{
+	if (started)
+		return;
+	std::lock_guard<std::mutex> lock(startMutex);
+	if (!started)
+		startWorkers(0);
+}
+
+int JobSystem::threadCount()
+{
+	ensureStarted();
+	return (int)workers.size();
+}
+
+void JobSystem::push(Job job)
+{
+	int index = workerIndex >= 0 ? workerIndex : (int)(nextWorker++ % workers.size());
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->mutex);
+		workers[index]->jobs.push_back(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::pop(int self, Job& job)
+{
+	int count = (int)workers.size();
+	// Newest job of our own deque first, it is the one most likely still in cache
+	if (self >= 0)
+	{
+		std::lock_guard<std::mutex> lock(workers[self]->mutex);
+		if (!workers[self]->jobs.empty())
+		{
+			job = std::move(workers[self]->jobs.back());
+			workers[self]->jobs.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	// Then the oldest job of anyone else
+	int first = self >= 0 ? self + 1 : 0;
+	for (int i = 0; i < count; i++)
+	{
+		int victim = (first + i) % count;
+		if (victim == self)
+			continue;
+		std::lock_guard<std::mutex> lock(workers[victim]->mutex);
+		if (!workers[victim]->jobs.empty())
+		{
+			job = std::move(workers[victim]->jobs.front());
+			workers[victim]->jobs.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Job& job)
+{
+	job.work();
+	finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+	std::vector<std::function<void()>> ready;
+	std::vector<JobCounter*> readyCounters;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (--counter->pending > 0)
+			return;
+		ready.swap(counter->continuations);
+		readyCounters.swap(counter->continuationCounters);
+	}
+	for (size_t i = 0; i < ready.size(); i++)
+		push({ std::move(ready[i]), readyCounters[i] });
+}
+
+void JobSystem::run(std::function<void()> job, JobCounter* counter)
+{
+	ensureStarted();
+	if (counter)
+		counter->pending++;
+	push({ std::move(job), counter });
+}
+
+void JobSystem::runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter)
+{
+	ensureStarted();
+	if (counter)
+		counter->pending++;
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending > 0)
+		{
+			dependency.continuations.push_back(std::move(job));
+			dependency.continuationCounters.push_back(counter);
+			return;
+		}
+	}
+	push({ std::move(job), counter });
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	ensureStarted();
+	while (counter.pending > 0)
+	{
+		Job job;
+		if (pop(workerIndex, job))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+	// The last finish() may still hold the lock, the counter must outlive it
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::parallelFor(int count, int grain, const std::function<void(int, int)>& body)
+{
+	if (count <= 0)
+		return;
+	grain = std::max(grain, 1);
+	int threads = threadCount();
+	if (count <= grain || threads == 1)
+	{
+		body(0, count);
+		return;
+	}
+	// A few chunks per thread so stealing can even out uneven chunks
+	int chunks = std::min((count + grain - 1) / grain, threads * 4);
+	int size = (count + chunks - 1) / chunks;
+	JobCounter counter;
+	for (int begin = 0; begin < count; begin += size)
+	{
+		int end = std::min(begin + size, count);
+		run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	wait(counter);
+}
+
+void JobSystem::workerLoop(int index)
+{
+	workerIndex = index;
+#if PROFILING
+	std::string name = "Job " + std::to_string(index);
+	PROFILE_THREAD(name.c_str());
+#endif
+	while (running)
+	{
+		Job job;
+		if (pop(index, job))
+		{
+			execute(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return queued > 0 || !running; });
+	}
+	workerIndex = -1;
+}
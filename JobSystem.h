@@ -0,0 +1,92 @@
+#ifndef JOB_SYSTEM_CLASS_H
+#define JOB_SYSTEM_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+class JobSystem;
+
+// Counts the unfinished jobs of a group. Jobs started with runAfter() wait for it to
+// reach zero, wait() runs other jobs until it does.
+class JobCounter
+{
+public:
+	JobCounter();
+	bool done() const;
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending;
+	std::mutex mutex;
+	// Jobs started with runAfter() on this counter
+	std::vector<std::function<void()>> continuations;
+	std::vector<JobCounter*> continuationCounters;
+};
+
+// Work-stealing job scheduler shared by loading and the per-frame CPU work.
+//
+// Every worker owns a deque: it pushes and pops its own jobs at the back and steals
+// from the front of the others when it runs dry. Threads outside the pool hand their
+// jobs to the workers round robin. Waiting on a counter never blocks while there is
+// work, the waiting thread runs jobs itself, so a pool of N threads is N - 1 workers
+// plus whoever waits.
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// (Re)starts the pool, 0 picks the core count. 1 runs every job on the waiting thread.
+	void start(int threads = 0);
+	void stop();
+	int threadCount();
+
+	void run(std::function<void()> job, JobCounter* counter = nullptr);
+	// Starts job once dependency reached zero
+	void runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr);
+	void wait(JobCounter& counter);
+
+	// Calls body(begin, end) over [0, count) in chunks of at least grain items and
+	// returns when all are done. Counts up to grain run inline without any jobs.
+	void parallelFor(int count, int grain, const std::function<void(int, int)>& body);
+
+private:
+	struct Job {
+		std::function<void()> work;
+		JobCounter* counter;
+	};
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> running;
+	std::atomic<unsigned int> nextWorker;
+	// Jobs queued but not picked up yet, workers sleep while it is zero
+	std::atomic<int> queued;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<bool> started;
+	std::mutex startMutex;
+
+	void startWorkers(int threads);
+	void stopWorkers();
+	void ensureStarted();
+	void push(Job job);
+	bool pop(int self, Job& job);
+	void execute(Job& job);
+	void finish(JobCounter* counter);
+	void workerLoop(int index);
+};
+
+extern JobSystem jobSystem;
+
+#endif
@@ -0,0 +1,283 @@
+#include"LightCluster.h"
+#include"JobSystem.h"
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define LIGHT_CLUSTER_SSE 1
+#endif
+
+LightCluster::LightCluster(int dimX, int dimY, int dimZ)
+	: dimX(dimX), dimY(dimY), dimZ(dimZ), zNear(0.1f), zFar(100.0f), threadCount(0),
+	lightCount(0), maxClusterLights(0), cullMs(0.0), boundsProjection(0.0f)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		buffers[i] = 0;
+		textures[i] = 0;
+	}
+}
+
+float LightCluster::sliceScale() const
+{
+	return dimZ / std::log(zFar / zNear);
+}
+
+float LightCluster::sliceBias() const
+{
+	return -dimZ * std::log(zNear) / std::log(zFar / zNear);
+}
+
+// View space AABB of every cluster, only rebuilt when the projection changes
+void LightCluster::buildBounds(const glm::mat4& projection)
+{
+	bounds.resize((size_t)dimX * dimY * dimZ);
+	for (int z = 0; z < dimZ; z++)
+	{
+		float d0 = zNear * std::pow(zFar / zNear, (float)z / dimZ);
+		float d1 = zNear * std::pow(zFar / zNear, (float)(z + 1) / dimZ);
+		for (int y = 0; y < dimY; y++)
+		{
+			for (int x = 0; x < dimX; x++)
+			{
+				float ndcX[2] = { 2.0f * x / dimX - 1.0f, 2.0f * (x + 1) / dimX - 1.0f };
+				float ndcY[2] = { 2.0f * y / dimY - 1.0f, 2.0f * (y + 1) / dimY - 1.0f };
+				AABB box;
+				box.min = glm::vec3(1e30f);
+				box.max = glm::vec3(-1e30f);
+				for (float d : { d0, d1 })
+					for (float nx : ndcX)
+						for (float ny : ndcY)
+						{
+							// Symmetric perspective: view x = ndc x * depth / P[0][0]
+							glm::vec3 corner(nx * d / projection[0][0], ny * d / projection[1][1], -d);
+							box.min = glm::min(box.min, corner);
+							box.max = glm::max(box.max, corner);
+						}
+				bounds[x + dimX * (y + dimY * z)] = box;
+			}
+		}
+	}
+	boundsProjection = projection;
+}
+
+void LightCluster::cullSlice(int z)
+{
+	SliceLists& out = slices[z];
+	out.counts.assign((size_t)dimX * dimY, 0);
+	out.indices.clear();
+
+	float d0 = zNear * std::pow(zFar / zNear, (float)z / dimZ);
+	float d1 = zNear * std::pow(zFar / zNear, (float)(z + 1) / dimZ);
+
+	// Lights overlapping the slice's depth range, as SoA padded to a multiple of 4.
+	// Padding lanes get a negative squared radius so they never pass the test.
+	thread_local std::vector<float> cx, cy, cz, cr2;
+	thread_local std::vector<uint32_t> ids;
+	cx.clear(); cy.clear(); cz.clear(); cr2.clear(); ids.clear();
+	for (uint32_t i = 0; i < (uint32_t)viewLights.size(); i++)
+	{
+		const glm::vec4& l = viewLights[i];
+		float depth = -l.z;
+		if (depth + l.w < d0 || depth - l.w > d1)
+			continue;
+		cx.push_back(l.x); cy.push_back(l.y); cz.push_back(l.z); cr2.push_back(l.w * l.w);
+		ids.push_back(i);
+	}
+	size_t candidates = ids.size();
+	while (cx.size() % 4 != 0)
+	{
+		cx.push_back(0.0f); cy.push_back(0.0f); cz.push_back(0.0f); cr2.push_back(-1.0f);
+	}
+	if (candidates == 0)
+		return;
+
+	for (int y = 0; y < dimY; y++)
+	{
+		for (int x = 0; x < dimX; x++)
+		{
+			const AABB& box = bounds[x + dimX * (y + dimY * z)];
+			uint32_t count = 0;
+			for (size_t i = 0; i < cx.size(); i += 4)
+			{
+				// Squared distance from the sphere centre to the box, 4 lights at a time
+				int hits;
+#ifdef LIGHT_CLUSTER_SSE
+				__m128 zero = _mm_setzero_ps();
+				__m128 px = _mm_loadu_ps(&cx[i]), py = _mm_loadu_ps(&cy[i]), pz = _mm_loadu_ps(&cz[i]);
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), px), _mm_sub_ps(px, _mm_set1_ps(box.max.x))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), py), _mm_sub_ps(py, _mm_set1_ps(box.max.y))), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), pz), _mm_sub_ps(pz, _mm_set1_ps(box.max.z))), zero);
+				__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				hits = _mm_movemask_ps(_mm_cmple_ps(dist2, _mm_loadu_ps(&cr2[i])));
+#else
+				hits = 0;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					float dx = std::max(std::max(box.min.x - cx[i + lane], cx[i + lane] - box.max.x), 0.0f);
+					float dy = std::max(std::max(box.min.y - cy[i + lane], cy[i + lane] - box.max.y), 0.0f);
+					float dz = std::max(std::max(box.min.z - cz[i + lane], cz[i + lane] - box.max.z), 0.0f);
+					if (dx * dx + dy * dy + dz * dz <= cr2[i + lane])
+						hits |= 1 << lane;
+				}
+#endif
+				while (hits && count < MAX_LIGHTS_PER_CLUSTER)
+				{
+					int lane = 0;
+					while (!(hits & (1 << lane)))
+						lane++;
+					hits &= ~(1 << lane);
+					out.indices.push_back(ids[i + lane]);
+					count++;
+				}
+			}
+			out.counts[x + dimX * y] = count;
+		}
+	}
+}
+
+void LightCluster::cull(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar)
+{
+	JobCounter done;
+	cullAsync(lights, view, projection, zNear, zFar, done);
+	jobSystem.wait(done);
+}
+
+void LightCluster::cullAsync(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, JobCounter& done)
+{
+	PROFILE_SCOPE("Light culling");
+	cullStart = std::chrono::steady_clock::now();
+
+	if (zNear != this->zNear || zFar != this->zFar || bounds.size() != (size_t)dimX * dimY * dimZ || projection != boundsProjection)
+	{
+		this->zNear = zNear;
+		this->zFar = zFar;
+		buildBounds(projection);
+	}
+
+	// Spot lights are culled by the sphere around their whole range
+	viewLights.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+		viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(lights[i].pos, 1.0f)), lights[i].radius);
+	lightCount = (int)lights.size();
+
+	slices.resize(dimZ);
+	if (threadCount == 1)
+	{
+		for (int z = 0; z < dimZ; z++)
+			cullSlice(z);
+		merge();
+		return;
+	}
+	// One slice per job, slices near the camera hold far more lights than the distant ones
+	for (int z = 0; z < dimZ; z++)
+	{
+		jobSystem.run([this, z]() {
+			PROFILE_SCOPE("Cull slices");
+			cullSlice(z);
+		}, &slicesDone);
+	}
+	jobSystem.runAfter(slicesDone, [this]() { merge(); }, &done);
+}
+
+// Merges the per-slice lists into one compact index list
+void LightCluster::merge()
+{
+	PROFILE_SCOPE("Merge light lists");
+	grid.resize((size_t)dimX * dimY * dimZ * 2);
+	indices.clear();
+	maxClusterLights = 0;
+	for (int z = 0; z < dimZ; z++)
+	{
+		const SliceLists& slice = slices[z];
+		uint32_t offset = (uint32_t)indices.size();
+		for (int tile = 0; tile < dimX * dimY; tile++)
+		{
+			size_t cluster = (size_t)z * dimX * dimY + tile;
+			grid[cluster * 2] = offset;
+			grid[cluster * 2 + 1] = slice.counts[tile];
+			offset += slice.counts[tile];
+			maxClusterLights = std::max(maxClusterLights, (int)slice.counts[tile]);
+		}
+		indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+	}
+
+	cullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+}
+
+void LightCluster::upload(const std::vector<Light>& lights)
+{
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	if (!buffers[0])
+	{
+		glGenBuffers(3, buffers);
+		glGenTextures(3, textures);
+		for (int i = 0; i < 3; i++)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+			glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+			glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+		}
+	}
+
+	// Three texels per light: position/radius, colour*intensity/cos inner, direction/cos outer
+	std::vector<glm::vec4> data(std::max<size_t>(lights.size(), 1) * 3);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const Light& l = lights[i];
+		bool spot = l.type == LIGHT_SPOT;
+		data[i * 3 + 0] = glm::vec4(l.pos, l.radius);
+		data[i * 3 + 1] = glm::vec4(l.color * l.intensity, spot ? std::cos(glm::radians(l.innerAngle)) : 0.0f);
+		data[i * 3 + 2] = glm::vec4(spot ? glm::normalize(l.dir) : glm::vec3(0.0f), spot ? std::cos(glm::radians(l.outerAngle)) : -2.0f);
+	}
+
+	// glBufferData re-specifies the store each frame, so the driver orphans the old one
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(glm::vec4), data.data(), GL_STREAM_DRAW);
+	// Before the first cull both lists are empty, keep the stores non-zero sized
+	const uint32_t empty[2] = { 0, 0 };
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, grid.empty() ? sizeof(empty) : grid.size() * sizeof(uint32_t), grid.empty() ? empty : grid.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[2]);
+	glBufferData(GL_TEXTURE_BUFFER, indices.empty() ? sizeof(empty) : indices.size() * sizeof(uint32_t), indices.empty() ? empty : indices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightCluster::setupShader(Shader& shader)
+{
+	shader.Activate();
+	shader.setInt("lightData", LIGHT_DATA_UNIT);
+	shader.setInt("lightGrid", LIGHT_GRID_UNIT);
+	shader.setInt("lightIndices", LIGHT_INDEX_UNIT);
+}
+
+void LightCluster::bind()
+{
+	const int units[3] = { LIGHT_DATA_UNIT, LIGHT_GRID_UNIT, LIGHT_INDEX_UNIT };
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void LightCluster::Delete()
+{
+	if (buffers[0])
+	{
+		glDeleteBuffers(3, buffers);
+		glDeleteTextures(3, textures);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		buffers[i] = 0;
+		textures[i] = 0;
+	}
+}
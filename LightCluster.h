@@ -0,0 +1,107 @@
+#ifndef LIGHT_CLUSTER_CLASS_H
+#define LIGHT_CLUSTER_CLASS_H
+
+#include<glad/glad.h>
+#include <glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+#include<chrono>
+
+#include "shaderClass.h"
+#include "JobSystem.h"
+
+// Texture units of the light buffers, right after the material arrays
+#define LIGHT_DATA_UNIT 8
+#define LIGHT_GRID_UNIT 9
+#define LIGHT_INDEX_UNIT 10
+
+// Longest light list a single cluster may hold, bounds the fragment shader loop
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+enum LightType {
+	LIGHT_POINT = 0,
+	LIGHT_SPOT = 1
+};
+
+struct Light {
+	glm::vec3 pos = glm::vec3(0.0f);
+	// Distance where the light's contribution reaches zero
+	float radius = 5.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 1.0f;
+	// Spot lights only
+	glm::vec3 dir = glm::vec3(0.0f, -1.0f, 0.0f);
+	float innerAngle = 20.0f;
+	float outerAngle = 30.0f;
+	LightType type = LIGHT_POINT;
+};
+
+// Clustered light culling. The view frustum is split into a grid of
+// dimX * dimY screen tiles and dimZ exponentially spaced depth slices. Every frame
+// the lights are assigned to the clusters their bounding sphere touches, and the
+// fragment shaders only loop over the lights of the fragment's own cluster.
+//
+// cull() is pure CPU work and can run without a GL context, upload() then streams
+// the light data, per-cluster (offset, count) pairs and the compact index list
+// into texture buffers.
+class LightCluster
+{
+public:
+	int dimX, dimY, dimZ;
+	float zNear, zFar;
+	// 1 culls on the calling thread, anything else spreads the slices over the job system
+	int threadCount;
+
+	// Results of the last cull()
+	std::vector<uint32_t> grid;      // offset, count per cluster
+	std::vector<uint32_t> indices;   // light indices, grouped by cluster
+	int lightCount;
+	int maxClusterLights;
+	double cullMs;
+
+	LightCluster(int dimX = 16, int dimY = 16, int dimZ = 24);
+
+	// Assigns lights to clusters for the given camera
+	void cull(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar);
+	// cull() on the job system: the slices are culled by jobs and merged by a job that runs
+	// after all of them. The results and cullMs are ready once done is, the caller keeps
+	// working meanwhile. The lights are copied before it returns.
+	void cullAsync(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, JobCounter& done);
+	// Uploads the last cull() result, needs a current GL context
+	void upload(const std::vector<Light>& lights);
+	// Points the light samplers of a program at their texture units, once per program
+	void setupShader(Shader& shader);
+	// Binds the light buffers to their texture units
+	void bind();
+	// Depth slice mapping used by the shaders: slice = log(depth) * scale + bias
+	float sliceScale() const;
+	float sliceBias() const;
+	void Delete();
+
+private:
+	struct AABB {
+		glm::vec3 min, max;
+	};
+	std::vector<AABB> bounds;
+	glm::mat4 boundsProjection;
+
+	// Per depth slice output, merged into grid/indices after the workers finish
+	struct SliceLists {
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<SliceLists> slices;
+	std::vector<glm::vec4> viewLights;
+	// Slice jobs of the running cullAsync(), the merge waits for them
+	JobCounter slicesDone;
+	std::chrono::steady_clock::time_point cullStart;
+
+	GLuint buffers[3];
+	GLuint textures[3];
+
+	void buildBounds(const glm::mat4& projection);
+	void cullSlice(int z);
+	void merge();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include<iostream>
 #include<vector>
+#include<random>
+#include<chrono>
 
 #include<glad/glad.h>
 #include<GLFW/glfw3.h>
@@ -20,6 +22,25 @@
 #include "model.h"
 
 #include "Object.h"
+#include "GLExt.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+#include "Material.h"
+#include "Benchmark.h"
+#include "BenchSuite.h"
+#include "LightCluster.h"
+#include "GBuffer.h"
+#include "ShadowMap.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "Renderer.h"
+#include "JobSystem.h"
+#include "Headless.h"
+#include "Profiler.h"
+#include "GLStats.h"
+#include "IdleTracker.h"
+#include "FixedTimestep.h"
+#include "StaticBatcher.h"
 
 
 #include <assimp/Importer.hpp>
@@ -52,6 +73,36 @@ bool captureMouse = true;
 
 glm::vec3 mod2trans(0.0f, 0.0f, 0.0f);
 
+// Dynamic lights on top of the main light, drawn through the light clusters
+int lightCount = 64;
+float lightRadius = 4.0f;
+float lightIntensity = 6.0f;
+bool animateLights = true;
+
+// Forward shades while drawing, deferred fills the G-buffer and shades each pixel once
+int renderPath = RENDER_FORWARD;
+// Sorted blends exactly in back to front order, weighted blends approximately without sorting
+int transparency = TRANSPARENCY_SORTED;
+
+// Skips drawing while nothing on screen changes, the input callbacks wake it up
+IdleTracker idle;
+
+
+// Scatters count lights through the scene, origins keep the centre each light orbits around
+void scatterLights(std::vector<Light>& lights, std::vector<glm::vec3>& origins, int count) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> spread(-15.0f, 15.0f), height(0.2f, 6.0f), unit(0.0f, 1.0f);
+	lights.resize(count);
+	origins.resize(count);
+	for (int i = 0; i < count; i++) {
+		origins[i] = glm::vec3(spread(rng), height(rng), spread(rng));
+		lights[i].pos = origins[i];
+		lights[i].color = glm::vec3(unit(rng), unit(rng), unit(rng));
+		// Every fourth light is a spot pointing down
+		lights[i].type = i % 4 == 3 ? LIGHT_SPOT : LIGHT_POINT;
+	}
+}
+
 
 // Key input polling loop, to be called in the main loop
 void processInput(GLFWwindow* window, Camera& camera, float deltaTime) {
@@ -76,7 +127,8 @@ void processInput(GLFWwindow* window, Camera& camera, float deltaTime) {
 }
 // Mouse callback function-pos
 void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
-	
+	// Hovering the GUI redraws too
+	idle.input();
 	if (!captureMouse) {
 		return;
 	}
@@ -95,6 +147,7 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
 }
 // Mouse callback function-scroll
 void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+	idle.input();
 	// Zoom in when scrolling up (positive yoffset)
 	if (yoffset > 0) {
 		camera.fov -= 2.0f;
@@ -111,45 +164,137 @@ void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 		camera.fov = 90.0f;
 	}
 }
+// Input and window events the camera doesn't use still have to wake an idle loop
+void keyCallback(GLFWwindow* /*window*/, int /*key*/, int /*scancode*/, int /*action*/, int /*mods*/) {
+	idle.input();
+}
+void mouseButtonCallback(GLFWwindow* /*window*/, int /*button*/, int /*action*/, int /*mods*/) {
+	idle.input();
+}
+void windowEventCallback(GLFWwindow* /*window*/, int /*width*/, int /*height*/) {
+	idle.input();
+}
+void windowFocusCallback(GLFWwindow* /*window*/, int /*focused*/) {
+	idle.input();
+}
+// The window system lost the last presented frame, e.g. after being uncovered
+void windowRefreshCallback(GLFWwindow* /*window*/) {
+	idle.input();
+}
 
 
 
 
-int main() {
-	//initialize glfw
-	glfwInit();
+int main(int argc, char** argv) {
+	// "--bench <name>" runs a scripted benchmark scene instead of the editor
+	std::string benchName;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--bench")
+			benchName = argv[i + 1];
+	}
+	// "--no-shader-cache" compiles every program from source, to compare startup times
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--no-shader-cache")
+			shaderCache.enabled = false;
+	}
+	// "--no-static-batching" keeps every imported mesh a draw of its own
+	bool staticBatching = true;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--no-static-batching")
+			staticBatching = false;
+	}
 
-	//handshake glfw with proper OpenGL version 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	//Create window obj with 800x800 dimesnions 
+	PROFILE_THREAD("Main");
 
-	GLFWwindow* window = glfwCreateWindow(height, width, "OpenGL", NULL, NULL);
-	if (window == NULL) {
-		std::cout << "Failed to create GLFW Window" << std::endl;
-		glfwTerminate();
+	// "--bench-suite" runs the headless benchmark scenarios and writes JSON, see BenchSuite.h
+	SuiteOptions suite;
+	if (!suite.parse(argc, argv))
+		return -1;
+	if (suite.help)
+		return 0;
+	if (suite.enabled)
+		return runBenchSuite(suite);
+
+	// "--headless" renders a scripted camera path offscreen instead of opening the editor, see Headless.h
+	HeadlessOptions headless;
+#if GRAPHICS_HEADLESS
+	// graphics-headless of the CMake build never opens the editor
+	headless.enabled = true;
+#endif
+	if (!headless.parse(argc, argv))
+		return -1;
+	// Frames streamed to stdout must not mix with the log
+	if (headless.enabled && headless.output == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());
+
+	// CPU-only benchmarks don't need a window
+	if (!benchName.empty() && !benchmarkNeedsGL(benchName))
+		return runBenchmark(benchName, nullptr);
+	if (!benchName.empty() && headless.enabled) {
+		std::cout << "Benchmark '" << benchName << "' draws to a window and can't run headless" << std::endl;
 		return -1;
 	}
 
-	glfwMakeContextCurrent(window);
+	int viewWidth = headless.enabled ? headless.width : (int)width;
+	int viewHeight = headless.enabled ? headless.height : (int)height;
+	GLFWwindow* window = NULL;
+	HeadlessContext headlessContext;
+	if (headless.enabled) {
+		GUI = false;
+		if (!headlessContext.create())
+			return -1;
+		gladLoadGLLoader(headlessContext.loader());
+		loadGLExtensions(headlessContext.loader());
+	}
+	else {
+		//initialize glfw
+		glfwInit();
+
+		//handshake glfw with proper OpenGL version 
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		//Create window obj with 800x800 dimesnions 
+
+		window = glfwCreateWindow(height, width, "OpenGL", NULL, NULL);
+		if (window == NULL) {
+			std::cout << "Failed to create GLFW Window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
 
-	// Capture the cursor for first-person camera controls
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		glfwMakeContextCurrent(window);
 
-	// Set the mouse callback function
-	
-	glfwSetCursorPosCallback(window, mouseCallback);
-	glfwSetScrollCallback(window, mouseScrollCallback);
-	
+		// Capture the cursor for first-person camera controls
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-	stbi_set_flip_vertically_on_load(true);
+		// Set the mouse callback function
 
-	//load glad to config OpenGL
-	gladLoadGL();
-	glViewport(0, 0, height, width);
+		glfwSetCursorPosCallback(window, mouseCallback);
+		glfwSetScrollCallback(window, mouseScrollCallback);
+		// Installed before ImGui, which chains them
+		glfwSetKeyCallback(window, keyCallback);
+		glfwSetMouseButtonCallback(window, mouseButtonCallback);
+		glfwSetFramebufferSizeCallback(window, windowEventCallback);
+		glfwSetWindowFocusCallback(window, windowFocusCallback);
+		glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+
+		//load glad to config OpenGL
+		gladLoadGL();
+		loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	}
+
+	stbi_set_flip_vertically_on_load(true);
+	glViewport(0, 0, viewWidth, viewHeight);
 	glEnable(GL_DEPTH_TEST);
 
+	if (!benchName.empty()) {
+		int result = runBenchmark(benchName, window);
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
+
 	if (GUI) {
 		IMGUI_CHECKVERSION();
 		ImGui::CreateContext();
@@ -158,16 +303,25 @@ int main() {
 
 		ImGui_ImplGlfw_InitForOpenGL(window, true);
 		ImGui_ImplOpenGL3_Init("#version 330");
+		// Creates the font texture while the context is still current on this thread
+		ImGui_ImplOpenGL3_NewFrame();
 
 	}
 
 
 
-	Shader shaderProgram("default.vert", "default.frag");
-	Shader lightShader("light.vert", "light.frag");
-	Shader modelShader("model.vert", "model.frag");
-	modelShader.Activate();
-	
+	// Owns every GL resource of the frame loop, starts compiling the lit shaders right away
+	Renderer renderer(viewWidth, viewHeight);
+	MaterialTable& materials = renderer.materials;
+
+	// Headless frames go into an offscreen framebuffer of the requested size
+	OffscreenTarget offscreen;
+	if (headless.enabled) {
+		if (!offscreen.create(viewWidth, viewHeight))
+			return -1;
+		renderer.targetFBO = offscreen.FBO;
+	}
+
 
 
 	glm::mat4 model = glm::mat4(1.0f);
@@ -185,13 +339,35 @@ int main() {
 	// load models
 	// -----------
 
-	//Model ourModel("models/backpack/backpack.obj");
-	Model ourModel2("models/subaru_impreza.glb");
-	//Model ourModel("models/modern_luxury_wedding_arch_house_building_design.glb");
-	//Model ourModel("models/beautiful_city.glb");
-	Model ourModel("models/brutalist_interior.glb");
-	//Model ourModel("Aristotle.obj");
+	// Every model shares one material table so all their textures pack into the same arrays
+	//Model ourModel("models/backpack/backpack.obj", false, &materials);
+	Model ourModel2("models/subaru_impreza.glb", false, &materials);
+	//Model ourModel("models/modern_luxury_wedding_arch_house_building_design.glb", false, &materials);
+	//Model ourModel("models/beautiful_city.glb", false, &materials);
+	Model ourModel("models/brutalist_interior.glb", false, &materials);
+	//Model ourModel("Aristotle.obj", false, &materials);
+	// Meshes sharing a material are merged into a few draws, before the HLOD points at them
+	StaticBatcher batcher, batcher2;
+	if (staticBatching) {
+		batcher.build(ourModel);
+		batcher2.build(ourModel2);
+		std::cout << "Static batching: " << batcher.meshesBefore << " -> " << batcher.meshesAfter << " draws ("
+			<< batcher.mergedMeshes << " meshes merged) in " << batcher.buildMs << " ms, car " << batcher2.meshesBefore
+			<< " -> " << batcher2.meshesAfter << " draws in " << batcher2.buildMs << " ms" << std::endl;
+	}
+	// Distant groups of the static model's meshes are drawn as merged, simplified proxies
+	HLOD modelLod;
+	modelLod.build(ourModel, materials);
+	ourModel.hlod = &modelLod;
+	materials.build();
+
+	renderer.finishLoading();
+	std::cout << "Shaders: " << shaderCache.hits + shaderCache.misses << " programs in " << shaderCache.totalMs << " ms ("
+		<< (shaderCache.enabled && glExt.programBinary ? "cache: " + std::to_string(shaderCache.hits) + " hits, " + std::to_string(shaderCache.misses) + " misses" : std::string("cache off"))
+		<< "), " << renderer.litShaders.variantCount << " lit variants ready " << renderer.litShaders.buildMs << " ms after submit" << std::endl;
 	std::cout << "Model loaded with " << ourModel.meshes.size() << " meshes" << std::endl;
+	std::cout << "HLOD: " << modelLod.nodes.size() << " nodes, " << modelLod.proxies.size() << " proxies, "
+		<< modelLod.sourceTriangles << " -> " << modelLod.proxyTriangles << " triangles in " << modelLod.buildMs << " ms" << std::endl;
 	if (ourModel.meshes.empty()) {
 		std::cout << "ERROR: Failed to load model or model has no meshes!" << std::endl;
 		return -1;
@@ -199,7 +375,7 @@ int main() {
 
 	std::cout << "=== MODEL DEBUG INFO ===" << std::endl;
 	std::cout << "Number of meshes: " << ourModel.meshes.size() << std::endl;
-	std::cout << "Number of textures loaded: " << ourModel.textures_loaded.size() << std::endl;
+	std::cout << "Number of textures loaded: " << materials.textures.size() << std::endl;
 
 	// Debug each mesh
 	for (size_t i = 0; i < ourModel.meshes.size(); ++i) {
@@ -207,18 +383,11 @@ int main() {
 		std::cout << "\nMesh " << i << ":" << std::endl;
 		std::cout << "  Vertices: " << mesh.vertices.size() << std::endl;
 		std::cout << "  Indices: " << mesh.indices.size() << std::endl;
-		std::cout << "  Textures: " << mesh.textures.size() << std::endl;
-
-		// Debug textures for this mesh
-		for (size_t j = 0; j < mesh.textures.size(); ++j) {
-			auto& tex = mesh.textures[j];
-			std::cout << "    Texture " << j << ": " << tex.type
-				<< " (ID: " << tex.id << ", Path: '" << tex.path << "')" << std::endl;
-		}
+		std::cout << "  Material: " << mesh.materialIndex << std::endl;
 	}
 
 	// Test if any textures were loaded at all
-	if (ourModel.textures_loaded.empty()) {
+	if (materials.textures.empty()) {
 		std::cout << "\nWARNING: No textures were loaded from GLB file!" << std::endl;
 		std::cout << "This could be normal for GLB files with embedded textures." << std::endl;
 	}
@@ -242,13 +411,199 @@ int main() {
 	
 	glm::vec3 bkColor(0.9f, 0.9f, 0.9f);
 
+	std::vector<Light> lights;
+	std::vector<glm::vec3> lightOrigins;
+
+	// Edited here, handed to the render thread with every snapshot
+	CascadedShadowMap& shadowDefaults = renderer.shadows;
+	ShadowSettings shadowSettings = { shadowDefaults.enabled, shadowDefaults.shadowDistance, shadowDefaults.splitLambda,
+		shadowDefaults.depthBias, shadowDefaults.normalBias, false };
+	// Window recording, png frames go into a directory, raw and y4m into one file
+	CaptureSettings captureSettings = { false, false, false, "", "png", 60.0f };
+	char captureName[128] = "capture";
+	// Vsync, frame cap and frames in flight, see FramePacing.h
+	PacingSettings pacing = { VSYNC_ON, 0.0f, 2, true };
+	FrameLimiter limiter;
+	// The 3D scene shrinks when its GPU time goes over the budget, see DynamicResolution.h
+	ResolutionSettings resolutionSettings = { true, 16.0f, 0.5f, 1.0f };
+	// Depth prepass and front to back order of the opaque draws
+	OpaqueSettings opaqueSettings = { true, true, false };
+	// Proxies replace distant mesh groups of the static model
+	HLODSettings hlodSettings = { true, 4.0f };
+	auto inputTime = std::chrono::steady_clock::now();
+	// Frame shown in the profiler window, kept while paused
+	ProfileFrame profiledFrame;
+	bool profilerPaused = false;
+#if GL_STATS
+	// Pass shown in the GL calls window, STATS_PASS_COUNT is the whole frame
+	int statsPass = STATS_PASS_COUNT;
+#endif
+
+	// Moves the dynamic lights to where they are at time seconds
+	auto animateScene = [&](float time) {
+		PROFILE_SCOPE("Animate");
+		if ((int)lights.size() != lightCount)
+			scatterLights(lights, lightOrigins, lightCount);
+		for (size_t i = 0; i < lights.size(); i++) {
+			float phase = time * (animateLights ? 0.5f : 0.0f) + i;
+			lights[i].pos = lightOrigins[i] + glm::vec3(cos(phase), 0.0f, sin(phase)) * 2.0f;
+			lights[i].radius = lightRadius;
+			lights[i].intensity = lightIntensity;
+		}
+	};
+
+	// Everything of a snapshot except the camera and the GUI, shared with headless runs
+	auto fillScene = [&](FrameSnapshot& frame) {
+		PROFILE_SCOPE("Fill snapshot");
+		lightSrc.pos = lightPos;
+		frame.lightPos = lightPos;
+		frame.lightColor = lightCol;
+		frame.background = bkColor;
+		frame.renderPath = renderPath;
+		frame.transparency = transparency;
+		frame.shadows = shadowSettings;
+		shadowSettings.invalidateStatic = false;
+		frame.lights = lights;
+
+		// Transforms are spread over the job system, small scenes stay on this thread
+		frame.objects.resize(objs.size());
+		jobSystem.parallelFor((int)objs.size(), 64, [&](int begin, int end) {
+			PROFILE_SCOPE("Transforms");
+			for (int i = begin; i < end; i++) {
+				DrawPacket& packet = frame.objects[i];
+				packet = { &objs[i], nullptr, ObjectUniforms(), false };
+				packet.uniforms.model = objs[i].getModelMatrix();
+				packet.uniforms.normalMatrix = normalMatrix(packet.uniforms.model);
+				packet.uniforms.color = glm::vec4(objs[i].col, objs[i].opacity);
+			}
+		});
+
+		// ourModel never moves and lives in the shadow caches, ourModel2 is redrawn every frame
+		frame.models.clear();
+		DrawPacket modelPacket = { nullptr, &ourModel, ObjectUniforms(), true };
+		modelPacket.uniforms.model = glm::mat4(1.0f);
+		modelPacket.uniforms.normalMatrix = glm::mat4(1.0f);
+		modelPacket.uniforms.color = glm::vec4(1.0f);
+		frame.models.push_back(modelPacket);
+
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, ourModel2.pos);
+		model = glm::rotate(model, glm::radians(ourModel2.angle.x), glm::vec3(1.0f, 0.0f, 0.0f)); //x
+		model = glm::rotate(model, glm::radians(ourModel2.angle.y), glm::vec3(0.0f, 1.0f, 0.0f)); //y
+		model = glm::rotate(model, glm::radians(ourModel2.angle.z), glm::vec3(0.0f, 0.0f, 1.0f)); //z
+		model = glm::scale(model, glm::vec3(0.007f, 0.007f, 0.007f)); // Scale down by 100x
+		modelPacket.model = &ourModel2;
+		modelPacket.uniforms.model = model;
+		modelPacket.uniforms.normalMatrix = normalMatrix(model);
+		modelPacket.staticShadow = false;
+		frame.models.push_back(modelPacket);
+
+		frame.lightSource = { &lightSrc, nullptr, ObjectUniforms(), false };
+		frame.lightSource.uniforms.model = lightSrc.getModelMatrix();
+		frame.lightSource.uniforms.normalMatrix = normalMatrix(frame.lightSource.uniforms.model);
+		frame.lightSource.uniforms.color = glm::vec4(lightSrc.col, 1.0f);
+	};
+
+	if (headless.enabled) {
+		CameraPath path;
+		if (!headless.cameraPath.empty() && !path.load(headless.cameraPath))
+			return -1;
+		// Frames are read back through the pixel buffer ring and written on the encoder thread
+		FrameCapture capture;
+		CaptureSettings settings = { true, false, true, headless.output, headless.format, headless.fps };
+		if (!headless.output.empty() && !capture.start(viewWidth, viewHeight, settings))
+			return -1;
+
+		// Timestamps around each frame, read CAPTURE_RING frames later so they never stall
+		GLuint timeQueries[CAPTURE_RING][2];
+		glGenQueries(CAPTURE_RING * 2, &timeQueries[0][0]);
+		double cpuTimes[CAPTURE_RING];
+		FrameSnapshot frame;
+		double totalCpuMs = 0.0, totalGpuMs = 0.0;
+		auto reportFrame = [&](int f) {
+			GLuint64 gpuStart, gpuEnd;
+			glGetQueryObjectui64v(timeQueries[f % CAPTURE_RING][0], GL_QUERY_RESULT, &gpuStart);
+			glGetQueryObjectui64v(timeQueries[f % CAPTURE_RING][1], GL_QUERY_RESULT, &gpuEnd);
+			double gpuMs = (gpuEnd - gpuStart) / 1.0e6;
+			totalGpuMs += gpuMs;
+			std::cerr << "frame " << f << ": cpu " << cpuTimes[f % CAPTURE_RING] << " ms, gpu " << gpuMs << " ms" << std::endl;
+		};
+		if (!headless.trace.empty())
+			profiler.startTrace();
+#if GL_STATS
+		if (!headless.statsCSV.empty() && !glStats.openCSV(headless.statsCSV))
+			return -1;
+#else
+		if (!headless.statsCSV.empty())
+			std::cout << "GL stats are compiled out of this build, --stats-csv is ignored" << std::endl;
+#endif
+		auto runStart = std::chrono::steady_clock::now();
+		for (int f = 0; f < headless.frames; f++) {
+			float time = f / headless.fps;
+			animateScene(time);
+
+			glm::vec3 eye, target;
+			path.sample(time, eye, target);
+			frame.frame = f;
+			frame.projection = glm::perspective(glm::radians(camera.fov), (float)viewWidth / (float)viewHeight, 0.1f, 100.0f);
+			frame.view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+			frame.viewPos = eye;
+			frame.fov = glm::radians(camera.fov);
+			fillScene(frame);
+			frame.clearGui();
+
+			if (f >= CAPTURE_RING)
+				reportFrame(f - CAPTURE_RING);
+			auto cpuStart = std::chrono::steady_clock::now();
+			glQueryCounter(timeQueries[f % CAPTURE_RING][0], GL_TIMESTAMP);
+			renderer.draw(frame);
+			glQueryCounter(timeQueries[f % CAPTURE_RING][1], GL_TIMESTAMP);
+			capture.capture(offscreen.FBO, f);
+			double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+			cpuTimes[f % CAPTURE_RING] = cpuMs;
+			totalCpuMs += cpuMs;
+		}
+		for (int f = std::max(0, headless.frames - CAPTURE_RING); f < headless.frames; f++)
+			reportFrame(f);
+		capture.stop();
+		double runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+		CaptureStats captureStats = capture.stats();
+		std::cerr << headless.frames << " frames at " << viewWidth << "x" << viewHeight << " in " << runMs << " ms: cpu "
+			<< totalCpuMs / headless.frames << " ms, gpu " << totalGpuMs / headless.frames << " ms per frame" << std::endl;
+		std::cerr << "capture: " << captureStats.written << " frames written, " << captureStats.dropped << " dropped, "
+			<< captureStats.stalls << " readback stalls, " << captureStats.latencyMs << " ms latency, "
+			<< captureStats.writtenMBs << " MB/s" << std::endl;
+
+		if (!headless.trace.empty())
+			profiler.stopTrace(headless.trace);
+		glStats.closeCSV();
+		glDeleteQueries(CAPTURE_RING * 2, &timeQueries[0][0]);
+		profiler.Delete();
+		offscreen.Delete();
+		renderer.Delete();
+		headlessContext.destroy();
+		return 0;
+	}
+
+	// From here on this thread only simulates and fills snapshots, the render thread owns the context
+	PROFILE_THREAD("Simulation");
+	renderer.start(window);
+	long long frameIndex = 0;
+	double simulationMs = 0.0;
+	// Keyboard movement and light animation run in fixed ticks, frames blend the last two
+	FixedTimestep timestep;
+	int simulationRate = TIMESTEP_RATE;
+	glm::vec3 previousCameraPos = camera.pos;
+
 
 	while (!glfwWindowShouldClose(window)) {
+		// Waits before sampling anything, so the capped frame starts with fresh input
+		limiter.wait(pacing.fpsCap);
 		// Calculate delta time
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
-		lightSrc.pos = lightPos;
+		auto simulationStart = std::chrono::steady_clock::now();
 
 
 
@@ -258,66 +613,71 @@ int main() {
 
 		
 
-		// Process keyboard input
-		processInput(window, camera, deltaTime);
-
-		// Clear the screen'
-
-		glClearColor(bkColor.r, bkColor.g, bkColor.b, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		 
-		lightSrc.draw(lightShader, camera, lightPos, lightCol, (float) height / width);
-
-		for (Object& obj : objs) {  // Use reference
-			obj.draw(shaderProgram, camera, lightPos, lightCol, (float)height / width);
+		// Process keyboard input once per simulation tick
+		int steps = timestep.advance(deltaTime);
+		for (int i = 0; i < steps; i++) {
+			previousCameraPos = camera.pos;
+			processInput(window, camera, (float)timestep.step);
 		}
-		
-		
-
-
-		//tcube.draw(shaderProgram, camera, lightPos, lightCol);
-
-		// Activate shader and set uniforms
-		modelShader.Activate();
-
-		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), (float)width / (float)height, 0.1f, 100.0f);
-		glm::mat4 view = camera.getViewMatrix();
-		modelShader.setMat4("projection", projection);
-		modelShader.setMat4("view", view);
-
-		// Add lighting uniforms
-		modelShader.setVec3("lightPos", lightPos);
-		modelShader.setVec3("lightColor", lightCol); // White light
-		modelShader.setVec3("viewPos", camera.pos);
-
-		// render the loaded model
-		glm::mat4 model = glm::mat4(1.0f);
-		modelShader.setMat4("model", model);
-		ourModel.Draw(modelShader);
-
-
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, ourModel2.pos);
-		model = glm::rotate(model, glm::radians(ourModel2.angle.x), glm::vec3(1.0f, 0.0f, 0.0f)); //x
-		model = glm::rotate(model, glm::radians(ourModel2.angle.y), glm::vec3(0.0f, 1.0f, 0.0f)); //y
-		model = glm::rotate(model, glm::radians(ourModel2.angle.z), glm::vec3(0.0f, 0.0f, 1.0f)); //z
-		model = glm::scale(model, glm::vec3(0.007f, 0.007f, 0.007f)); // Scale down by 100x
-		
-		modelShader.setMat4("model", model);
-
-
-
-
-		ourModel2.Draw(modelShader);
-
+		// The frame shows the scene between the last two ticks
+		float alpha = timestep.alpha();
+		Camera view = camera;
+		view.pos = glm::mix(previousCameraPos, camera.pos, alpha);
+		animateScene((float)(timestep.time() - (1.0f - alpha) * timestep.step));
+
+		// Everything that shows on screen, an unchanged frame isn't drawn again
+		idle.begin();
+		idle.track(camera.pos);
+		idle.track(camera.front);
+		idle.track(camera.fov);
+		idle.track(lightPos);
+		idle.track(lightCol);
+		idle.track(lightCount);
+		idle.track(lightRadius);
+		idle.track(lightIntensity);
+		idle.track(renderPath);
+		idle.track(transparency);
+		idle.track(bkColor);
+		idle.track(GUI);
+		for (const Object& obj : objs) {
+			idle.track(obj.pos);
+			idle.track(obj.size);
+			idle.track(obj.angle);
+			idle.track(obj.col);
+			idle.track(obj.opacity);
+		}
+		idle.track(ourModel2.pos);
+		idle.track(ourModel2.angle);
+		idle.track(shadowSettings.enabled);
+		idle.track(shadowSettings.distance);
+		idle.track(shadowSettings.splitLambda);
+		idle.track(shadowSettings.depthBias);
+		idle.track(shadowSettings.normalBias);
+		idle.track(shadowSettings.invalidateStatic);
+		idle.track(opaqueSettings);
+		idle.track(hlodSettings);
+		// Recording wants every frame, a dragged widget may change state after the mouse stopped
+		idle.animating((animateLights && lightCount > 0) || captureSettings.enabled);
+		// Still blending towards the last tick
+		idle.animating(previousCameraPos != camera.pos);
+		idle.animating(GUI && ImGui::IsAnyItemActive());
+		if (!idle.needsFrame()) {
+			// The window keeps showing the last presented frame meanwhile
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+			inputTime = std::chrono::steady_clock::now();
+			idle.frameSkipped();
+			// Time spent waiting doesn't move the camera
+			lastFrame = glfwGetTime();
+			continue;
+		}
+		idle.frameDrawn();
 
 
 
 		if (GUI) {
-			// Start the Dear ImGui frame
-			ImGui_ImplOpenGL3_NewFrame();
+			PROFILE_SCOPE("GUI");
+			// Start the Dear ImGui frame, the render thread draws it with the snapshot
+			RenderStats stats = renderer.stats();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 
@@ -339,12 +699,107 @@ int main() {
 			ImGuiIO& io = ImGui::GetIO();
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
 			ImGui::End();
+
+
+			ImGui::Begin("Threads", &GUI);
+			ImGui::Text("Simulation: %.3f ms, %.3f ms waiting for a free snapshot", simulationMs, renderer.simulationWaitMs);
+			ImGui::Text("Render: %.3f ms submit, %.3f ms swap, %.3f ms waiting for a snapshot", stats.renderMs, stats.swapMs, stats.waitMs);
+			ImGui::Text("Render thread is %lld frame(s) behind", frameIndex - stats.frame);
+			ImGui::Text("Job system: %d threads", jobSystem.threadCount());
+			ImGui::Text("Command lists: %d commands, %.3f ms recording, %.3f ms replay", stats.commands, stats.recordMs, stats.replayMs);
+			if (ImGui::SliderInt("Simulation rate", &simulationRate, 10, 240, "%d ticks/s"))
+				timestep.setRate(simulationRate);
+			ImGui::SliderInt("Max ticks per frame", &timestep.maxSteps, 1, 16);
+			ImGui::Text("Simulation: %d tick(s) this frame, %lld total, %.2f s dropped", timestep.lastSteps, timestep.ticks, timestep.droppedSeconds);
+			IdleStats idleStats = idle.stats();
+			ImGui::Checkbox("Skip unchanged frames", &idle.enabled);
+			ImGui::Text("Frames: %lld drawn, %lld skipped, %.1f drawn/s, %.0f%% idle", idleStats.drawn, idleStats.skipped, idleStats.drawnFps, idleStats.idlePercent);
+			if (idleStats.watts >= 0.0)
+				ImGui::Text("CPU: %.0f%% of a core, %.2f W (%s)", idleStats.cpuPercent, idleStats.watts, idleStats.powerSource);
+			else
+				ImGui::Text("CPU: %.0f%% of a core, no readable power sensor", idleStats.cpuPercent);
+			ImGui::End();
+
+
+			ImGui::Begin("Profiler", &GUI);
+			bool profiling = profiler.enabled;
+			if (ImGui::Checkbox("Enabled", &profiling))
+				profiler.enabled = profiling;
+			ImGui::SameLine();
+			ImGui::Checkbox("Pause", &profilerPaused);
+			ImGui::SameLine();
+			if (!profiler.tracing()) {
+				if (ImGui::Button("Record trace"))
+					profiler.startTrace();
+			}
+			else if (ImGui::Button("Save trace.json")) {
+				profiler.stopTrace("trace.json");
+			}
+			if (!profilerPaused)
+				profiledFrame = profiler.latest();
+			ImGui::Text("Frame %lld: %.3f ms CPU, GPU passes of frame %lld: %.3f ms (%lld results missed)", profiledFrame.frame,
+				(profiledFrame.endNs - profiledFrame.startNs) / 1.0e6, profiledFrame.gpuFrame, profiledFrame.gpuMs, profiledFrame.gpuMissed);
+			profiler.drawFlameGraph(profiledFrame);
+			ImGui::End();
+
+
+			ImGui::Begin("GL Calls", &GUI);
+#if GL_STATS
+			const char* statsPasses[STATS_PASS_COUNT + 1];
+			for (int p = 0; p <= STATS_PASS_COUNT; p++)
+				statsPasses[p] = GLStats::passName(p);
+			ImGui::Combo("Pass", &statsPass, statsPasses, STATS_PASS_COUNT + 1);
+			ImGui::Text("Last %d frames", stats.calls.frames);
+			if (ImGui::BeginTable("calls", 5)) {
+				ImGui::TableSetupColumn("counter");
+				ImGui::TableSetupColumn("last");
+				ImGui::TableSetupColumn("min");
+				ImGui::TableSetupColumn("avg");
+				ImGui::TableSetupColumn("max");
+				ImGui::TableHeadersRow();
+				for (int c = 0; c < STAT_COUNT; c++) {
+					long long last = statsPass == STATS_PASS_COUNT ? stats.calls.last.total(c) : stats.calls.last.values[statsPass][c];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(GLStats::counterName(c));
+					ImGui::TableNextColumn();
+					ImGui::Text("%lld", last);
+					ImGui::TableNextColumn();
+					ImGui::Text("%lld", stats.calls.min[statsPass][c]);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.1f", stats.calls.avg[statsPass][c]);
+					ImGui::TableNextColumn();
+					ImGui::Text("%lld", stats.calls.max[statsPass][c]);
+				}
+				ImGui::EndTable();
+			}
+#else
+			ImGui::Text("GL stats are compiled out of this build (NDEBUG), define GL_STATS=1 to keep them");
+#endif
+			ImGui::End();
+
+
+			ImGui::Begin("Buffers", &GUI);
+			ImGui::Text("Uniform ring: %s", stats.persistentRing ? "persistent mapped" : "glBufferSubData fallback");
+			ImGui::Text("Streamed: %.1f KB/frame", stats.ringKB);
+			ImGui::Text("GL buffer calls: %.3f ms/frame", stats.bufferCallMs);
+			ImGui::Text("Fence waits: %.3f ms/frame", stats.fenceWaitMs);
+			ImGui::Separator();
+			ImGui::Text("Materials: %d in %d texture arrays", (int)materials.materials.size(), (int)materials.arrays.size());
+			ImGui::Text("Texture binds: %d/frame", stats.textureBinds);
+			ImGui::Separator();
+			ImGui::Text("Shader startup: %.1f ms, %d cached / %d compiled", shaderCache.totalMs, shaderCache.hits, shaderCache.misses);
+			ImGui::End();
 			
 
 			ImGui::Begin("Model", &GUI);
 
 			ImGui::DragFloat3("Model Position", &ourModel2.pos.x, 0.01f, -1000.0f, 1000.0f);
 			ImGui::DragFloat3("Rotation", &ourModel2.angle.x, 0.1f, -360.0f, 360.0f);
+			ImGui::Separator();
+			ImGui::Checkbox("HLOD", &hlodSettings.enabled);
+			ImGui::SliderFloat("Max pixel error", &hlodSettings.maxPixelError, 0.5f, 32.0f);
+			ImGui::Text("Model draws: %d, %d of them proxies", stats.modelDraws, stats.hlodProxies);
 			
 
 	
@@ -359,6 +814,92 @@ int main() {
 			ImGui::End();
 
 
+			ImGui::Begin("Shadows", &GUI);
+			ImGui::Checkbox("Enabled", &shadowSettings.enabled);
+			ImGui::SliderFloat("Distance", &shadowSettings.distance, 5.0f, 100.0f);
+			ImGui::SliderFloat("Split lambda", &shadowSettings.splitLambda, 0.0f, 1.0f);
+			ImGui::SliderFloat("Depth bias", &shadowSettings.depthBias, 0.0f, 0.01f, "%.5f");
+			ImGui::SliderFloat("Normal bias", &shadowSettings.normalBias, 0.0f, 5.0f);
+			if (ImGui::Button("Redraw static")) {
+				shadowSettings.invalidateStatic = true;
+			}
+			ImGui::Text("Shadow pass: %.3f ms CPU, %.3f ms GPU", stats.shadowCpuMs, stats.shadowGpuMs);
+			for (int c = 0; c < SHADOW_CASCADES; c++) {
+				ImGui::Text("Cascade %d: to %.1f, %d static redraws (%.1f/s)", c, stats.splits[c], stats.staticRedraws[c], stats.staticRedrawsPerSecond[c]);
+			}
+			ImGui::End();
+
+
+			ImGui::Begin("Capture", &GUI);
+			ImGui::Checkbox("Record", &captureSettings.enabled);
+			ImGui::Checkbox("Synchronous readback", &captureSettings.synchronous);
+			ImGui::InputText("Output", captureName, sizeof(captureName));
+			static const char* captureFormats[] = { "png", "raw", "y4m" };
+			for (int i = 0; i < 3; i++) {
+				if (i > 0)
+					ImGui::SameLine();
+				if (ImGui::RadioButton(captureFormats[i], captureSettings.format == captureFormats[i]))
+					captureSettings.format = captureFormats[i];
+			}
+			captureSettings.output = captureSettings.format == "png" ? captureName : std::string(captureName) + "." + captureSettings.format;
+			ImGui::Text("%s: %lld frames read, %lld written, %lld dropped, %lld stalls", stats.capture.active ? "Recording" : "Stopped",
+				stats.capture.captured, stats.capture.written, stats.capture.dropped, stats.capture.stalls);
+			ImGui::Text("Readback: %.3f ms on the render thread", stats.capture.readMs);
+			ImGui::Text("Latency: %.1f ms to disk, encoder %.2f ms/frame", stats.capture.latencyMs, stats.capture.encodeMs);
+			ImGui::Text("Throughput: %.1f frames/s, %.1f MB/s", stats.capture.encodedFps, stats.capture.writtenMBs);
+			ImGui::End();
+
+
+			ImGui::Begin("Frame Pacing", &GUI);
+			ImGui::Text("Vsync");
+			ImGui::SameLine();
+			ImGui::RadioButton("Off", &pacing.vsync, VSYNC_OFF);
+			ImGui::SameLine();
+			ImGui::RadioButton("On", &pacing.vsync, VSYNC_ON);
+			ImGui::SameLine();
+			ImGui::RadioButton(stats.adaptiveVsync ? "Adaptive" : "Adaptive (unsupported, on)", &pacing.vsync, VSYNC_ADAPTIVE);
+			ImGui::SliderFloat("FPS cap", &pacing.fpsCap, 0.0f, 480.0f, pacing.fpsCap > 0.0f ? "%.0f" : "off");
+			ImGui::SliderInt("Max frames in flight", &pacing.maxFramesInFlight, 1, 3);
+			ImGui::Checkbox("Late input sampling", &pacing.lateInput);
+			ImGui::Text("Latency, input to GPU done: %.2f ms average, %.2f ms max", stats.latencyMs, stats.latencyMaxMs);
+			ImGui::Text("Limiter: %.3f ms, frames in flight: %d, %.3f ms waiting for them", limiter.waitMs, stats.framesInFlight, stats.pacingWaitMs);
+			ImGui::End();
+
+
+			ImGui::Begin("Dynamic Resolution", &GUI);
+			ImGui::Checkbox("Enabled", &resolutionSettings.enabled);
+			ImGui::SliderFloat("GPU budget", &resolutionSettings.targetMs, 2.0f, 33.0f, "%.1f ms");
+			ImGui::SliderFloat("Min scale", &resolutionSettings.minScale, 0.25f, 1.0f, "%.2f");
+			ImGui::SliderFloat("Max scale", &resolutionSettings.maxScale, 0.25f, 2.0f, "%.2f");
+			ImGui::Text("Scene: %dx%d (%.0f%%), %.2f ms GPU", stats.sceneWidth, stats.sceneHeight, stats.resolutionScale * 100.0f, stats.sceneGpuMs);
+			ImGui::End();
+
+
+			ImGui::Begin("Dynamic Lights", &GUI);
+			ImGui::SliderInt("Count", &lightCount, 0, 8192);
+			ImGui::SliderFloat("Radius", &lightRadius, 0.5f, 20.0f);
+			ImGui::SliderFloat("Intensity", &lightIntensity, 0.0f, 50.0f);
+			ImGui::Checkbox("Animate", &animateLights);
+			ImGui::Text("Clusters: %dx%dx%d", stats.clusterDims[0], stats.clusterDims[1], stats.clusterDims[2]);
+			ImGui::Text("Culling: %.3f ms", stats.cullMs);
+			ImGui::Text("Light indices: %d (max %d per cluster)", stats.lightIndices, stats.maxClusterLights);
+			ImGui::Separator();
+			ImGui::RadioButton("Forward", &renderPath, RENDER_FORWARD);
+			ImGui::SameLine();
+			ImGui::RadioButton("Deferred", &renderPath, RENDER_DEFERRED);
+			ImGui::Separator();
+			ImGui::Checkbox("Depth prepass", &opaqueSettings.depthPrepass);
+			ImGui::Checkbox("Sort front to back", &opaqueSettings.sortFrontToBack);
+			ImGui::Checkbox("Overdraw view", &opaqueSettings.overdrawView);
+			ImGui::Text("Shaded fragments: %lld, %.2f per pixel", stats.shadedFragments, stats.overdraw);
+			ImGui::Separator();
+			ImGui::RadioButton("Sorted transparency", &transparency, TRANSPARENCY_SORTED);
+			ImGui::SameLine();
+			ImGui::RadioButton("Weighted OIT", &transparency, TRANSPARENCY_WEIGHTED);
+			ImGui::Text("Blended draws: %d, sorted in %.3f ms", stats.transparentDraws, stats.transparentSortMs);
+			ImGui::End();
+
+
 			for (int i = 0; i < objs.size(); ++i) {
 				
 				Object& obj = objs[i];
@@ -369,22 +910,61 @@ int main() {
 				ImGui::DragFloat("Scale", &obj.size, 0.1f, -0.01f, 1000.0f);
 				ImGui::DragFloat("Rotate", &obj.angle, 0.1f, -360.0f, 360.0f);
 				ImGui::ColorPicker3("Color", &obj.col.r);
+				ImGui::SliderFloat("Opacity", &obj.opacity, 0.0f, 1.0f);
 				ImGui::End();
 			}
 
-			// Render ImGui
 			ImGui::Render();
-			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		glfwSwapBuffers(window);
+		// Snapshot of everything the render thread needs, waits while it still draws the previous one
+		auto waitStart = std::chrono::steady_clock::now();
+		FrameSnapshot& frame = renderer.beginSnapshot();
+		auto fillStart = std::chrono::steady_clock::now();
+		// Mouse look that arrived while waiting for the slot still makes it into this frame
+		if (pacing.lateInput) {
+			glfwPollEvents();
+			inputTime = std::chrono::steady_clock::now();
+			glm::vec3 blended = view.pos;
+			view = camera;
+			view.pos = blended;
+		}
+		frame.frame = ++frameIndex;
+		frame.projection = glm::perspective(glm::radians(camera.fov), (float)width / (float)height, 0.1f, 100.0f);
+		frame.view = view.getViewMatrix();
+		frame.viewPos = view.pos;
+		frame.fov = glm::radians(camera.fov);
+		frame.zNear = 0.1f;
+		frame.zFar = 100.0f;
+		fillScene(frame);
+		frame.capture = captureSettings;
+		frame.pacing = pacing;
+		frame.resolution = resolutionSettings;
+		frame.opaque = opaqueSettings;
+		frame.hlod = hlodSettings;
+		frame.inputTime = inputTime;
+
+		if (GUI)
+			frame.captureGui();
+		else
+			frame.clearGui();
+		renderer.submit();
+
 		glfwPollEvents();
-		
+		inputTime = std::chrono::steady_clock::now();
+		auto simulationEnd = std::chrono::steady_clock::now();
+		simulationMs = std::chrono::duration<double, std::milli>(simulationEnd - simulationStart - (fillStart - waitStart)).count();
 	}
 
+	// Draws what is still queued and gives the context back to this thread
+	renderer.stop();
+	IdleStats idleStats = idle.stats();
+	std::cout << "Frames: " << idleStats.drawn << " drawn, " << idleStats.skipped << " skipped while idle" << std::endl;
+
 	
 	//glDeleteTextures(1, &texture);
-	modelShader.Delete();
+	profiler.Delete();
+	renderer.Delete();
 	//
 	glfwDestroyWindow(window);
 	glfwTerminate();
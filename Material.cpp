@@ -0,0 +1,276 @@
+#include"Material.h"
+#include"UniformBlocks.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+// Bilinear resize of RGBA8 pixels, used when a texture size did not get an array of its own
+static std::vector<unsigned char> resampleRGBA(const std::vector<unsigned char>& src, int sw, int sh, int dw, int dh)
+{
+	std::vector<unsigned char> dst((size_t)dw * dh * 4);
+	for (int y = 0; y < dh; y++)
+	{
+		float fy = (y + 0.5f) * sh / dh - 0.5f;
+		int y0 = std::clamp((int)fy, 0, sh - 1);
+		int y1 = std::min(y0 + 1, sh - 1);
+		float ty = std::clamp(fy - y0, 0.0f, 1.0f);
+		for (int x = 0; x < dw; x++)
+		{
+			float fx = (x + 0.5f) * sw / dw - 0.5f;
+			int x0 = std::clamp((int)fx, 0, sw - 1);
+			int x1 = std::min(x0 + 1, sw - 1);
+			float tx = std::clamp(fx - x0, 0.0f, 1.0f);
+			for (int c = 0; c < 4; c++)
+			{
+				float a = src[((size_t)y0 * sw + x0) * 4 + c] * (1 - tx) + src[((size_t)y0 * sw + x1) * 4 + c] * tx;
+				float b = src[((size_t)y1 * sw + x0) * 4 + c] * (1 - tx) + src[((size_t)y1 * sw + x1) * 4 + c] * tx;
+				dst[((size_t)y * dw + x) * 4 + c] = (unsigned char)(a * (1 - ty) + b * ty + 0.5f);
+			}
+		}
+	}
+	return dst;
+}
+
+MaterialTable::MaterialTable() : UBO(0), built(false), textureBinds(0)
+{
+}
+
+int MaterialTable::addTexture(const std::string& key, int width, int height, const unsigned char* rgba)
+{
+	auto found = textureKeys.find(key);
+	if (found != textureKeys.end())
+		return found->second;
+
+	PendingTexture texture;
+	texture.width = width;
+	texture.height = height;
+	texture.pixels.assign(rgba, rgba + (size_t)width * height * 4);
+	pending.push_back(std::move(texture));
+
+	int handle = (int)pending.size() - 1;
+	textureKeys[key] = handle;
+	return handle;
+}
+
+int MaterialTable::addMaterial(const Material& material)
+{
+	if (materials.size() >= MAX_MATERIALS)
+	{
+		std::cout << "MATERIAL_TABLE_FULL: " << material.name << " falls back to material 0" << std::endl;
+		return 0;
+	}
+	materials.push_back(material);
+	return (int)materials.size() - 1;
+}
+
+void MaterialTable::build()
+{
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	textures.assign(pending.size(), TextureRef());
+
+	// Group the large textures by size, the most common sizes get an array each
+	std::map<std::pair<int, int>, std::vector<int>> bySize;
+	std::vector<int> small;
+	for (int i = 0; i < (int)pending.size(); i++)
+	{
+		if (pending[i].width <= ATLAS_CELL && pending[i].height <= ATLAS_CELL)
+			small.push_back(i);
+		else
+			bySize[{ pending[i].width, pending[i].height }].push_back(i);
+	}
+	std::vector<std::vector<int>> groups;
+	for (auto& entry : bySize)
+		groups.push_back(entry.second);
+	std::sort(groups.begin(), groups.end(), [](const std::vector<int>& a, const std::vector<int>& b) {
+		return a.size() > b.size();
+	});
+
+	struct Bucket {
+		int width, height;
+		std::vector<int> members;
+	};
+	std::vector<Bucket> buckets;
+	std::vector<int> leftovers;
+	int slots = MAX_TEXTURE_ARRAYS - (small.empty() ? 0 : 1);
+	for (auto& group : groups)
+	{
+		size_t next = 0;
+		while (next < group.size() && (int)buckets.size() < slots)
+		{
+			Bucket bucket;
+			bucket.width = pending[group[0]].width;
+			bucket.height = pending[group[0]].height;
+			size_t count = std::min(group.size() - next, (size_t)maxLayers);
+			bucket.members.assign(group.begin() + next, group.begin() + next + count);
+			buckets.push_back(bucket);
+			next += count;
+		}
+		leftovers.insert(leftovers.end(), group.begin() + next, group.end());
+	}
+
+	// Sizes that did not get an array are resampled into the closest bucket by area
+	for (int index : leftovers)
+	{
+		PendingTexture& texture = pending[index];
+		int best = -1;
+		long bestDiff = 0;
+		for (int b = 0; b < (int)buckets.size(); b++)
+		{
+			if ((int)buckets[b].members.size() >= maxLayers)
+				continue;
+			long diff = std::abs((long)buckets[b].width * buckets[b].height - (long)texture.width * texture.height);
+			if (best < 0 || diff < bestDiff)
+			{
+				best = b;
+				bestDiff = diff;
+			}
+		}
+		if (best < 0)
+		{
+			std::cout << "MATERIAL_TABLE: no array room for a " << texture.width << "x" << texture.height << " texture" << std::endl;
+			continue;
+		}
+		texture.pixels = resampleRGBA(texture.pixels, texture.width, texture.height, buckets[best].width, buckets[best].height);
+		texture.width = buckets[best].width;
+		texture.height = buckets[best].height;
+		buckets[best].members.push_back(index);
+	}
+
+	for (Bucket& bucket : buckets)
+	{
+		GLuint id;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, bucket.width, bucket.height, (GLsizei)bucket.members.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		for (int layer = 0; layer < (int)bucket.members.size(); layer++)
+		{
+			int index = bucket.members[layer];
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, bucket.width, bucket.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pending[index].pixels.data());
+			textures[index].array = (int)arrays.size();
+			textures[index].layer = layer;
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		arrays.push_back(id);
+
+		std::cout << "Texture array " << arrays.size() - 1 << ": " << bucket.members.size()
+			<< " layers of " << bucket.width << "x" << bucket.height << std::endl;
+	}
+
+	// Small textures share an atlas. Each cell keeps a one texel border copied with
+	// wrap-around so linear filtering of repeated UVs does not bleed into neighbours.
+	if (!small.empty())
+	{
+		const int cell = ATLAS_CELL + 2;
+		const int perRow = ATLAS_SIZE / cell;
+		const int perLayer = perRow * perRow;
+		int layers = std::min(((int)small.size() + perLayer - 1) / perLayer, (int)maxLayers);
+		std::vector<unsigned char> atlas((size_t)ATLAS_SIZE * ATLAS_SIZE * 4 * layers, 255);
+
+		for (int i = 0; i < (int)small.size() && i < perLayer * layers; i++)
+		{
+			PendingTexture& texture = pending[small[i]];
+			int layer = i / perLayer;
+			int cx = (i % perLayer) % perRow * cell;
+			int cy = (i % perLayer) / perRow * cell;
+			for (int y = -1; y <= texture.height; y++)
+			{
+				int sy = (y + texture.height) % texture.height;
+				for (int x = -1; x <= texture.width; x++)
+				{
+					int sx = (x + texture.width) % texture.width;
+					size_t dst = (((size_t)layer * ATLAS_SIZE + cy + 1 + y) * ATLAS_SIZE + cx + 1 + x) * 4;
+					size_t src = ((size_t)sy * texture.width + sx) * 4;
+					std::copy(&texture.pixels[src], &texture.pixels[src] + 4, &atlas[dst]);
+				}
+			}
+			TextureRef& ref = textures[small[i]];
+			ref.array = (int)arrays.size();
+			ref.layer = layer;
+			ref.atlas = true;
+			ref.uvRect = glm::vec4((cx + 1.0f) / ATLAS_SIZE, (cy + 1.0f) / ATLAS_SIZE,
+				(float)texture.width / ATLAS_SIZE, (float)texture.height / ATLAS_SIZE);
+		}
+
+		GLuint id;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.data());
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		arrays.push_back(id);
+
+		std::cout << "Texture atlas " << arrays.size() - 1 << ": " << small.size()
+			<< " small textures in " << layers << " layers" << std::endl;
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// CPU copies are no longer needed
+	pending.clear();
+	pending.shrink_to_fit();
+
+	std::vector<MaterialGPU> block(MAX_MATERIALS);
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		block[i].baseColor = materials[i].baseColor;
+		block[i].uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		block[i].layer[0] = -1;
+		block[i].layer[1] = 0;
+		block[i].layer[2] = 0;
+		std::memcpy(&block[i].layer[3], &materials[i].alphaCutoff, sizeof(float));
+		if (materials[i].diffuse >= 0 && textures[materials[i].diffuse].array >= 0)
+		{
+			const TextureRef& ref = textures[materials[i].diffuse];
+			block[i].uvRect = ref.uvRect;
+			block[i].layer[0] = ref.array;
+			block[i].layer[1] = ref.layer;
+			block[i].layer[2] = ref.atlas ? 1 : 0;
+		}
+	}
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, block.size() * sizeof(MaterialGPU), block.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	built = true;
+	std::cout << "Material table: " << materials.size() << " materials, " << textures.size()
+		<< " textures in " << arrays.size() << " arrays" << std::endl;
+}
+
+void MaterialTable::setupShader(Shader& shader)
+{
+	shader.Activate();
+	for (int i = 0; i < MAX_TEXTURE_ARRAYS; i++)
+		shader.setInt("materialArrays[" + std::to_string(i) + "]", i);
+}
+
+void MaterialTable::bind()
+{
+	textureBinds = 0;
+	for (int i = 0; i < (int)arrays.size(); i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+		textureBinds++;
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, UBO);
+}
+
+void MaterialTable::Delete()
+{
+	if (!arrays.empty())
+		glDeleteTextures((GLsizei)arrays.size(), arrays.data());
+	arrays.clear();
+	if (UBO)
+		glDeleteBuffers(1, &UBO);
+	UBO = 0;
+}
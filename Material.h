@@ -0,0 +1,90 @@
+#ifndef MATERIAL_CLASS_H
+#define MATERIAL_CLASS_H
+
+#include<glad/glad.h>
+#include <glm/glm.hpp>
+#include<string>
+#include<vector>
+#include<map>
+
+#include "shaderClass.h"
+
+// Texture units 0..MAX_TEXTURE_ARRAYS-1 are reserved for the material arrays
+#define MAX_TEXTURE_ARRAYS 8
+// Must match MAX_MATERIALS in lit.frag, 256 * 48 bytes stays under the 16 KB UBO minimum
+#define MAX_MATERIALS 256
+// Textures up to this size go into the atlas instead of getting a layer of their own
+#define ATLAS_CELL 64
+#define ATLAS_SIZE 1024
+
+// Where a texture ended up after build()
+struct TextureRef {
+	int array = -1;
+	int layer = 0;
+	// xy offset and zw scale inside the layer, only the atlas uses a partial rect
+	glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	bool atlas = false;
+};
+
+struct Material {
+	std::string name;
+	glm::vec4 baseColor = glm::vec4(1.0f);
+	// Handle returned by MaterialTable::addTexture, -1 when untextured
+	int diffuse = -1;
+	// Decided at load: glTF's BLEND alpha mode, or for formats without one alpha below 1 in
+	// the colour or in any texel. Drawn in the transparent pass.
+	bool blended = false;
+	// glTF's MASK alpha mode: opaque, texels with alpha below the cutoff are discarded. 0 never discards.
+	float alphaCutoff = 0.0f;
+	// Average texel times baseColor, what distant HLOD proxies show of a textured material
+	glm::vec4 meanColor = glm::vec4(1.0f);
+};
+
+// Owns every material texture of the scene. Textures of the same size are packed
+// as layers of one GL_TEXTURE_2D_ARRAY and small ones share an atlas, so drawing
+// any number of meshes needs at most MAX_TEXTURE_ARRAYS binds per frame and each
+// mesh only selects its material with an integer index.
+class MaterialTable
+{
+public:
+	std::vector<Material> materials;
+	std::vector<TextureRef> textures;
+	// GL_TEXTURE_2D_ARRAY names, index i is bound to texture unit i
+	std::vector<GLuint> arrays;
+	GLuint UBO;
+	bool built;
+
+	// Binds issued by the last bind() call
+	int textureBinds;
+
+	MaterialTable();
+
+	// Queues RGBA8 pixels for packing, textures with the same key are only stored once
+	int addTexture(const std::string& key, int width, int height, const unsigned char* rgba);
+	int addMaterial(const Material& material);
+	// Packs the queued textures into arrays and uploads the material block
+	void build();
+	// Points the materialArrays samplers of a program at their texture units, once per program
+	void setupShader(Shader& shader);
+	// Binds every array and the material block, call once per frame before drawing
+	void bind();
+	void Delete();
+
+private:
+	struct PendingTexture {
+		int width, height;
+		std::vector<unsigned char> pixels;
+	};
+	std::vector<PendingTexture> pending;
+	std::map<std::string, int> textureKeys;
+};
+
+// std140 mirror of struct Material in lit.frag
+struct MaterialGPU {
+	glm::vec4 baseColor;
+	glm::vec4 uvRect;
+	// array, layer, atlas flag, bits of the float alpha cutoff
+	GLint layer[4];
+};
+
+#endif
@@ -1,5 +1,9 @@
 // Add this implementation to your model.h or create a model.cpp file
 #include "model.h"
+#include "JobSystem.h"
+#include "GLStats.h"
+#include <algorithm>
+#include <cstring>
 void Model::loadModel(string const& path)
 {
     // Use better flags for GLB files - especially important for larger models
@@ -23,6 +27,7 @@ void Model::loadModel(string const& path)
     }
 
     directory = path.substr(0, path.find_last_of('/'));
+    sourcePath = path;
 
     // Debug scene information
     cout << "=== SCENE DEBUG INFO ===" << endl;
@@ -37,6 +42,40 @@ void Model::loadModel(string const& path)
 
     // Process with identity matrix initially
     processNode(scene->mRootNode, scene, glm::mat4(1.0f));
+
+    // Vertices and diffuse textures are prepared on the job system, the GL objects and
+    // the material table are then filled on this thread in node order
+    vector<vector<Vertex>> vertices(nodeMeshes.size());
+    vector<vector<unsigned int>> indices(nodeMeshes.size());
+    vector<DecodedTexture> decoded(scene->mNumMaterials);
+
+    JobCounter textureJobs;
+    if (materialTable)
+    {
+        vector<bool> used(scene->mNumMaterials, false);
+        for (const NodeMesh& node : nodeMeshes)
+            used[node.mesh->mMaterialIndex] = true;
+        for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        {
+            aiString str;
+            if (!used[i] || scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &str) != aiReturn_SUCCESS)
+                continue;
+            string path = str.C_Str();
+            DecodedTexture* texture = &decoded[i];
+            jobSystem.run([this, path, texture]() {
+                texture->valid = decodeTexture(path.c_str(), texture->width, texture->height, texture->rgba);
+            }, &textureJobs);
+        }
+    }
+    jobSystem.parallelFor((int)nodeMeshes.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            processVertices(nodeMeshes[i].mesh, nodeMeshes[i].transform, vertices[i], indices[i]);
+    });
+    jobSystem.wait(textureJobs);
+
+    for (size_t i = 0; i < nodeMeshes.size(); i++)
+        meshes.push_back(processMesh(nodeMeshes[i].mesh, scene, vertices[i], indices[i], decoded));
+    nodeMeshes.clear();
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene, glm::mat4 parentTransform)
@@ -51,11 +90,11 @@ void Model::processNode(aiNode* node, const aiScene* scene, glm::mat4 parentTran
     cout << "Processing node: " << node->mName.C_Str()
         << " with " << node->mNumMeshes << " meshes" << endl;
 
-    // Process each mesh in this node
+    // Collect each mesh in this node, loadModel() processes them in parallel
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene, globalTransform));
+        nodeMeshes.push_back({ mesh, globalTransform });
     }
 
     // Process child nodes recursively
@@ -65,19 +104,17 @@ void Model::processNode(aiNode* node, const aiScene* scene, glm::mat4 parentTran
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 transform)
+void Model::processVertices(const aiMesh* mesh, const glm::mat4& transform, vector<Vertex>& vertices, vector<unsigned int>& indices)
 {
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-
-    // Debug mesh information
-    cout << "Processing mesh with " << mesh->mNumVertices << " vertices" << endl;
+    // Normals use the inverse transpose, it is the same for every vertex
+    glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(transform)));
+    glm::mat3 tangentMatrix = glm::mat3(transform);
 
     // Process vertices with transformation applied
+    vertices.resize(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
+        Vertex& vertex = vertices[i];
 
         // Apply transformation to vertex position
         glm::vec4 pos = glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
@@ -87,7 +124,6 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 transform)
         // Transform normals (use inverse transpose for correct normal transformation)
         if (mesh->HasNormals())
         {
-            glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(transform)));
             glm::vec3 normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
             vertex.Normal = glm::normalize(normalMatrix * normal);
         }
@@ -107,12 +143,12 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 transform)
             // Transform tangents if available
             if (mesh->mTangents) {
                 glm::vec3 tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
-                vertex.Tangent = glm::normalize(glm::mat3(transform) * tangent);
+                vertex.Tangent = glm::normalize(tangentMatrix * tangent);
             }
 
             if (mesh->mBitangents) {
                 glm::vec3 bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
-                vertex.Bitangent = glm::normalize(glm::mat3(transform) * bitangent);
+                vertex.Bitangent = glm::normalize(tangentMatrix * bitangent);
             }
         }
         else
@@ -123,17 +159,35 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 transform)
             vertex.m_BoneIDs[j] = 0;
             vertex.m_Weights[j] = 0.0f;
         }
-
-        vertices.push_back(vertex);
     }
 
     // Process indices (unchanged)
+    indices.clear();
+    indices.reserve((size_t)mesh->mNumFaces * 3);
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
+}
+
+Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, vector<Vertex>& vertices, vector<unsigned int>& indices, vector<DecodedTexture>& decoded)
+{
+    vector<Texture> textures;
+
+    // Debug mesh information
+    cout << "Processing mesh with " << mesh->mNumVertices << " vertices" << endl;
+
+    // With a material table the textures are packed there and the mesh keeps only an index
+    if (materialTable)
+    {
+        Mesh result(vertices, indices, textures);
+        result.materialIndex = loadMaterial(mesh->mMaterialIndex, scene, decoded[mesh->mMaterialIndex]);
+        result.blended = materialTable->materials[result.materialIndex].blended;
+        result.alphaTested = materialTable->materials[result.materialIndex].alphaCutoff > 0.0f;
+        return result;
+    }
 
     // Process materials (unchanged)
     if (mesh->mMaterialIndex >= 0)
@@ -190,6 +244,123 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type,
     return textures;
 }
 
+int Model::loadMaterial(unsigned int index, const aiScene* scene, DecodedTexture& decoded)
+{
+    auto found = materialIndices.find(index);
+    if (found != materialIndices.end())
+        return found->second;
+
+    aiMaterial* mat = scene->mMaterials[index];
+    Material material;
+    material.name = sourcePath + "#" + std::to_string(index);
+
+    aiColor4D color;
+    if (mat->Get(AI_MATKEY_COLOR_DIFFUSE, color) == aiReturn_SUCCESS)
+        material.baseColor = glm::vec4(color.r, color.g, color.b, color.a);
+    // OBJ's "d" and most exporters put transparency here, the diffuse alpha usually stays 1
+    float opacity = 1.0f;
+    mat->Get(AI_MATKEY_OPACITY, opacity);
+    material.baseColor.a *= opacity;
+    // glTF says how its alpha is meant, the keys are AI_MATKEY_GLTF_ALPHAMODE and
+    // AI_MATKEY_GLTF_ALPHACUTOFF of assimp's GltfMaterial.h
+    aiString alphaMode;
+    bool hasAlphaMode = mat->Get("$mat.gltf.alphaMode", 0, 0, alphaMode) == aiReturn_SUCCESS;
+    bool translucentTexel = false;
+
+    if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+    {
+        aiString str;
+        mat->GetTexture(aiTextureType_DIFFUSE, 0, &str);
+
+        if (decoded.valid)
+        {
+            // Embedded names like "*0" repeat between files, so keys are made unique per model
+            string key = str.C_Str()[0] == '*' ? sourcePath + str.C_Str() : directory + '/' + str.C_Str();
+            material.diffuse = materialTable->addTexture(key, decoded.width, decoded.height, decoded.rgba.data());
+            material.baseColor = glm::vec4(1.0f, 1.0f, 1.0f, opacity);
+            // Without an alpha mode, alpha channels that are 255 everywhere don't make a material blended
+            glm::dvec4 sum(0.0);
+            for (size_t i = 0; i + 3 < decoded.rgba.size(); i += 4)
+            {
+                sum += glm::dvec4(decoded.rgba[i], decoded.rgba[i + 1], decoded.rgba[i + 2], decoded.rgba[i + 3]);
+                translucentTexel = translucentTexel || decoded.rgba[i + 3] < 255;
+            }
+            material.meanColor = glm::vec4(sum / (255.0 * std::max<size_t>(decoded.rgba.size() / 4, 1))) * material.baseColor;
+            // The table keeps its own copy
+            decoded.rgba = vector<unsigned char>();
+        }
+    }
+
+    if (hasAlphaMode)
+    {
+        // OPAQUE ignores alpha whatever the texels hold, MASK cuts out in the opaque pass
+        string mode = alphaMode.C_Str();
+        material.blended = mode == "BLEND";
+        if (mode == "MASK")
+        {
+            material.alphaCutoff = 0.5f;
+            mat->Get("$mat.gltf.alphaCutoff", 0, 0, material.alphaCutoff);
+        }
+        else if (mode != "BLEND")
+            material.baseColor.a = material.meanColor.a = 1.0f;
+    }
+    else
+        material.blended = translucentTexel || material.baseColor.a < 1.0f;
+    int result = materialTable->addMaterial(material);
+    materialIndices[index] = result;
+    return result;
+}
+
+// Decodes a file or embedded texture to RGBA8 pixels for the material table
+bool Model::decodeTexture(const char* path, int& width, int& height, vector<unsigned char>& rgba)
+{
+    int nrComponents;
+    unsigned char* data = nullptr;
+
+    if (path[0] == '*')
+    {
+        int textureIndex = -1;
+        try {
+            textureIndex = std::stoi(string(path).substr(1));
+        }
+        catch (...) {}
+        if (!scene || textureIndex < 0 || textureIndex >= static_cast<int>(scene->mNumTextures)) {
+            cout << "Invalid embedded texture index: " << path << endl;
+            return false;
+        }
+
+        aiTexture* texture = scene->mTextures[textureIndex];
+        if (texture->mHeight != 0) {
+            // Uncompressed texels are stored as BGRA
+            width = texture->mWidth;
+            height = texture->mHeight;
+            rgba.resize((size_t)width * height * 4);
+            for (size_t i = 0; i < (size_t)width * height; i++) {
+                rgba[i * 4 + 0] = texture->pcData[i].r;
+                rgba[i * 4 + 1] = texture->pcData[i].g;
+                rgba[i * 4 + 2] = texture->pcData[i].b;
+                rgba[i * 4 + 3] = texture->pcData[i].a;
+            }
+            return true;
+        }
+        data = stbi_load_from_memory(reinterpret_cast<unsigned char*>(texture->pcData), texture->mWidth,
+            &width, &height, &nrComponents, 4);
+    }
+    else
+    {
+        string filename = directory + '/' + string(path);
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 4);
+    }
+
+    if (!data) {
+        cout << "Texture failed to decode: " << path << endl;
+        return false;
+    }
+    rgba.assign(data, data + (size_t)width * height * 4);
+    stbi_image_free(data);
+    return true;
+}
+
 unsigned int Model::loadEmbeddedTexture(const char* path)
 {
     if (!scene || path[0] != '*') {
@@ -1,38 +1,51 @@
 #include "Object.h"
+#include "GLStats.h"
 
 // Object class implementation
 void Object::resize(float n) {
     size = n;
 }
 
-void Object::draw(Shader shader, Camera cam, glm::vec3 lightPos, glm::vec3 lightCol, float ar) {
-    VAO1.Bind();
-
-    glm::mat4 projection = glm::mat4(1.0f);
-    projection = glm::perspective(glm::radians(cam.fov), ar, 0.1f, 100.0f);
-
+glm::mat4 Object::getModelMatrix() const {
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, pos);
     model = glm::scale(model, glm::vec3(size, size, size));
     model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+    return model;
+}
 
-    shader.Activate();
+void Object::writeUniforms(RingBuffer& ring) {
+    ObjectUniforms block;
+    block.model = getModelMatrix();
+    block.normalMatrix = normalMatrix(block.model);
+    block.color = glm::vec4(col, opacity);
+    uboOffset = ring.push(block);
+}
 
-    shader.setVec3("objectColor", col);
-    shader.setVec3("lightPos", lightPos);
-    shader.setVec3("viewPos", cam.pos);
-    shader.setVec3("lightColor", lightCol);
+void Object::draw(Shader& shader, RingBuffer& ring) {
+    draw(shader, ring, uboOffset);
+}
 
-    int projLoc1 = glGetUniformLocation(shader.ID, "projection");
-    glUniformMatrix4fv(projLoc1, 1, GL_FALSE, glm::value_ptr(projection));
+void Object::draw(Shader& shader, RingBuffer& ring, GLintptr offset) {
+    VAO1.Bind();
+    shader.Activate();
+    ring.bindRange(OBJECT_UBO_BINDING, offset, sizeof(ObjectUniforms));
 
-    int viewLoc1 = glGetUniformLocation(shader.ID, "view");
-    glUniformMatrix4fv(viewLoc1, 1, GL_FALSE, glm::value_ptr(cam.getViewMatrix()));
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+}
 
-    int modelLoc1 = glGetUniformLocation(shader.ID, "model");
-    glUniformMatrix4fv(modelLoc1, 1, GL_FALSE, glm::value_ptr(model));
+void Object::record(CommandList& list, const Shader& shader, const RingBuffer& ring, GLintptr offset) const {
+    list.useProgram(shader.ID);
+    list.bindVertexArray(VAO1.ID);
+    list.bindUniformRange(OBJECT_UBO_BINDING, ring.ID, offset, sizeof(ObjectUniforms));
+    list.drawElements((GLsizei)indices.size());
+}
 
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+void Object::recordDepth(CommandList& list, const Shader& shader, const RingBuffer& ring, GLintptr offset) const {
+    list.useProgram(shader.ID);
+    list.bindVertexArray(depthVAO.ID);
+    list.bindUniformRange(OBJECT_UBO_BINDING, ring.ID, offset, sizeof(ObjectUniforms));
+    list.drawElements((GLsizei)indices.size());
 }
 
 // Sphere class implementation
@@ -55,6 +68,10 @@ void Sphere::initialize() {
     VAO1.LinkAttrib(sphereVBO, 0, 3, GL_FLOAT, 6 * sizeof(float), (void*)0);
     VAO1.LinkAttrib(sphereVBO, 1, 3, GL_FLOAT, 6 * sizeof(float), (void*)(3 * sizeof(float)));
 
+    depthVAO.Bind();
+    depthVAO.LinkAttrib(sphereVBO, 0, 3, GL_FLOAT, 6 * sizeof(float), (void*)0);
+    sphereEBO.Bind();
+
     initialized = true;
 }
 
@@ -202,6 +219,10 @@ void Cube::initialize() {
     VAO1.LinkAttrib(cubeVBO, 0, 3, GL_FLOAT, 6 * sizeof(float), (void*)0);
     VAO1.LinkAttrib(cubeVBO, 1, 3, GL_FLOAT, 6 * sizeof(float), (void*)(3 * sizeof(float)));
 
+    depthVAO.Bind();
+    depthVAO.LinkAttrib(cubeVBO, 0, 3, GL_FLOAT, 6 * sizeof(float), (void*)0);
+    cubeEBO.Bind();
+
     initialized = true;
 }
 
@@ -210,33 +231,6 @@ LightSrc::LightSrc() : Sphere() {
     // Call the Sphere constructor
 }
 
-void LightSrc::draw(Shader shader, Camera cam, glm::vec3 lightPos, glm::vec3 lightCol, float ar) {
-    VAO1.Bind();
-
-    glm::mat4 projection = glm::mat4(1.0f);
-    projection = glm::perspective(glm::radians(cam.fov), ar, 0.1f, 100.0f);
-
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, pos);
-    model = glm::scale(model, glm::vec3(size, size, size));
-    model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-
-    shader.Activate();
-
-    shader.setVec3("lightColor", lightCol);
-
-    int projLoc1 = glGetUniformLocation(shader.ID, "projection");
-    glUniformMatrix4fv(projLoc1, 1, GL_FALSE, glm::value_ptr(projection));
-
-    int viewLoc1 = glGetUniformLocation(shader.ID, "view");
-    glUniformMatrix4fv(viewLoc1, 1, GL_FALSE, glm::value_ptr(cam.getViewMatrix()));
-
-    int modelLoc1 = glGetUniformLocation(shader.ID, "model");
-    glUniformMatrix4fv(modelLoc1, 1, GL_FALSE, glm::value_ptr(model));
-
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-}
-
 //Emplaces an object 0=CUBE 1=SPHERE
 void addShape(std::vector<Object>& objs, int s){
     switch (s) {
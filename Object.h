@@ -12,6 +12,9 @@
 #include "VBO.h"
 #include "EBO.h"
 #include "Camera.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+#include "CommandList.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -20,16 +23,31 @@
 class Object {
 public:
     VAO VAO1;
+    // Only the position attribute, for depth-only passes
+    VAO depthVAO;
 
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
     float angle = 0.0f;
     glm::vec3 pos;
     glm::vec3 col;
+    // Below 1 the object is drawn with the blended draws
+    float opacity = 1.0f;
     float size;
+    // Offset of this frame's "Object" block inside the uniform ring
+    GLintptr uboOffset = 0;
 
     void resize(float n);
-    virtual void draw(Shader shader, Camera cam, glm::vec3 lightPos, glm::vec3 lightCol, float ar);
+    glm::mat4 getModelMatrix() const;
+    // Writes the per-object uniform block into the ring, must happen before ring.commit()
+    void writeUniforms(RingBuffer& ring);
+    virtual void draw(Shader& shader, RingBuffer& ring);
+    // Draws with a block that was pushed elsewhere, for threads that must not touch uboOffset
+    void draw(Shader& shader, RingBuffer& ring, GLintptr offset);
+    // Same draw as a command, safe on any thread
+    void record(CommandList& list, const Shader& shader, const RingBuffer& ring, GLintptr offset) const;
+    // The same through depthVAO
+    void recordDepth(CommandList& list, const Shader& shader, const RingBuffer& ring, GLintptr offset) const;
 };
 
 class Sphere : public Object {
@@ -59,7 +77,6 @@ public:
 class LightSrc : public Sphere {
 public:
     LightSrc();
-    void draw(Shader shader, Camera cam, glm::vec3 lightPos, glm::vec3 lightCol, float ar) override;
 };
 
 
@@ -0,0 +1,363 @@
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include "imgui.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<iostream>
+
+Profiler profiler;
+
+// Buffer of the current thread, registered by its first scope
+static thread_local void* threadBuffer = nullptr;
+
+ProfileFrame::ProfileFrame()
+	: frame(0), startNs(0), endNs(0), gpuFrame(-1), gpuMs(0.0), gpuMissed(0)
+{
+}
+
+Profiler::Profiler()
+	: enabled(true), frameStartNs(nowNs()), querySet(0), gpuActive(false), recording(false)
+{
+	for (QuerySet& set : querySets)
+	{
+		set.used = 0;
+		set.frame = -1;
+		set.submitNs = 0;
+	}
+}
+
+uint64_t Profiler::nowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::ThreadBuffer& Profiler::localBuffer()
+{
+	if (!threadBuffer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.push_back(std::make_unique<ThreadBuffer>());
+		ThreadBuffer& buffer = *threads.back();
+		buffer.depth = 0;
+		buffer.id = (int)threads.size() - 1;
+		buffer.name = "Thread " + std::to_string(buffer.id);
+		threadBuffer = &buffer;
+	}
+	return *(ThreadBuffer*)threadBuffer;
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	ThreadBuffer& buffer = localBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.name = name;
+}
+
+void Profiler::beginCpu()
+{
+	localBuffer().depth++;
+}
+
+void Profiler::endCpu(const char* name, uint64_t startNs)
+{
+	uint64_t end = nowNs();
+	ThreadBuffer& buffer = localBuffer();
+	buffer.depth--;
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events.push_back({ name, startNs, end, buffer.depth, buffer.id });
+}
+
+bool Profiler::beginGpu(const char* name)
+{
+	if (gpuActive)
+		return false;
+	QuerySet& set = querySets[querySet];
+	if (set.used == (int)set.queries.size())
+	{
+		GpuQuery query = { name, 0 };
+		glGenQueries(1, &query.query);
+		set.queries.push_back(query);
+	}
+	GpuQuery& query = set.queries[set.used++];
+	query.name = name;
+	glBeginQuery(GL_TIME_ELAPSED, query.query);
+	gpuActive = true;
+	return true;
+}
+
+void Profiler::endGpu()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	gpuActive = false;
+}
+
+void Profiler::collectGpu(QuerySet& set, ProfileFrame& frame)
+{
+	frame.gpu.clear();
+	frame.gpuFrame = set.frame;
+	frame.gpuMs = 0.0;
+	uint64_t placedNs = set.submitNs;
+	for (int i = 0; i < set.used; i++)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(set.queries[i].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			frame.gpuMissed++;
+			continue;
+		}
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(set.queries[i].query, GL_QUERY_RESULT, &ns);
+		frame.gpu.push_back({ set.queries[i].name, ns / 1.0e6 });
+		frame.gpuMs += ns / 1.0e6;
+		if (recording && traceGpu.size() < PROFILER_TRACE_EVENTS)
+			traceGpu.push_back({ set.queries[i].name, placedNs, placedNs + ns, 0, -1 });
+		placedNs += ns;
+	}
+	set.used = 0;
+}
+
+void Profiler::endFrame(long long frame)
+{
+	uint64_t end = nowNs();
+	ProfileFrame collected;
+	collected.frame = frame;
+	collected.startNs = frameStartNs;
+	collected.endNs = end;
+	frameStartNs = end;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& thread : threads)
+		{
+			std::lock_guard<std::mutex> bufferLock(thread->mutex);
+			collected.cpu.insert(collected.cpu.end(), thread->events.begin(), thread->events.end());
+			thread->events.clear();
+		}
+		collected.gpuMissed = last.gpuMissed;
+	}
+
+	// The set this frame just filled is read once it comes round again
+	QuerySet& current = querySets[querySet];
+	current.frame = frame;
+	current.submitNs = collected.startNs;
+	querySet = (querySet + 1) % PROFILER_GPU_FRAMES;
+	QuerySet& oldest = querySets[querySet];
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (oldest.used > 0)
+		collectGpu(oldest, collected);
+	else
+	{
+		collected.gpu = last.gpu;
+		collected.gpuFrame = last.gpuFrame;
+		collected.gpuMs = last.gpuMs;
+	}
+	if (recording)
+	{
+		size_t room = PROFILER_TRACE_EVENTS - std::min<size_t>(traceEvents.size(), PROFILER_TRACE_EVENTS);
+		traceEvents.insert(traceEvents.end(), collected.cpu.begin(), collected.cpu.begin() + std::min(room, collected.cpu.size()));
+		frameMarks.push_back({ frame, end });
+	}
+	last = std::move(collected);
+}
+
+ProfileFrame Profiler::latest()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return last;
+}
+
+std::vector<std::string> Profiler::threadNames()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::string> names;
+	for (auto& thread : threads)
+	{
+		std::lock_guard<std::mutex> bufferLock(thread->mutex);
+		names.push_back(thread->name);
+	}
+	return names;
+}
+
+void Profiler::startTrace()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	traceEvents.clear();
+	traceGpu.clear();
+	frameMarks.clear();
+	recording = true;
+}
+
+bool Profiler::tracing()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return recording;
+}
+
+// Trace names are string literals of the engine, only quotes and backslashes need escaping
+static void writeJsonString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool Profiler::stopTrace(const std::string& path)
+{
+	std::vector<std::string> names = threadNames();
+	std::lock_guard<std::mutex> lock(mutex);
+	recording = false;
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+
+	// Chrome's JSON trace format: complete ("X") events with microsecond times
+	uint64_t origin = UINT64_MAX;
+	for (const ProfileEvent& event : traceEvents)
+		origin = std::min(origin, event.startNs);
+	for (const ProfileEvent& event : traceGpu)
+		origin = std::min(origin, event.startNs);
+	if (origin == UINT64_MAX)
+		origin = 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Graphics\"}}");
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", i);
+		writeJsonString(file, names[i].c_str());
+		fprintf(file, "}}");
+	}
+	fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"GPU\"}}", names.size());
+
+	auto writeEvent = [&](const ProfileEvent& event, size_t thread) {
+		fprintf(file, ",\n{\"name\":");
+		writeJsonString(file, event.name);
+		fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", thread,
+			(event.startNs - origin) / 1000.0, (event.endNs - event.startNs) / 1000.0);
+	};
+	for (const ProfileEvent& event : traceEvents)
+		writeEvent(event, (size_t)event.thread);
+	for (const ProfileEvent& event : traceGpu)
+		writeEvent(event, names.size());
+	for (auto& mark : frameMarks)
+	{
+		if (mark.second < origin)
+			continue;
+		fprintf(file, ",\n{\"name\":\"Frame %lld\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", mark.first, (mark.second - origin) / 1000.0);
+	}
+	fprintf(file, "\n]}\n");
+	bool written = ferror(file) == 0;
+	fclose(file);
+	std::cout << "Trace of " << frameMarks.size() << " frames, " << traceEvents.size() + traceGpu.size() << " events written to " << path << std::endl;
+	traceEvents.clear();
+	traceGpu.clear();
+	frameMarks.clear();
+	return written;
+}
+
+// Stable color per scope name
+static ImU32 scopeColor(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; c++)
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+	return IM_COL32(90 + hash % 120, 90 + (hash >> 8) % 120, 90 + (hash >> 16) % 120, 255);
+}
+
+void Profiler::drawFlameGraph(const ProfileFrame& frame)
+{
+	std::vector<std::string> names = threadNames();
+	const float rowHeight = 18.0f;
+	const float labelWidth = 90.0f;
+	float width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 100.0f);
+	double frameNs = (double)std::max<uint64_t>(frame.endNs - frame.startNs, 1);
+	ImDrawList* draw = ImGui::GetWindowDrawList();
+
+	// One lane per thread that closed a scope, as deep as its deepest scope
+	std::vector<int> laneDepth(names.size(), -1);
+	for (const ProfileEvent& event : frame.cpu)
+	{
+		if (event.thread < (int)laneDepth.size())
+			laneDepth[event.thread] = std::max(laneDepth[event.thread], event.depth);
+	}
+
+	const ProfileEvent* hovered = nullptr;
+	const GpuTiming* hoveredGpu = nullptr;
+	for (size_t thread = 0; thread <= names.size(); thread++)
+	{
+		bool gpuLane = thread == names.size();
+		if (!gpuLane && laneDepth[thread] < 0)
+			continue;
+		int rows = gpuLane ? 1 : laneDepth[thread] + 1;
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		draw->AddText(origin, IM_COL32(220, 220, 220, 255), gpuLane ? "GPU" : names[thread].c_str());
+		ImVec2 laneMin(origin.x + labelWidth, origin.y);
+		ImVec2 laneMax(laneMin.x + width, origin.y + rows * rowHeight);
+		draw->AddRectFilled(laneMin, laneMax, IM_COL32(40, 40, 40, 255));
+		draw->PushClipRect(laneMin, laneMax, true);
+
+		auto drawBar = [&](const char* name, double begin, double end, int depth) {
+			ImVec2 min(laneMin.x + (float)(begin / frameNs) * width, laneMin.y + depth * rowHeight);
+			ImVec2 max(laneMin.x + std::max((float)(end / frameNs) * width, min.x - laneMin.x + 1.0f), min.y + rowHeight - 1.0f);
+			draw->AddRectFilled(min, max, scopeColor(name));
+			if (max.x - min.x > ImGui::CalcTextSize(name).x + 4.0f)
+				draw->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255), name);
+			return ImGui::IsMouseHoveringRect(min, max);
+		};
+		if (gpuLane)
+		{
+			// Only durations come back, the passes are laid out one after another
+			double placed = 0.0;
+			for (const GpuTiming& timing : frame.gpu)
+			{
+				if (drawBar(timing.name, placed, placed + timing.ms * 1.0e6, 0))
+					hoveredGpu = &timing;
+				placed += timing.ms * 1.0e6;
+			}
+		}
+		else
+		{
+			for (const ProfileEvent& event : frame.cpu)
+			{
+				if (event.thread != (int)thread)
+					continue;
+				// Scopes that started in the previous frame are clipped at its start
+				double begin = event.startNs > frame.startNs ? (double)(event.startNs - frame.startNs) : 0.0;
+				if (drawBar(event.name, begin, (double)(event.endNs - frame.startNs), event.depth))
+					hovered = &event;
+			}
+		}
+		draw->PopClipRect();
+		ImGui::Dummy(ImVec2(labelWidth + width, rows * rowHeight + 2.0f));
+	}
+
+	if (hovered)
+		ImGui::SetTooltip("%s: %.3f ms", hovered->name, (hovered->endNs - hovered->startNs) / 1.0e6);
+	else if (hoveredGpu)
+		ImGui::SetTooltip("%s (GPU, frame %lld): %.3f ms", hoveredGpu->name, frame.gpuFrame, hoveredGpu->ms);
+}
+
+void Profiler::Delete()
+{
+	for (QuerySet& set : querySets)
+	{
+		for (GpuQuery& query : set.queries)
+			glDeleteQueries(1, &query.query);
+		set.queries.clear();
+		set.used = 0;
+	}
+	gpuActive = false;
+}
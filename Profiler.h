@@ -0,0 +1,196 @@
+#ifndef PROFILER_CLASS_H
+#define PROFILER_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<cstdint>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<utility>
+#include<vector>
+
+// Builds without PROFILING=1 compile every scope macro away
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+// Query sets in flight, results are read PROFILER_GPU_FRAMES frames after they were issued
+#define PROFILER_GPU_FRAMES 2
+// Trace events kept before a recording stops collecting
+#define PROFILER_TRACE_EVENTS 2000000
+
+// One finished CPU scope. Names are string literals, only the pointer is stored.
+struct ProfileEvent {
+	const char* name;
+	uint64_t startNs, endNs;
+	int depth;
+	int thread;
+};
+
+struct GpuTiming {
+	const char* name;
+	double ms;
+};
+
+// Everything collected by one endFrame(): the CPU scopes every thread closed since the
+// previous one, and the GPU passes of an older frame whose queries have finished
+struct ProfileFrame {
+	long long frame;
+	uint64_t startNs, endNs;
+	std::vector<ProfileEvent> cpu;
+	long long gpuFrame;
+	std::vector<GpuTiming> gpu;
+	double gpuMs;
+	// GPU results so far that weren't ready when their query set was reused
+	long long gpuMissed;
+
+	ProfileFrame();
+};
+
+// Scoped CPU markers from any thread plus GL_TIME_ELAPSED queries around GL passes.
+//
+// Scopes are written to a buffer owned by their thread, only endFrame() takes them away,
+// so recording one costs two clock reads and an uncontended lock. GPU scopes go on the
+// thread that owns the context and can't nest: GL allows one GL_TIME_ELAPSED query at a
+// time, so a GPU scope inside another is skipped and the shadow pass, which times itself,
+// is left out. Each frame uses the next of PROFILER_GPU_FRAMES query sets and a set is
+// only read when it comes round again, a result that isn't ready by then is dropped
+// instead of waited for.
+class Profiler
+{
+public:
+	// Scopes are skipped while false
+	std::atomic<bool> enabled;
+
+	Profiler();
+
+	static uint64_t nowNs();
+	// Name of the calling thread in the flame view and in traces
+	void setThreadName(const char* name);
+
+	void beginCpu();
+	void endCpu(const char* name, uint64_t startNs);
+	// GL thread only. Returns false for a nested scope, which then must not call endGpu().
+	bool beginGpu(const char* name);
+	void endGpu();
+
+	// GL thread, once per frame after the last GPU scope. Collects the thread buffers and
+	// the finished queries of the set that is about to be reused.
+	void endFrame(long long frame);
+	// Copy of the last endFrame(), for the GUI thread
+	ProfileFrame latest();
+	std::vector<std::string> threadNames();
+
+	// Keeps every collected frame until stopTrace() writes them as Chrome trace JSON,
+	// which chrome://tracing and ui.perfetto.dev open
+	void startTrace();
+	bool tracing();
+	bool stopTrace(const std::string& path);
+
+	// Timeline of a collected frame, one lane per thread plus the GPU passes
+	void drawFlameGraph(const ProfileFrame& frame);
+
+	// Releases the queries, needs the context current
+	void Delete();
+
+private:
+	struct ThreadBuffer {
+		std::mutex mutex;
+		std::vector<ProfileEvent> events;
+		int depth;
+		int id;
+		std::string name;
+	};
+	struct GpuQuery {
+		const char* name;
+		GLuint query;
+	};
+	struct QuerySet {
+		std::vector<GpuQuery> queries;
+		int used;
+		long long frame;
+		uint64_t submitNs;
+	};
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threads;
+	ProfileFrame last;
+	uint64_t frameStartNs;
+
+	QuerySet querySets[PROFILER_GPU_FRAMES];
+	int querySet;
+	bool gpuActive;
+
+	bool recording;
+	std::vector<ProfileEvent> traceEvents;
+	// GPU passes, placed back to back from the CPU time their frame was submitted
+	std::vector<ProfileEvent> traceGpu;
+	// Frame number and end time of every recorded frame
+	std::vector<std::pair<long long, uint64_t>> frameMarks;
+
+	ThreadBuffer& localBuffer();
+	void collectGpu(QuerySet& set, ProfileFrame& frame);
+};
+
+extern Profiler profiler;
+
+// Records the enclosing block as a CPU scope named name, a string literal
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name)
+		: name(name), startNs(0)
+	{
+		if (profiler.enabled)
+		{
+			profiler.beginCpu();
+			startNs = Profiler::nowNs();
+		}
+	}
+	~ProfileScope()
+	{
+		if (startNs)
+			profiler.endCpu(name, startNs);
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	uint64_t startNs;
+};
+
+// Times the GL commands of the enclosing block on the GPU
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(const char* name)
+		: active(profiler.enabled && profiler.beginGpu(name))
+	{
+	}
+	~GpuProfileScope()
+	{
+		if (active)
+			profiler.endGpu();
+	}
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	bool active;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#if PROFILING
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) profiler.setThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU(name)
+#define PROFILE_THREAD(name)
+#endif
+
+#endif
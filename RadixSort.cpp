@@ -0,0 +1,52 @@
+#include"RadixSort.h"
+
+#include<cstring>
+#include<numeric>
+
+// Negative floats have every bit flipped, positive ones only the sign bit
+static uint32_t sortableBits(float key)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &key, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void RadixSort::sort(const std::vector<float>& keys, std::vector<int>& order)
+{
+	size_t count = keys.size();
+	order.resize(count);
+	std::iota(order.begin(), order.end(), 0);
+	if (count < 2)
+		return;
+
+	bits.resize(count);
+	bitsSwap.resize(count);
+	orderSwap.resize(count);
+	for (size_t i = 0; i < count; i++)
+		bits[i] = sortableBits(keys[i]);
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++)
+			offsets[(bits[i] >> shift) & 0xFF]++;
+		if (offsets[(bits[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t sum = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t digits = offset;
+			offset = sum;
+			sum += digits;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t to = offsets[(bits[i] >> shift) & 0xFF]++;
+			bitsSwap[to] = bits[i];
+			orderSwap[to] = order[i];
+		}
+		bits.swap(bitsSwap);
+		order.swap(orderSwap);
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef RADIX_SORT_CLASS_H
+#define RADIX_SORT_CLASS_H
+
+#include<cstdint>
+#include<vector>
+
+// Stable sort of indices by float keys, used for the back to front order of blended draws.
+//
+// Least significant digit radix sort, four passes of 8 bits over the keys' bits flipped so
+// they compare as unsigned integers. A pass where every key has the same byte moves nothing
+// and is skipped, depths of one scene usually share the exponent byte. The work buffers are
+// kept between calls, sorting the same number of draws every frame doesn't allocate.
+class RadixSort
+{
+public:
+	// Fills order with 0..keys.size()-1 by ascending key, equal keys keep their index order
+	void sort(const std::vector<float>& keys, std::vector<int>& order);
+
+private:
+	std::vector<uint32_t> bits, bitsSwap;
+	std::vector<int> orderSwap;
+};
+
+#endif
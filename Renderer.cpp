@@ -0,0 +1,830 @@
+#include"Renderer.h"
+#include"GLExt.h"
+#include"JobSystem.h"
+#include"Profiler.h"
+#include"GLStats.h"
+
+#include "imgui_impl_opengl3.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<numeric>
+
+static double msBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+FrameSnapshot::FrameSnapshot()
+	: frame(0), view(1.0f), projection(1.0f), viewPos(0.0f), fov(0.0f), zNear(0.1f), zFar(100.0f),
+	lightPos(0.0f), lightColor(1.0f), background(0.0f), renderPath(RENDER_FORWARD), transparency(TRANSPARENCY_SORTED), hasGui(false)
+{
+	shadows = { false, 0.0f, 0.0f, 0.0f, 0.0f, false };
+	capture = { false, false, false, "", "png", 60.0f };
+	pacing = { VSYNC_ON, 0.0f, 2, true };
+	resolution = { false, 16.0f, 0.5f, 1.0f };
+	opaque = { false, false, false };
+	hlod = { false, 4.0f };
+	lightSource = { nullptr, nullptr, ObjectUniforms(), false };
+}
+
+FrameSnapshot::~FrameSnapshot()
+{
+	clearGui();
+}
+
+void FrameSnapshot::captureGui()
+{
+	clearGui();
+	ImDrawData* source = ImGui::GetDrawData();
+	if (!source || !source->Valid)
+		return;
+	gui = *source;
+	for (int i = 0; i < gui.CmdLists.Size; i++)
+		gui.CmdLists[i] = source->CmdLists[i]->CloneOutput();
+	hasGui = true;
+}
+
+void FrameSnapshot::clearGui()
+{
+	if (hasGui)
+	{
+		for (int i = 0; i < gui.CmdLists.Size; i++)
+			IM_DELETE(gui.CmdLists[i]);
+	}
+	gui.Clear();
+	hasGui = false;
+}
+
+Renderer::Renderer(int width, int height)
+	: width(width), height(height), simulationWaitMs(0.0), targetFBO(0), litShaders("lit.vert", "lit.frag"),
+	lightShader("light.vert", "light.frag"), shadowShader("shadow.vert", "shadow.frag"),
+	depthShader("depth.vert", "depth.frag"), overdrawShader("depth.vert", "overdraw.frag"), oitShader("fullscreen.vert", "oit.frag"),
+	uniformRing(GL_UNIFORM_BUFFER, 1024 * 1024), window(nullptr), writeSlot(0), readSlot(0), stopping(false),
+	latestStats(), modelDraws(0), hlodProxies(0), transparentSortMs(0.0), fragmentFrame(0), shadedFragments(0), overdraw(0.0f), recordMs(0.0), replayMs(0.0), commandCount(0),
+	captureFailed(false), appliedVsync(-2), adaptiveVsync(false)
+{
+	slotState[0] = slotState[1] = SLOT_FREE;
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		fragmentQueries[i] = 0;
+		fragmentPending[i] = false;
+		fragmentPixels[i] = 0;
+	}
+	activeCapture = { false, false, false, "", "", 60.0f };
+
+	// All lit programs are variants of lit.vert/lit.frag. Every variant the frame loop can
+	// pick is requested here and compiles on driver threads while the models load.
+	for (unsigned int lighting = 0; lighting < 4; lighting++)
+	{
+		unsigned int features = (lighting & 1 ? (unsigned int)SHADER_CLUSTERED_LIGHTS : 0u) | (lighting & 2 ? (unsigned int)SHADER_SHADOWS : 0u);
+		litShaders.request(features);
+		litShaders.request(SHADER_TEXTURED | features);
+		litShaders.request(SHADER_DEFERRED_LIGHTING | features);
+		litShaders.request(SHADER_WEIGHTED_OIT | features);
+		litShaders.request(SHADER_TEXTURED | SHADER_WEIGHTED_OIT | features);
+	}
+	litShaders.request(SHADER_GBUFFER);
+	litShaders.request(SHADER_TEXTURED | SHADER_GBUFFER);
+	litShaders.setup = [this](Shader& shader, unsigned int features) {
+		if (features & SHADER_TEXTURED)
+			materials.setupShader(shader);
+		if (features & SHADER_CLUSTERED_LIGHTS)
+			lightCluster.setupShader(shader);
+		if (features & SHADER_SHADOWS)
+			shadows.setupShader(shader);
+		if (features & SHADER_DEFERRED_LIGHTING)
+			gbuffer.setupShader(shader);
+	};
+	litShaders.build();
+	oit.setupShader(oitShader);
+
+	gbuffer.resize(width, height);
+}
+
+void Renderer::finishLoading()
+{
+	litShaders.wait();
+	// Loading uploads aren't part of the first frame
+	glStats.reset();
+}
+
+void Renderer::start(GLFWwindow* window)
+{
+	this->window = window;
+	stopping = false;
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent(NULL);
+	thread = std::thread(&Renderer::run, this);
+}
+
+void Renderer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	if (thread.joinable())
+		thread.join();
+	glfwMakeContextCurrent(window);
+}
+
+FrameSnapshot& Renderer::beginSnapshot()
+{
+	PROFILE_SCOPE("Wait for snapshot");
+	auto start = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return slotState[writeSlot] == SLOT_FREE; });
+	slotState[writeSlot] = SLOT_FILLING;
+	simulationWaitMs = msBetween(start, std::chrono::steady_clock::now());
+	return slots[writeSlot];
+}
+
+void Renderer::submit()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slotState[writeSlot] = SLOT_READY;
+		writeSlot ^= 1;
+	}
+	changed.notify_all();
+}
+
+RenderStats Renderer::stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return latestStats;
+}
+
+void Renderer::run()
+{
+	glfwMakeContextCurrent(window);
+	PROFILE_THREAD("Render");
+	adaptiveVsync = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+	appliedVsync = -2;
+	while (true)
+	{
+		auto waitStart = std::chrono::steady_clock::now();
+		int slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return slotState[readSlot] == SLOT_READY || stopping; });
+			// Stopping only ends the loop once the submitted frames are drawn
+			if (slotState[readSlot] != SLOT_READY)
+				break;
+			slot = readSlot;
+			slotState[slot] = SLOT_RENDERING;
+		}
+
+		auto renderStart = std::chrono::steady_clock::now();
+		renderFrame(slots[slot]);
+		captureFrame(slots[slot]);
+		applyVsync(slots[slot].pacing.vsync);
+		auto swapStart = std::chrono::steady_clock::now();
+		{
+			PROFILE_SCOPE("Swap");
+			glfwSwapBuffers(window);
+		}
+		auto end = std::chrono::steady_clock::now();
+		frameFences.frameSwapped(slots[slot].inputTime, slots[slot].pacing.maxFramesInFlight);
+		profiler.endFrame(slots[slot].frame);
+		glStats.endFrame(slots[slot].frame);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slotState[slot] = SLOT_FREE;
+			readSlot ^= 1;
+			publishStats(msBetween(renderStart, swapStart), msBetween(waitStart, renderStart), msBetween(swapStart, end), slots[slot].frame);
+		}
+		changed.notify_all();
+	}
+	capture.stop();
+	frameFences.Delete();
+	glfwMakeContextCurrent(NULL);
+}
+
+void Renderer::applyVsync(int vsync)
+{
+	if (vsync == appliedVsync)
+		return;
+	appliedVsync = vsync;
+	// Negative intervals swap right away when a frame missed its refresh
+	if (vsync == VSYNC_ADAPTIVE)
+		glfwSwapInterval(adaptiveVsync ? -1 : 1);
+	else
+		glfwSwapInterval(vsync == VSYNC_ON ? 1 : 0);
+}
+
+void Renderer::draw(const FrameSnapshot& frame)
+{
+	auto start = std::chrono::steady_clock::now();
+	renderFrame(frame);
+	profiler.endFrame(frame.frame);
+	glStats.endFrame(frame.frame);
+	std::lock_guard<std::mutex> lock(mutex);
+	publishStats(msBetween(start, std::chrono::steady_clock::now()), 0.0, 0.0, frame.frame);
+}
+
+void Renderer::captureFrame(const FrameSnapshot& frame)
+{
+	const CaptureSettings& wanted = frame.capture;
+	if (!wanted.enabled)
+	{
+		capture.stop();
+		captureFailed = false;
+		return;
+	}
+	bool different = wanted.synchronous != activeCapture.synchronous || wanted.lossless != activeCapture.lossless || wanted.output != activeCapture.output || wanted.format != activeCapture.format;
+	if (!capture.active() || different)
+	{
+		// A failed start is only retried once the settings change
+		if (captureFailed && !different)
+			return;
+		activeCapture = wanted;
+		captureFailed = !capture.start(width, height, wanted);
+		if (captureFailed)
+			return;
+	}
+	PROFILE_SCOPE("Capture");
+	capture.capture(targetFBO, frame.frame);
+}
+
+void Renderer::renderFrame(const FrameSnapshot& frame)
+{
+	PROFILE_SCOPE("Render frame");
+	// The overdraw view adds up from black and draws every blended draw additively
+	bool overdrawView = frame.opaque.overdrawView;
+	bool weightedOIT = frame.transparency == TRANSPARENCY_WEIGHTED && !overdrawView;
+
+	// The 3D scene goes into the scaled target when dynamic resolution picked a scale below or above 1,
+	// weighted transparency always uses it to share its depth buffer
+	bool scaled = resolution.begin(frame.resolution, width, height, weightedOIT);
+	GLuint sceneFBO = scaled ? resolution.FBO : targetFBO;
+	int sceneWidth = scaled ? resolution.width : width;
+	int sceneHeight = scaled ? resolution.height : height;
+	gbuffer.resize(sceneWidth, sceneHeight);
+	resolution.beginScene();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glViewport(0, 0, sceneWidth, sceneHeight);
+	glm::vec3 background = overdrawView ? glm::vec3(0.0f) : frame.background;
+	glClearColor(background.r, background.g, background.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Lights are binned on the job system while this thread fills the ring and sorts the draws
+	JobCounter lightsCulled;
+	lightCluster.cullAsync(frame.lights, frame.view, frame.projection, frame.zNear, frame.zFar, lightsCulled);
+
+	// Shadows treat the main light as directional, shining from lightPos towards the origin
+	shadows.enabled = frame.shadows.enabled;
+	shadows.shadowDistance = frame.shadows.distance;
+	shadows.splitLambda = frame.shadows.splitLambda;
+	shadows.depthBias = frame.shadows.depthBias;
+	shadows.normalBias = frame.shadows.normalBias;
+	if (frame.shadows.invalidateStatic)
+		shadows.invalidateStatic();
+	shadows.update(frame.view, frame.fov, (float)sceneWidth / (float)sceneHeight, frame.zNear, frame.lightPos);
+
+	// Write every uniform block of the frame into the ring up front, then draw from it
+	uniformRing.beginFrame();
+
+	FrameUniforms frameBlock;
+	frameBlock.projection = frame.projection;
+	frameBlock.view = frame.view;
+	frameBlock.viewPos = glm::vec4(frame.viewPos, 1.0f);
+	frameBlock.lightPos = glm::vec4(frame.lightPos, 1.0f);
+	frameBlock.lightColor = glm::vec4(frame.lightColor, 1.0f);
+	frameBlock.clusterParams = glm::vec4(frame.zNear, frame.zFar, lightCluster.sliceScale(), lightCluster.sliceBias());
+	frameBlock.clusterDims[0] = lightCluster.dimX;
+	frameBlock.clusterDims[1] = lightCluster.dimY;
+	frameBlock.clusterDims[2] = lightCluster.dimZ;
+	frameBlock.clusterDims[3] = 0;
+	frameBlock.screenSize = glm::vec4(sceneWidth, sceneHeight, 0.0f, 0.0f);
+	GLintptr frameOffset = uniformRing.push(frameBlock);
+	GLintptr shadowOffset = uniformRing.push(shadows.getUniforms());
+
+	objectOffsets.resize(frame.objects.size());
+	for (size_t i = 0; i < frame.objects.size(); i++)
+		objectOffsets[i] = uniformRing.push(frame.objects[i].uniforms);
+	modelOffsets.resize(frame.models.size());
+	for (size_t i = 0; i < frame.models.size(); i++)
+		modelOffsets[i] = uniformRing.push(frame.models[i].uniforms);
+	GLintptr lightSourceOffset = uniformRing.push(frame.lightSource.uniforms);
+
+	uniformRing.commit();
+	uniformRing.bindRange(FRAME_UBO_BINDING, frameOffset, sizeof(FrameUniforms));
+	uniformRing.bindRange(SHADOW_UBO_BINDING, shadowOffset, sizeof(ShadowUniforms));
+
+	sortOpaque(frame, sceneHeight);
+	sortTransparent(frame, !weightedOIT);
+	jobSystem.wait(lightsCulled);
+	lightCluster.upload(frame.lights);
+	lightCluster.bind();
+
+	// Draws are recorded into command lists on the job system and replayed here
+	recordMs = 0.0;
+	replayMs = 0.0;
+	commandCount = 0;
+
+	if (shadows.enabled)
+	{
+		// The shadow map times its own pass on the GPU, GL_TIME_ELAPSED queries can't nest
+		PROFILE_SCOPE("Shadows");
+		GL_STATS_PASS(STATS_PASS_SHADOWS);
+		// Every cascade draws the same lists, only the cascade matrix differs
+		bool anyStatic = false;
+		for (int c = 0; c < SHADOW_CASCADES; c++)
+			anyStatic = anyStatic || shadows.needsStatic(c);
+		if (anyStatic)
+		{
+			staticShadowCommands.clear();
+			recordObjects(staticShadowCommands, frame.objects, objectOffsets, shadowShader, PACKETS_STATIC, true);
+			recordModels(staticShadowCommands, frame.models, modelOffsets, shadowOrders, shadowShader, PACKETS_STATIC, true);
+		}
+		dynamicShadowCommands.clear();
+		recordObjects(dynamicShadowCommands, frame.objects, objectOffsets, shadowShader, PACKETS_DYNAMIC, true);
+		recordModels(dynamicShadowCommands, frame.models, modelOffsets, shadowOrders, shadowShader, PACKETS_DYNAMIC, true);
+
+		shadows.beginPass();
+		for (int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			if (shadows.needsStatic(c))
+			{
+				shadows.beginStatic(c, shadowShader);
+				replay(staticShadowCommands);
+			}
+			shadows.beginDynamic(c, shadowShader);
+			replay(dynamicShadowCommands);
+		}
+		shadows.endPass(sceneWidth, sceneHeight, sceneFBO);
+	}
+	shadows.bind();
+
+	// Lit scene geometry, drawn with the forward variants or into the G-buffer.
+	// Each pass uses the smallest variant, without the light loop or shadow lookups it doesn't need.
+	// The overdraw view replaces them with one additive program and draws forward.
+	bool deferred = frame.renderPath == RENDER_DEFERRED && !overdrawView;
+	unsigned int lighting = (frame.lights.empty() ? 0u : (unsigned int)SHADER_CLUSTERED_LIGHTS) | (shadows.enabled ? (unsigned int)SHADER_SHADOWS : 0u);
+	Shader& objectPass = overdrawView ? overdrawShader : litShaders.get(deferred ? (unsigned int)SHADER_GBUFFER : lighting);
+	Shader& modelPass = overdrawView ? overdrawShader : litShaders.get(SHADER_TEXTURED | (deferred ? (unsigned int)SHADER_GBUFFER : lighting));
+	if (deferred)
+		gbuffer.bindGeometry();
+
+	bool prepass = frame.opaque.depthPrepass;
+	if (prepass)
+	{
+		PROFILE_SCOPE("Depth prepass");
+		PROFILE_GPU("Depth prepass");
+		GL_STATS_PASS(STATS_PASS_PREPASS);
+		commands.clear();
+		recordObjects(commands, frame.objects, objectOffsets, depthShader, PACKETS_ALL, true);
+		recordModels(commands, frame.models, modelOffsets, meshOrders, depthShader, PACKETS_ALL, true, true);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		replay(commands);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		// depth.vert and lit.vert are invariant, so only the nearest fragment of each pixel passes.
+		// Depth writes stay on for the alpha tested meshes the prepass left out.
+		glDepthFunc(GL_LEQUAL);
+	}
+	if (overdrawView)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+	beginFragmentCount((long long)sceneWidth * sceneHeight);
+
+	{
+		PROFILE_SCOPE("Objects");
+		PROFILE_GPU("Objects");
+		GL_STATS_PASS(STATS_PASS_OBJECTS);
+		commands.clear();
+		recordObjects(commands, frame.objects, objectOffsets, objectPass, PACKETS_ALL, overdrawView);
+		replay(commands);
+	}
+
+	// The loaded models, their textures are bound once for all meshes
+	{
+		PROFILE_SCOPE("Models");
+		PROFILE_GPU("Models");
+		GL_STATS_PASS(STATS_PASS_MODELS);
+		commands.clear();
+		recordModels(commands, frame.models, modelOffsets, meshOrders, modelPass, PACKETS_ALL, overdrawView);
+		modelPass.Activate();
+		if (!overdrawView)
+			materials.bind();
+		replay(commands);
+	}
+
+	endFragmentCount();
+	if (overdrawView)
+		glDisable(GL_BLEND);
+	if (prepass)
+		glDepthFunc(GL_LESS);
+
+	if (deferred)
+	{
+		PROFILE_SCOPE("Deferred lighting");
+		PROFILE_GPU("Deferred lighting");
+		GL_STATS_PASS(STATS_PASS_LIGHTING);
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glViewport(0, 0, sceneWidth, sceneHeight);
+		glClearColor(frame.background.r, frame.background.g, frame.background.b, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gbuffer.lightPass(litShaders.get(SHADER_DEFERRED_LIGHTING | lighting));
+	}
+
+	// Unlit, always forward
+	{
+		PROFILE_GPU("Light source");
+		GL_STATS_PASS(STATS_PASS_LIGHT_SOURCE);
+		if (lightSourceOffset >= 0)
+			drawPacket(frame.lightSource, lightSourceOffset, lightShader);
+	}
+
+	// Blended draws over the finished opaque scene, forward on either path. They test against
+	// its depth without writing it, so they never hide each other.
+	if (!transparentOrder.empty())
+	{
+		PROFILE_SCOPE("Transparent");
+		PROFILE_GPU("Transparent");
+		GL_STATS_PASS(STATS_PASS_TRANSPARENT);
+		commands.clear();
+		glDepthMask(GL_FALSE);
+		if (weightedOIT)
+		{
+			// Any order adds up to the same result, sortTransparent() skipped the sort
+			recordTransparent(commands, frame, litShaders.get(SHADER_WEIGHTED_OIT | lighting), litShaders.get(SHADER_TEXTURED | SHADER_WEIGHTED_OIT | lighting));
+			oit.resize(sceneWidth, sceneHeight, resolution.depth);
+			oit.begin();
+			replay(commands);
+			oit.composite(oitShader, sceneFBO);
+		}
+		else
+		{
+			recordTransparent(commands, frame, overdrawView ? overdrawShader : litShaders.get(lighting), overdrawView ? overdrawShader : litShaders.get(SHADER_TEXTURED | lighting));
+			glEnable(GL_BLEND);
+			if (overdrawView)
+				glBlendFunc(GL_ONE, GL_ONE);
+			else
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			replay(commands);
+		}
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+	resolution.endScene();
+
+	// The GUI draws after the upscale, at the window's resolution
+	if (scaled)
+	{
+		PROFILE_GPU("Upscale");
+		resolution.resolve(targetFBO, width, height);
+	}
+
+	if (frame.hasGui)
+	{
+		PROFILE_SCOPE("UI");
+		PROFILE_GPU("UI");
+		GL_STATS_PASS(STATS_PASS_UI);
+#if GL_STATS
+		// The ImGui backend calls GL itself, its draws are counted from the draw data
+		for (int i = 0; i < frame.gui.CmdLists.Size; i++)
+		{
+			const ImDrawList* list = frame.gui.CmdLists[i];
+			for (int c = 0; c < list->CmdBuffer.Size; c++)
+				glStats.draw(GL_TRIANGLES, list->CmdBuffer[c].ElemCount);
+		}
+#endif
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplOpenGL3_RenderDrawData(const_cast<ImDrawData*>(&frame.gui));
+	}
+
+	uniformRing.endFrame();
+}
+
+void Renderer::drawPacket(const DrawPacket& packet, GLintptr offset, Shader& shader)
+{
+	if (packet.object)
+	{
+		packet.object->draw(shader, uniformRing, offset);
+		return;
+	}
+	shader.Activate();
+	uniformRing.bindRange(OBJECT_UBO_BINDING, offset, sizeof(ObjectUniforms));
+	packet.model->Draw(shader);
+}
+
+static bool packetPasses(const DrawPacket& packet, int filter)
+{
+	return filter == PACKETS_ALL || packet.staticShadow == (filter == PACKETS_STATIC);
+}
+
+// Objects have no material, their colour's alpha decides. Model meshes carry their material's flag.
+static bool objectBlended(const DrawPacket& packet)
+{
+	return packet.object && packet.uniforms.color.a < 1.0f;
+}
+
+void Renderer::sortOpaque(const FrameSnapshot& frame, int viewportHeight)
+{
+	PROFILE_SCOPE("Sort");
+	bool sort = frame.opaque.sortFrontToBack;
+	// View space looks down -z, the nearest draw has the largest z
+	auto nearestFirst = [this](int a, int b) { return sortKeys[a] > sortKeys[b]; };
+
+	// Blocks that didn't fit the uniform ring have offset -1, their draws are skipped
+	objectOrder.clear();
+	for (size_t i = 0; i < frame.objects.size(); i++)
+	{
+		if (!objectBlended(frame.objects[i]) && objectOffsets[i] >= 0)
+			objectOrder.push_back((int)i);
+	}
+	if (sort)
+	{
+		sortKeys.resize(frame.objects.size());
+		for (size_t i = 0; i < frame.objects.size(); i++)
+			sortKeys[i] = (frame.view * frame.objects[i].uniforms.model[3]).z;
+		std::sort(objectOrder.begin(), objectOrder.end(), nearestFirst);
+	}
+
+	// Interiors are one model of many meshes, those are sorted by their bounding box centres
+	float pixelsPerUnit = viewportHeight / (2.0f * std::tan(frame.fov * 0.5f));
+	modelDraws = 0;
+	hlodProxies = 0;
+	meshOrders.resize(frame.models.size());
+	shadowOrders.resize(frame.models.size());
+	for (size_t m = 0; m < frame.models.size(); m++)
+	{
+		const Model* model = frame.models[m].model;
+		glm::mat4 modelView = frame.view * frame.models[m].uniforms.model;
+		std::vector<const Mesh*>& order = meshOrders[m];
+		std::vector<const Mesh*>& shadowOrder = shadowOrders[m];
+		order.clear();
+		shadowOrder.clear();
+		if (modelOffsets[m] < 0)
+			continue;
+		for (const Mesh& mesh : model->meshes)
+		{
+			if (!mesh.blended)
+				shadowOrder.push_back(&mesh);
+		}
+		if (model->hlod && frame.hlod.enabled)
+		{
+			// Errors are in model units, so is the camera position
+			glm::vec3 eye = glm::vec3(glm::inverse(modelView)[3]);
+			hlodProxies += model->hlod->select(eye, pixelsPerUnit, frame.hlod.maxPixelError, model->meshes, order);
+		}
+		else
+			order = shadowOrder;
+		modelDraws += (int)order.size();
+		if (!sort)
+			continue;
+		meshKeys.clear();
+		for (const Mesh* mesh : order)
+			meshKeys.push_back({ (modelView * glm::vec4(mesh->center, 1.0f)).z, mesh });
+		std::sort(meshKeys.begin(), meshKeys.end(), [](const std::pair<float, const Mesh*>& a, const std::pair<float, const Mesh*>& b) {
+			return a.first > b.first;
+		});
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = meshKeys[i].second;
+	}
+}
+
+void Renderer::sortTransparent(const FrameSnapshot& frame, bool sort)
+{
+	PROFILE_SCOPE("Sort transparent");
+	auto start = std::chrono::steady_clock::now();
+	transparentDraws.clear();
+	transparentKeys.clear();
+	// View depth of the object origins and mesh bounding box centres, the farthest has the smallest z
+	for (size_t i = 0; i < frame.objects.size(); i++)
+	{
+		if (!objectBlended(frame.objects[i]) || objectOffsets[i] < 0)
+			continue;
+		transparentDraws.push_back({ (int)i, -1 });
+		transparentKeys.push_back((frame.view * frame.objects[i].uniforms.model[3]).z);
+	}
+	for (size_t m = 0; m < frame.models.size(); m++)
+	{
+		if (modelOffsets[m] < 0)
+			continue;
+		const std::vector<Mesh>& meshes = frame.models[m].model->meshes;
+		glm::mat4 modelView = frame.view * frame.models[m].uniforms.model;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			if (!meshes[i].blended)
+				continue;
+			transparentDraws.push_back({ (int)m, (int)i });
+			transparentKeys.push_back((modelView * glm::vec4(meshes[i].center, 1.0f)).z);
+		}
+	}
+
+	if (sort)
+		depthSort.sort(transparentKeys, transparentOrder);
+	else
+	{
+		transparentOrder.resize(transparentDraws.size());
+		std::iota(transparentOrder.begin(), transparentOrder.end(), 0);
+	}
+	transparentSortMs = msBetween(start, std::chrono::steady_clock::now());
+}
+
+void Renderer::recordObjects(CommandList& list, const std::vector<DrawPacket>& packets, const std::vector<GLintptr>& offsets, Shader& shader, int filter, bool positionsOnly)
+{
+	GLint materialLocation = glGetUniformLocation(shader.ID, "materialIndex");
+	recorder.record(list, (int)objectOrder.size(), 256, [&](CommandList& chunk, int begin, int end) {
+		for (int n = begin; n < end; n++)
+		{
+			int i = objectOrder[n];
+			const DrawPacket& packet = packets[i];
+			if (!packetPasses(packet, filter))
+				continue;
+			if (packet.object)
+			{
+				if (positionsOnly)
+					packet.object->recordDepth(chunk, shader, uniformRing, offsets[i]);
+				else
+					packet.object->record(chunk, shader, uniformRing, offsets[i]);
+				continue;
+			}
+			chunk.useProgram(shader.ID);
+			chunk.bindUniformRange(OBJECT_UBO_BINDING, uniformRing.ID, offsets[i], sizeof(ObjectUniforms));
+			for (const Mesh& mesh : packet.model->meshes)
+			{
+				if (mesh.blended)
+					continue;
+				if (positionsOnly)
+					mesh.RecordDepth(chunk);
+				else
+					mesh.Record(chunk, materialLocation);
+			}
+		}
+	});
+	recordMs += recorder.recordMs;
+}
+
+void Renderer::recordModels(CommandList& list, const std::vector<DrawPacket>& packets, const std::vector<GLintptr>& offsets, const std::vector<std::vector<const Mesh*>>& orders, Shader& shader, int filter, bool positionsOnly, bool skipAlphaTested)
+{
+	GLint materialLocation = glGetUniformLocation(shader.ID, "materialIndex");
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		const DrawPacket& packet = packets[i];
+		if (!packetPasses(packet, filter) || offsets[i] < 0)
+			continue;
+		// A model is split over its meshes, that is where the draw count of a scene is
+		list.useProgram(shader.ID);
+		list.bindUniformRange(OBJECT_UBO_BINDING, uniformRing.ID, offsets[i], sizeof(ObjectUniforms));
+		const std::vector<const Mesh*>& order = orders[i];
+		recorder.record(list, (int)order.size(), 256, [&](CommandList& chunk, int begin, int end) {
+			for (int n = begin; n < end; n++)
+			{
+				const Mesh& mesh = *order[n];
+				if (skipAlphaTested && mesh.alphaTested)
+					continue;
+				if (positionsOnly)
+					mesh.RecordDepth(chunk);
+				else
+					mesh.Record(chunk, materialLocation);
+			}
+		});
+		recordMs += recorder.recordMs;
+	}
+}
+
+void Renderer::recordTransparent(CommandList& list, const FrameSnapshot& frame, Shader& objectShader, Shader& modelShader)
+{
+	GLint materialLocation = glGetUniformLocation(modelShader.ID, "materialIndex");
+	recorder.record(list, (int)transparentOrder.size(), 256, [&](CommandList& chunk, int begin, int end) {
+		for (int n = begin; n < end; n++)
+		{
+			const TransparentDraw& draw = transparentDraws[transparentOrder[n]];
+			if (draw.mesh < 0)
+			{
+				frame.objects[draw.packet].object->record(chunk, objectShader, uniformRing, objectOffsets[draw.packet]);
+				continue;
+			}
+			chunk.useProgram(modelShader.ID);
+			chunk.bindUniformRange(OBJECT_UBO_BINDING, uniformRing.ID, modelOffsets[draw.packet], sizeof(ObjectUniforms));
+			frame.models[draw.packet].model->meshes[draw.mesh].Record(chunk, materialLocation);
+		}
+	});
+	recordMs += recorder.recordMs;
+}
+
+// The query reused now was issued RING_FRAMES frames ago and is normally done
+void Renderer::beginFragmentCount(long long pixels)
+{
+	if (!fragmentQueries[0])
+		glGenQueries(RING_FRAMES, fragmentQueries);
+	if (fragmentPending[fragmentFrame])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(fragmentQueries[fragmentFrame], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(fragmentQueries[fragmentFrame], GL_QUERY_RESULT, &samples);
+			shadedFragments = (long long)samples;
+			overdraw = (float)((double)samples / std::max(fragmentPixels[fragmentFrame], 1LL));
+		}
+	}
+	fragmentPixels[fragmentFrame] = pixels;
+	glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[fragmentFrame]);
+}
+
+void Renderer::endFragmentCount()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	fragmentPending[fragmentFrame] = true;
+	fragmentFrame = (fragmentFrame + 1) % RING_FRAMES;
+}
+
+void Renderer::replay(const CommandList& list)
+{
+	auto start = std::chrono::steady_clock::now();
+	list.execute();
+	replayMs += msBetween(start, std::chrono::steady_clock::now());
+	commandCount += (int)list.commands.size();
+}
+
+void Renderer::publishStats(double renderMs, double waitMs, double swapMs, long long frame)
+{
+	RenderStats& s = latestStats;
+	s.renderMs = renderMs;
+	s.waitMs = waitMs;
+	s.swapMs = swapMs;
+	s.frame = frame;
+
+	s.persistentRing = uniformRing.persistent;
+	s.ringKB = uniformRing.bytesWritten / 1024.0f;
+	s.bufferCallMs = uniformRing.bufferCallMs;
+	s.fenceWaitMs = uniformRing.fenceWaitMs;
+	s.textureBinds = materials.textureBinds;
+	s.capture = capture.stats();
+	s.calls = glStats.summary();
+
+	s.shadedFragments = shadedFragments;
+	s.overdraw = overdraw;
+	s.modelDraws = modelDraws;
+	s.hlodProxies = hlodProxies;
+	s.transparentDraws = (int)transparentOrder.size();
+	s.transparentSortMs = transparentSortMs;
+
+	s.sceneWidth = gbuffer.width;
+	s.sceneHeight = gbuffer.height;
+	s.resolutionScale = resolution.scale;
+	s.sceneGpuMs = resolution.gpuMs;
+
+	s.adaptiveVsync = adaptiveVsync;
+	s.pacingWaitMs = frameFences.waitMs;
+	s.framesInFlight = frameFences.inFlight;
+	s.latencyMs = frameFences.latencyMs;
+	s.latencyMaxMs = frameFences.latencyMaxMs;
+
+	s.recordMs = recordMs;
+	s.replayMs = replayMs;
+	s.commands = commandCount;
+	s.jobThreads = jobSystem.threadCount();
+
+	s.shadowCpuMs = shadows.shadowCpuMs;
+	s.shadowGpuMs = shadows.shadowGpuMs;
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		s.splits[c] = shadows.splits[c];
+		s.staticRedraws[c] = shadows.staticRedraws[c];
+		s.staticRedrawsPerSecond[c] = shadows.staticRedrawsPerSecond[c];
+	}
+
+	s.clusterDims[0] = lightCluster.dimX;
+	s.clusterDims[1] = lightCluster.dimY;
+	s.clusterDims[2] = lightCluster.dimZ;
+	s.cullMs = lightCluster.cullMs;
+	s.lightIndices = (int)lightCluster.indices.size();
+	s.maxClusterLights = lightCluster.maxClusterLights;
+}
+
+void Renderer::Delete()
+{
+	uniformRing.Delete();
+	resolution.Delete();
+	lightCluster.Delete();
+	gbuffer.Delete();
+	shadows.Delete();
+	shadowShader.Delete();
+	depthShader.Delete();
+	overdrawShader.Delete();
+	oit.Delete();
+	oitShader.Delete();
+	if (fragmentQueries[0])
+		glDeleteQueries(RING_FRAMES, fragmentQueries);
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		fragmentQueries[i] = 0;
+		fragmentPending[i] = false;
+	}
+	lightShader.Delete();
+	litShaders.Delete();
+	materials.Delete();
+}
@@ -0,0 +1,316 @@
+#ifndef RENDERER_CLASS_H
+#define RENDERER_CLASS_H
+
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include<chrono>
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+
+#include "imgui.h"
+
+#include "shaderClass.h"
+#include "Object.h"
+#include "model.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+#include "Material.h"
+#include "LightCluster.h"
+#include "GBuffer.h"
+#include "ShadowMap.h"
+#include "ShaderPermutations.h"
+#include "CommandList.h"
+#include "FrameCapture.h"
+#include "GLStats.h"
+#include "FramePacing.h"
+#include "DynamicResolution.h"
+#include "WeightedOIT.h"
+#include "RadixSort.h"
+#include "HLOD.h"
+
+// One draw of the frame: the geometry and the uniforms it is drawn with. Geometry
+// is only read by the render thread, everything the simulation edits is copied.
+struct DrawPacket {
+	Object* object;      // cubes and spheres
+	Model* model;        // or a loaded model
+	ObjectUniforms uniforms;
+	// Lives in the static shadow caches, only drawn into them when they are redrawn
+	bool staticShadow;
+};
+
+// Which packets a recording takes
+enum PacketFilter { PACKETS_ALL, PACKETS_STATIC, PACKETS_DYNAMIC };
+
+// Shadow settings edited by the simulation, applied by the render thread
+struct ShadowSettings {
+	bool enabled;
+	float distance;
+	float splitLambda;
+	float depthBias;
+	float normalBias;
+	// Asks for one static cache redraw
+	bool invalidateStatic;
+};
+
+// How the opaque passes draw, edited by the simulation
+struct OpaqueSettings {
+	// Depth only pass through the position streams first, the lit passes then only shade the visible fragments
+	bool depthPrepass;
+	// Nearest draws first, so the depth test rejects what they cover before it is shaded
+	bool sortFrontToBack;
+	// Shows how often each pixel was shaded instead of the lit scene
+	bool overdrawView;
+};
+
+// Everything the render thread needs for one frame. Filled by the simulation thread,
+// then read-only until the render thread releases it.
+struct FrameSnapshot {
+	long long frame;
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float fov;   // radians
+	float zNear, zFar;
+	glm::vec3 lightPos;
+	glm::vec3 lightColor;
+	glm::vec3 background;
+	int renderPath;
+	// How the blended draws are drawn, a TransparencyMode
+	int transparency;
+	ShadowSettings shadows;
+	OpaqueSettings opaque;
+	HLODSettings hlod;
+	// Frame dump of the window, started and stopped by the render thread
+	CaptureSettings capture;
+	PacingSettings pacing;
+	ResolutionSettings resolution;
+	// When the input this frame shows was last polled, for the latency measurement
+	std::chrono::steady_clock::time_point inputTime;
+
+	std::vector<Light> lights;
+	std::vector<DrawPacket> objects;
+	std::vector<DrawPacket> models;
+	DrawPacket lightSource;
+
+	// Copy of the ImGui draw lists, ImGui's own are rebuilt by the next NewFrame
+	ImDrawData gui;
+	bool hasGui;
+
+	FrameSnapshot();
+	~FrameSnapshot();
+	// Owns cloned draw lists
+	FrameSnapshot(const FrameSnapshot&) = delete;
+	FrameSnapshot& operator=(const FrameSnapshot&) = delete;
+	// Takes over ImGui::GetDrawData(), call after ImGui::Render()
+	void captureGui();
+	void clearGui();
+};
+
+// What the render thread measured, read by the simulation for its GUI
+struct RenderStats {
+	// Render thread, last frame
+	double renderMs;    // culling, uniforms and GL submission
+	double waitMs;      // waiting for the next snapshot
+	double swapMs;
+	long long frame;
+
+	bool persistentRing;
+	float ringKB;
+	double bufferCallMs;
+	double fenceWaitMs;
+	int textureBinds;
+
+	// Command lists of the last frame
+	double recordMs;
+	double replayMs;
+	int commands;
+	int jobThreads;
+
+	double shadowCpuMs, shadowGpuMs;
+	float splits[SHADOW_CASCADES];
+	int staticRedraws[SHADOW_CASCADES];
+	float staticRedrawsPerSecond[SHADOW_CASCADES];
+
+	int clusterDims[3];
+	double cullMs;
+	int lightIndices;
+	int maxClusterLights;
+
+	CaptureStats capture;
+
+	// Fragments the lit opaque passes shaded and their average per pixel, a few frames late
+	long long shadedFragments;
+	float overdraw;
+
+	// Model meshes drawn by the opaque passes and how many of them are HLOD proxies
+	int modelDraws;
+	int hlodProxies;
+
+	// Blended draws of the last frame and the time their back to front sort took
+	int transparentDraws;
+	double transparentSortMs;
+
+	// Size the 3D scene was drawn at and its GPU time
+	int sceneWidth, sceneHeight;
+	float resolutionScale;
+	double sceneGpuMs;
+
+	// Frame pacing
+	bool adaptiveVsync;    // supported, otherwise adaptive falls back to plain vsync
+	double pacingWaitMs;   // waiting for frames in flight
+	int framesInFlight;
+	double latencyMs, latencyMaxMs;
+
+	// GL calls per pass, rolling over the last frames
+	GLStatsSummary calls;
+};
+
+// Owns the GL context while the frame loop runs and draws the snapshots the simulation
+// thread submits.
+//
+// There are two snapshot slots: the simulation fills one while the render thread draws
+// the other, so the simulation runs at most one frame ahead and input reaches the screen
+// with one frame of extra latency. Whichever thread is faster waits in beginSnapshot()
+// or for the next submit(), the waits show up in both threads' timings.
+class Renderer
+{
+public:
+	int width, height;
+	// Time the simulation thread spent in the last beginSnapshot()
+	double simulationWaitMs;
+	// Where frames are drawn, 0 is the window. Headless runs draw into their own framebuffer.
+	GLuint targetFBO;
+
+	// Render resources, only touched by the render thread between start() and stop()
+	MaterialTable materials;
+	LightCluster lightCluster;
+	GBuffer gbuffer;
+	CascadedShadowMap shadows;
+	ShaderPermutations litShaders;
+	Shader lightShader;
+	Shader shadowShader;
+	// Depth prepass and overdraw view
+	Shader depthShader;
+	Shader overdrawShader;
+	// Weighted blended transparency and its composite pass
+	WeightedOIT oit;
+	Shader oitShader;
+	RingBuffer uniformRing;
+	FrameCapture capture;
+	DynamicResolution resolution;
+
+	// Needs the context current on the calling thread, starts building every lit variant
+	Renderer(int width, int height);
+	// Waits for the lit variants, call once the models are loaded
+	void finishLoading();
+
+	// Releases the context on the calling thread and starts the render thread
+	void start(GLFWwindow* window);
+	// Draws the last submitted frame, joins the render thread and makes the context current again
+	void stop();
+
+	// Simulation side: blocks until a slot is free and returns it for filling
+	FrameSnapshot& beginSnapshot();
+	void submit();
+	// Latest stats of the render thread
+	RenderStats stats();
+
+	// Draws a frame on the calling thread, for runs without the render thread
+	void draw(const FrameSnapshot& frame);
+
+	void Delete();
+
+private:
+	GLFWwindow* window;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	enum SlotState { SLOT_FREE, SLOT_FILLING, SLOT_READY, SLOT_RENDERING };
+	FrameSnapshot slots[2];
+	SlotState slotState[2];
+	int writeSlot, readSlot;
+	bool stopping;
+	RenderStats latestStats;
+
+	// Ring offsets of the current frame's packets
+	std::vector<GLintptr> objectOffsets;
+	std::vector<GLintptr> modelOffsets;
+	// Draw order of the current frame's objects and of each model's meshes, see sortOpaque()
+	std::vector<int> objectOrder;
+	std::vector<std::vector<const Mesh*>> meshOrders;
+	// Opaque source meshes of each model for the shadow passes. The static cascades are cached,
+	// so they never see the camera dependent HLOD selection.
+	std::vector<std::vector<const Mesh*>> shadowOrders;
+	std::vector<float> sortKeys;
+	std::vector<std::pair<float, const Mesh*>> meshKeys;
+	int modelDraws, hlodProxies;
+
+	// A blended draw: an object packet, or one mesh of a model packet
+	struct TransparentDraw {
+		int packet;
+		int mesh;   // -1 for objects
+	};
+	// The current frame's blended draws and their drawing order, see sortTransparent()
+	std::vector<TransparentDraw> transparentDraws;
+	std::vector<float> transparentKeys;
+	std::vector<int> transparentOrder;
+	RadixSort depthSort;
+	double transparentSortMs;
+
+	// GL_SAMPLES_PASSED of the lit opaque passes, read RING_FRAMES frames later
+	GLuint fragmentQueries[RING_FRAMES];
+	bool fragmentPending[RING_FRAMES];
+	long long fragmentPixels[RING_FRAMES];
+	int fragmentFrame;
+	long long shadedFragments;
+	float overdraw;
+
+	// Draws of the current pass, recorded on the job system
+	CommandList commands;
+	// Shadow casters, replayed for every cascade. The static list is only recorded when a cache is redrawn.
+	CommandList staticShadowCommands;
+	CommandList dynamicShadowCommands;
+	ParallelRecorder recorder;
+	double recordMs, replayMs;
+	int commandCount;
+
+	// Settings of the running capture and whether starting the wanted one failed
+	CaptureSettings activeCapture;
+	bool captureFailed;
+
+	FrameFences frameFences;
+	// Swap interval set on the context, -2 before the first frame
+	int appliedVsync;
+	bool adaptiveVsync;
+
+	void run();
+	void renderFrame(const FrameSnapshot& frame);
+	// Starts, restarts or stops the capture as the snapshot asks and reads the finished frame
+	void captureFrame(const FrameSnapshot& frame);
+	void applyVsync(int vsync);
+	void drawPacket(const DrawPacket& packet, GLintptr offset, Shader& shader);
+	// Orders the frame's opaque objects and each model's opaque meshes front to back, or keeps the
+	// submitted order. Blended draws are left out, so they skip the shadow maps and the depth prepass.
+	// Models with an HLOD get the meshes and proxies it selects for a viewport viewportHeight pixels high.
+	void sortOpaque(const FrameSnapshot& frame, int viewportHeight);
+	// Collects the blended draws, ordered back to front when sort is set
+	void sortTransparent(const FrameSnapshot& frame, bool sort);
+	// Records the packets that pass the filter in the sortOpaque() order, objects split by packet and
+	// models by mesh. Depth-only passes draw through the position streams.
+	void recordObjects(CommandList& list, const std::vector<DrawPacket>& packets, const std::vector<GLintptr>& offsets, Shader& shader, int filter, bool positionsOnly = false);
+	// The depth prepass skips alpha tested meshes, their cut out texels must not write depth
+	void recordModels(CommandList& list, const std::vector<DrawPacket>& packets, const std::vector<GLintptr>& offsets, const std::vector<std::vector<const Mesh*>>& orders, Shader& shader, int filter, bool positionsOnly = false, bool skipAlphaTested = false);
+	// Records the blended draws in the sortTransparent() order, objects and meshes interleaved
+	void recordTransparent(CommandList& list, const FrameSnapshot& frame, Shader& objectShader, Shader& modelShader);
+	// Counts the fragments of the lit opaque passes
+	void beginFragmentCount(long long pixels);
+	void endFragmentCount();
+	void replay(const CommandList& list);
+	void publishStats(double renderMs, double waitMs, double swapMs, long long frame);
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include"RingBuffer.h"
+#include"GLExt.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<chrono>
+#include<iostream>
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Constructor that creates the buffer, mapping it persistently when the driver allows it
+RingBuffer::RingBuffer(GLenum target, GLsizeiptr sectionSize)
+	: ID(0), target(target), sectionSize(0), persistent(false), bytesWritten(0), bufferCallMs(0.0), fenceWaitMs(0.0),
+	frame(RING_FRAMES - 1), head(0), committed(0), mapped(nullptr), overflowReported(false),
+	frameDemand(0), peakBytes(0), growLimit(RING_MAX_SECTION_SIZE), frameBytes(0), frameCallMs(0.0), frameWaitMs(0.0)
+{
+	GLint align = 16;
+	if (target == GL_UNIFORM_BUFFER)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	alignment = align < 16 ? 16 : align;
+
+	for (int i = 0; i < RING_FRAMES; i++)
+		fences[i] = 0;
+
+	create(sectionSize);
+	std::cout << "Ring buffer: " << RING_FRAMES << " x " << this->sectionSize / 1024 << " KB, "
+		<< (persistent ? "persistent mapping" : "glBufferSubData fallback") << std::endl;
+}
+
+bool RingBuffer::create(GLsizeiptr sectionSize)
+{
+	this->sectionSize = (sectionSize + alignment - 1) / alignment * alignment;
+	GLsizeiptr total = this->sectionSize * RING_FRAMES;
+	persistent = false;
+	mapped = nullptr;
+
+	// Errors left by earlier calls would read as a failed allocation
+	while (glGetError() != GL_NO_ERROR)
+		;
+	glGenBuffers(1, &ID);
+	glBindBuffer(target, ID);
+	if (glExt.bufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glExt.BufferStorage(target, total, NULL, flags);
+		mapped = (char*)glMapBufferRange(target, 0, total, flags);
+		persistent = mapped != nullptr;
+		if (!persistent)
+		{
+			// Storage is immutable, start over with a mutable buffer
+			glDeleteBuffers(1, &ID);
+			glGenBuffers(1, &ID);
+			glBindBuffer(target, ID);
+		}
+	}
+	if (!persistent)
+	{
+		glBufferData(target, total, NULL, GL_STREAM_DRAW);
+		staging.resize(this->sectionSize);
+	}
+	glBindBuffer(target, 0);
+	return glGetError() != GL_OUT_OF_MEMORY;
+}
+
+void RingBuffer::destroy()
+{
+	if (mapped)
+	{
+		glBindBuffer(target, ID);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = nullptr;
+	}
+	glDeleteBuffers(1, &ID);
+	ID = 0;
+}
+
+void RingBuffer::grow()
+{
+	// Every section is rewritten, so all of them have to be released first
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		if (!fences[i])
+			continue;
+		GLenum result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	frameWaitMs += msSince(start);
+
+	// Half again the peak, so a scene that keeps growing doesn't reallocate every frame
+	GLsizeiptr oldSize = sectionSize;
+	GLsizeiptr size = std::min(std::max(peakBytes + peakBytes / 2, sectionSize * 2), growLimit);
+	destroy();
+	if (create(size))
+		std::cout << "Ring buffer: grown to " << RING_FRAMES << " x " << sectionSize / 1024 << " KB" << std::endl;
+	else
+	{
+		destroy();
+		create(oldSize);
+		std::cout << "RING_BUFFER_OVERFLOW: out of memory growing past " << oldSize << " bytes, draws that don't fit are skipped" << std::endl;
+		growLimit = oldSize;
+	}
+	overflowReported = false;
+	frameCallMs += msSince(start);
+}
+
+void RingBuffer::beginFrame()
+{
+	if (peakBytes > sectionSize && sectionSize < growLimit)
+		grow();
+
+	frame = (frame + 1) % RING_FRAMES;
+	head = 0;
+	committed = 0;
+	frameDemand = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	if (fences[frame])
+	{
+		GLenum result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fences[frame]);
+		fences[frame] = 0;
+		frameWaitMs += msSince(start);
+	}
+
+	// Without persistent mapping, orphan the store once per lap so the driver can hand us fresh memory
+	if (!persistent && frame == 0)
+	{
+		glBindBuffer(target, ID);
+		glBufferData(target, sectionSize * RING_FRAMES, NULL, GL_STREAM_DRAW);
+		glBindBuffer(target, 0);
+	}
+	frameCallMs += msSince(start);
+}
+
+void* RingBuffer::allocate(GLsizeiptr size, GLintptr& offset)
+{
+	frameDemand = (frameDemand + alignment - 1) / alignment * alignment + size;
+	peakBytes = std::max(peakBytes, frameDemand);
+	GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+	if (start + size > sectionSize)
+	{
+		// Everything handed out this frame is still waiting to be drawn, nothing may be reused
+		if (!overflowReported)
+			std::cout << "RING_BUFFER_OVERFLOW: frame needs more than " << sectionSize << " bytes, "
+				<< (sectionSize < growLimit ? "growing the ring next frame" : "skipping the draws that don't fit") << std::endl;
+		overflowReported = true;
+		offset = -1;
+		return nullptr;
+	}
+	head = start + size;
+	frameBytes += size;
+
+	offset = frame * sectionSize + start;
+	if (persistent)
+		return mapped + offset;
+	return staging.data() + start;
+}
+
+void RingBuffer::commit()
+{
+	if (head == committed)
+		return;
+	if (persistent)
+	{
+		// Written straight into mapped memory, counted like the glBufferSubData it replaces
+		GL_STATS_ADD(STAT_UPLOADS, 1);
+		GL_STATS_ADD(STAT_UPLOAD_BYTES, head - committed);
+		committed = head;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	glBindBuffer(target, ID);
+	glBufferSubData(target, frame * sectionSize + committed, head - committed, staging.data() + committed);
+	glBindBuffer(target, 0);
+	committed = head;
+	frameCallMs += msSince(start);
+}
+
+void RingBuffer::bindRange(GLuint index, GLintptr offset, GLsizeiptr size)
+{
+	auto start = std::chrono::steady_clock::now();
+	glBindBufferRange(target, index, ID, offset, size);
+	frameCallMs += msSince(start);
+}
+
+void RingBuffer::endFrame()
+{
+	auto start = std::chrono::steady_clock::now();
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frameCallMs += msSince(start);
+
+	bytesWritten = frameBytes;
+	bufferCallMs = frameCallMs;
+	fenceWaitMs = frameWaitMs;
+	frameBytes = 0;
+	frameCallMs = 0.0;
+	frameWaitMs = 0.0;
+}
+
+void RingBuffer::Delete()
+{
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	destroy();
+}
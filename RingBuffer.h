@@ -0,0 +1,92 @@
+#ifndef RING_BUFFER_CLASS_H
+#define RING_BUFFER_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+#include<cstring>
+
+// Streams per-frame data (uniform blocks, instance data, debug geometry) into one
+// GPU buffer split into RING_FRAMES sections. The section used by frame N is only
+// reused once the fence placed at the end of frame N has been signalled, so the
+// CPU never writes memory the GPU is still reading.
+//
+// With buffer storage (GL 4.4 / ARB_buffer_storage) the buffer is mapped once,
+// persistently and coherently, and allocate() hands out pointers straight into it.
+// On plain 3.3 the writes go to a CPU staging copy that commit() uploads with a
+// single glBufferSubData per frame, and the buffer is orphaned when the ring wraps.
+//
+// A frame that needs more than its section gets -1 offsets for the blocks that don't
+// fit, its callers skip those draws. The next beginFrame() waits for every fence and
+// reallocates all sections to fit the peak, up to RING_MAX_SECTION_SIZE.
+#define RING_FRAMES 3
+#define RING_MAX_SECTION_SIZE (64 * 1024 * 1024)
+
+class RingBuffer
+{
+public:
+	// ID reference of the buffer object
+	GLuint ID;
+	GLenum target;
+	// Bytes available to a single frame
+	GLsizeiptr sectionSize;
+	// True when the buffer is persistently mapped
+	bool persistent;
+
+	// Statistics of the last finished frame
+	GLsizeiptr bytesWritten;
+	// CPU time spent inside GL buffer calls (map, upload, bind, fence)
+	double bufferCallMs;
+	// Part of bufferCallMs spent waiting for the GPU to release a section
+	double fenceWaitMs;
+
+	RingBuffer(GLenum target, GLsizeiptr sectionSize);
+
+	// Waits until the next section is free and starts writing into it
+	void beginFrame();
+	// Reserves size bytes in the current section, offset receives the buffer offset.
+	// Returns nullptr and offset -1 when the section is full.
+	void* allocate(GLsizeiptr size, GLintptr& offset);
+	// Copies a POD value into the ring and returns its buffer offset, -1 when it didn't fit
+	template<typename T>
+	GLintptr push(const T& data)
+	{
+		GLintptr offset;
+		void* dst = allocate(sizeof(T), offset);
+		if (dst)
+			std::memcpy(dst, &data, sizeof(T));
+		return offset;
+	}
+	// Makes everything allocated so far visible to the GPU, call before drawing with it
+	void commit();
+	// Binds a range of the ring to an indexed target (uniform blocks)
+	void bindRange(GLuint index, GLintptr offset, GLsizeiptr size);
+	// Fences the current section
+	void endFrame();
+	void Delete();
+
+private:
+	// Makes the buffer of RING_FRAMES sections, false when the driver is out of memory
+	bool create(GLsizeiptr sectionSize);
+	void destroy();
+	// Reallocates every section to fit peakBytes, the fences must be idle
+	void grow();
+
+	GLsizeiptr alignment;
+	int frame;
+	GLsizeiptr head;
+	GLsizeiptr committed;
+	char* mapped;
+	std::vector<char> staging;
+	GLsync fences[RING_FRAMES];
+	bool overflowReported;
+	// Bytes the current frame asked for, fitting or not, and the most any frame asked for
+	GLsizeiptr frameDemand;
+	GLsizeiptr peakBytes;
+	// Largest section the ring may still grow to
+	GLsizeiptr growLimit;
+	GLsizeiptr frameBytes;
+	double frameCallMs;
+	double frameWaitMs;
+};
+
+#endif
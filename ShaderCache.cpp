@@ -0,0 +1,138 @@
+#include"ShaderCache.h"
+#include"GLExt.h"
+#include"GLStats.h"
+
+#include<cstdio>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<vector>
+
+ShaderCache shaderCache;
+
+// Identifies a cache file, bumped when the layout below changes
+static const uint32_t cacheMagic = 0x42504C47; // "GLPB"
+static const uint32_t cacheVersion = 1;
+
+struct CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t length;
+	// Driver string length, the string itself follows the header, then the binary
+	uint32_t driverLength;
+};
+
+// 64-bit FNV-1a
+static uint64_t hashString(const std::string& data, uint64_t hash = 14695981039346656037ull)
+{
+	for (unsigned char c : data)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+ShaderCache::ShaderCache()
+	: enabled(true), directory("shader_cache"), hits(0), misses(0), totalMs(0.0)
+{
+}
+
+std::string ShaderCache::makeKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	if (driver.empty())
+	{
+		const char* strings[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+		for (const char* s : strings)
+		{
+			driver += s ? s : "?";
+			driver += '|';
+		}
+	}
+	// Separators so moving text between the stages changes the key
+	uint64_t hash = hashString(vertexCode);
+	hash = hashString("\x01", hash);
+	hash = hashString(fragmentCode, hash);
+	hash = hashString("\x01", hash);
+	hash = hashString(driver, hash);
+
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return name;
+}
+
+std::string ShaderCache::path(const std::string& key) const
+{
+	return directory + "/" + key + ".bin";
+}
+
+bool ShaderCache::load(GLuint program, const std::string& key)
+{
+	if (!enabled || !glExt.programBinary)
+		return false;
+	std::ifstream in(path(key), std::ios::binary);
+	if (!in)
+		return false;
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path(key), error);
+	if (error || fileSize < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	if (!in.read((char*)&header, sizeof(header)) || header.magic != cacheMagic || header.version != cacheVersion)
+		return false;
+	// A truncated or corrupt file is a miss, not a huge allocation
+	if (header.length == 0 || (uintmax_t)header.driverLength + header.length != fileSize - sizeof(header))
+		return false;
+	std::string fileDriver(header.driverLength, '\0');
+	std::vector<char> binary(header.length);
+	if (!in.read(&fileDriver[0], header.driverLength) || !in.read(binary.data(), header.length))
+		return false;
+	// The key already hashes the driver, this only guards against hash collisions
+	if (fileDriver != driver)
+		return false;
+
+	glExt.ProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+		std::cout << "Shader cache: driver rejected " << key << ", recompiling" << std::endl;
+	return linked == GL_TRUE;
+}
+
+void ShaderCache::store(GLuint program, const std::string& key)
+{
+	if (!enabled || !glExt.programBinary)
+		return;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glExt.GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	std::ofstream out(path(key), std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::cout << "Shader cache: can't write " << path(key) << std::endl;
+		return;
+	}
+	CacheHeader header = { cacheMagic, cacheVersion, format, (uint32_t)written, (uint32_t)driver.size() };
+	out.write((const char*)&header, sizeof(header));
+	out.write(driver.data(), driver.size());
+	out.write(binary.data(), written);
+}
+
+void ShaderCache::clear()
+{
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
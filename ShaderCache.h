@@ -0,0 +1,44 @@
+#ifndef SHADER_CACHE_CLASS_H
+#define SHADER_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+#include<cstdint>
+
+// On-disk cache of linked programs. Shader stores the glGetProgramBinary blob of every
+// program it links under a key hashed from both final sources (defines included) and
+// the driver's vendor/renderer/version strings, and the next launch loads it with
+// glProgramBinary instead of compiling. A driver update, an edited shader or a binary
+// the driver rejects all fall back to compiling from source, which refreshes the entry.
+//
+// Needs GL 4.1 or GL_ARB_get_program_binary, otherwise every program compiles from source.
+class ShaderCache
+{
+public:
+	bool enabled;
+	std::string directory;
+
+	// Programs created since startup and the CPU time Shader spent building them
+	int hits;
+	int misses;
+	double totalMs;
+
+	ShaderCache();
+
+	// Key of a program, also names its file
+	std::string makeKey(const std::string& vertexCode, const std::string& fragmentCode);
+	// Loads the cached binary into program, true when the driver accepted and linked it
+	bool load(GLuint program, const std::string& key);
+	// Writes the binary of a linked program
+	void store(GLuint program, const std::string& key);
+	// Deletes every cached binary
+	void clear();
+
+private:
+	std::string driver;
+	std::string path(const std::string& key) const;
+};
+
+extern ShaderCache shaderCache;
+
+#endif
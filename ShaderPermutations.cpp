@@ -0,0 +1,109 @@
+#include"ShaderPermutations.h"
+#include"GLExt.h"
+
+#include<algorithm>
+#include<thread>
+
+static const char* featureNames[SHADER_FEATURE_COUNT] = {
+	"TEXTURED", "GBUFFER", "DEFERRED_LIGHTING", "CLUSTERED_LIGHTS", "SHADOWS", "WEIGHTED_OIT"
+};
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ShaderPermutations::ShaderPermutations(const char* vertexFile, const char* fragmentFile)
+	: variantCount(0), submitMs(0.0), buildMs(0.0), vertexFile(vertexFile), fragmentFile(fragmentFile)
+{
+}
+
+std::string ShaderPermutations::defines(unsigned int features)
+{
+	std::string lines;
+	for (int bit = 0; bit < SHADER_FEATURE_COUNT; bit++)
+	{
+		if (features & (1u << bit))
+			lines += std::string("#define ") + featureNames[bit] + "\n";
+	}
+	return lines;
+}
+
+void ShaderPermutations::request(unsigned int features)
+{
+	if (std::find(requested.begin(), requested.end(), features) == requested.end())
+		requested.push_back(features);
+}
+
+void ShaderPermutations::build()
+{
+	buildStart = std::chrono::steady_clock::now();
+	for (unsigned int features : requested)
+	{
+		if (variants.count(features))
+			continue;
+		variants[features].begin(vertexFile.c_str(), fragmentFile.c_str(), defines(features));
+		pending.push_back(features);
+	}
+	requested.clear();
+	submitMs = msSince(buildStart);
+	variantCount = (int)variants.size();
+	// Without the extension the driver compiled inside begin(), collecting is instant
+	poll();
+}
+
+void ShaderPermutations::finishVariant(unsigned int features)
+{
+	Shader& shader = variants[features];
+	shader.finish();
+	if (setup)
+		setup(shader, features);
+}
+
+bool ShaderPermutations::poll()
+{
+	if (pending.empty())
+		return true;
+	for (size_t i = 0; i < pending.size();)
+	{
+		if (variants[pending[i]].isReady())
+		{
+			finishVariant(pending[i]);
+			pending.erase(pending.begin() + i);
+		}
+		else
+			i++;
+	}
+	if (pending.empty())
+		buildMs = msSince(buildStart);
+	return pending.empty();
+}
+
+void ShaderPermutations::wait()
+{
+	while (!poll())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+Shader& ShaderPermutations::get(unsigned int features)
+{
+	auto it = variants.find(features);
+	if (it != variants.end())
+		return it->second;
+
+	std::cout << "Shader variant '" << fragmentFile << "' 0x" << std::hex << features << std::dec
+		<< " was not requested, building it now" << std::endl;
+	variants[features].begin(vertexFile.c_str(), fragmentFile.c_str(), defines(features));
+	finishVariant(features);
+	variantCount = (int)variants.size();
+	return variants[features];
+}
+
+void ShaderPermutations::Delete()
+{
+	for (auto& variant : variants)
+		variant.second.Delete();
+	variants.clear();
+	pending.clear();
+	requested.clear();
+}
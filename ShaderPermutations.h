@@ -0,0 +1,66 @@
+#ifndef SHADER_PERMUTATIONS_CLASS_H
+#define SHADER_PERMUTATIONS_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+#include<vector>
+#include<map>
+#include<functional>
+#include<chrono>
+
+#include "shaderClass.h"
+
+// Feature bits of lit.vert / lit.frag, each one becomes a #define of the same name
+enum ShaderFeature {
+	SHADER_TEXTURED = 1 << 0,
+	SHADER_GBUFFER = 1 << 1,
+	SHADER_DEFERRED_LIGHTING = 1 << 2,
+	SHADER_CLUSTERED_LIGHTS = 1 << 3,
+	SHADER_SHADOWS = 1 << 4,
+	SHADER_WEIGHTED_OIT = 1 << 5
+};
+#define SHADER_FEATURE_COUNT 6
+
+// Variants of one vertex/fragment source pair, one program per feature mask.
+//
+// Variants are requested up front and build() submits all of them at once, so the
+// driver can compile them in parallel (KHR_parallel_shader_compile) while the CPU
+// does other work. poll() finishes whichever programs completed and never waits;
+// wait() blocks until all are done. get() on a variant that was never requested
+// still works but builds it synchronously and says so on stdout.
+class ShaderPermutations
+{
+public:
+	// Called once for every finished variant, to point its samplers at their units
+	std::function<void(Shader&, unsigned int)> setup;
+
+	// Statistics of the last build()
+	int variantCount;
+	double submitMs;   // issuing every compile and link
+	double buildMs;    // build() until the last variant finished
+
+	ShaderPermutations(const char* vertexFile, const char* fragmentFile);
+
+	void request(unsigned int features);
+	// Starts building every requested variant that doesn't exist yet
+	void build();
+	// Finishes the variants the driver completed, true when none is pending
+	bool poll();
+	void wait();
+	// Program of a variant, must not be called while it is pending
+	Shader& get(unsigned int features);
+	// The #define lines of a feature mask
+	static std::string defines(unsigned int features);
+	void Delete();
+
+private:
+	std::string vertexFile, fragmentFile;
+	std::vector<unsigned int> requested;
+	std::vector<unsigned int> pending;
+	std::map<unsigned int, Shader> variants;
+	std::chrono::steady_clock::time_point buildStart;
+
+	void finishVariant(unsigned int features);
+};
+
+#endif
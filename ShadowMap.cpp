@@ -0,0 +1,280 @@
+#include"ShadowMap.h"
+#include"GLStats.h"
+
+#include<algorithm>
+#include<cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+// How far behind a cascade (towards the light) casters are still captured
+static const float casterDistance = 50.0f;
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+CascadedShadowMap::CascadedShadowMap(int resolution)
+	: resolution(resolution), shadowDistance(40.0f), splitLambda(0.75f), depthBias(0.0005f), normalBias(1.5f),
+	enabled(true), shadowCpuMs(0.0), shadowGpuMs(0.0), cacheArray(0), shadowArray(0),
+	cachedLightDir(0.0f), lightView(1.0f), windowStart(std::chrono::steady_clock::now()), queryFrame(0)
+{
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		lightSpace[c] = glm::mat4(1.0f);
+		splits[c] = 0.0f;
+		staticRedraws[c] = 0;
+		staticRedrawsPerSecond[c] = 0.0f;
+		cacheFBOs[c] = 0;
+		shadowFBOs[c] = 0;
+		cachedCenter[c] = glm::vec3(0.0f);
+		cachedRadius[c] = 0.0f;
+		stale[c] = true;
+		windowRedraws[c] = 0;
+	}
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		timeQueries[i] = 0;
+		queryPending[i] = false;
+	}
+}
+
+static GLuint createDepthArray(int resolution, bool compare)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	// Linear filtering on a compare texture gives 2x2 PCF for free
+	GLenum filter = compare ? GL_LINEAR : GL_NEAREST;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+	// Outside the cascade counts as lit
+	const float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	if (compare)
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	return texture;
+}
+
+void CascadedShadowMap::create()
+{
+	cacheArray = createDepthArray(resolution, false);
+	shadowArray = createDepthArray(resolution, true);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// One depth-only framebuffer per layer
+	glGenFramebuffers(SHADOW_CASCADES, cacheFBOs);
+	glGenFramebuffers(SHADOW_CASCADES, shadowFBOs);
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		for (int target = 0; target < 2; target++)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, target == 0 ? cacheFBOs[c] : shadowFBOs[c]);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target == 0 ? cacheArray : shadowArray, 0, c);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				std::cout << "ERROR: shadow cascade " << c << " framebuffer is incomplete" << std::endl;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenQueries(RING_FRAMES, timeQueries);
+}
+
+void CascadedShadowMap::update(const glm::mat4& view, float fov, float aspect, float zNear, const glm::vec3& lightDir)
+{
+	// Practical split scheme, a blend of logarithmic and uniform splits
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		float p = (float)(c + 1) / SHADOW_CASCADES;
+		float logSplit = zNear * std::pow(shadowDistance / zNear, p);
+		float uniformSplit = zNear + (shadowDistance - zNear) * p;
+		splits[c] = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+	}
+
+	glm::vec3 dir = glm::normalize(lightDir);
+	if (glm::dot(dir, cachedLightDir) < 0.99999f)
+	{
+		cachedLightDir = dir;
+		glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		// Rotation only, the cascades translate inside their own projection
+		lightView = glm::lookAt(glm::vec3(0.0f), -dir, up);
+		invalidateStatic();
+	}
+
+	glm::mat4 invView = glm::inverse(view);
+	float tanY = std::tan(fov * 0.5f);
+	float tanX = tanY * aspect;
+	float k = tanX * tanX + tanY * tanY;
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		// Smallest sphere around the frustum slice, centred on the view axis.
+		// Its size only depends on fov and splits, so turning the camera never resizes a cascade.
+		float n = c == 0 ? zNear : splits[c - 1];
+		float f = splits[c];
+		float z = std::min((f + n) * (1.0f + k) * 0.5f, f);
+		float radius = std::sqrt(f * f * k + (f - z) * (f - z));
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		glm::vec3 center = glm::vec3(lightView * invView * glm::vec4(0.0f, 0.0f, -z, 1.0f));
+
+		// Keep the cached projection while the slice fits inside it and it isn't far too big
+		bool fits = glm::length(center - cachedCenter[c]) + radius <= cachedRadius[c] &&
+			radius * SHADOW_CACHE_PADDING * SHADOW_CACHE_PADDING >= cachedRadius[c];
+		if (stale[c] || !fits)
+		{
+			float padded = radius * SHADOW_CACHE_PADDING;
+			float texel = 2.0f * padded / resolution;
+			cachedCenter[c] = glm::vec3(std::floor(center.x / texel) * texel, std::floor(center.y / texel) * texel, center.z);
+			cachedRadius[c] = padded;
+			stale[c] = true;
+		}
+
+		glm::vec3 cc = cachedCenter[c];
+		float r = cachedRadius[c];
+		// The light looks down -z, casters closer to it have a larger z
+		glm::mat4 projection = glm::ortho(cc.x - r, cc.x + r, cc.y - r, cc.y + r, -(cc.z + r + casterDistance), -(cc.z - r));
+		lightSpace[c] = projection * lightView;
+	}
+}
+
+void CascadedShadowMap::invalidateStatic()
+{
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+		stale[c] = true;
+}
+
+bool CascadedShadowMap::needsStatic(int c) const
+{
+	return stale[c];
+}
+
+void CascadedShadowMap::beginPass()
+{
+	passStart = std::chrono::steady_clock::now();
+	if (!cacheArray)
+		create();
+
+	// The query reused now was issued RING_FRAMES frames ago and is normally done
+	if (queryPending[queryFrame])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(timeQueries[queryFrame], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(timeQueries[queryFrame], GL_QUERY_RESULT, &ns);
+			shadowGpuMs = ns / 1e6;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, timeQueries[queryFrame]);
+
+	glViewport(0, 0, resolution, resolution);
+	// Slope scaled bias against acne on surfaces facing away from the light
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+}
+
+void CascadedShadowMap::beginStatic(int c, Shader& depthShader)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, cacheFBOs[c]);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	depthShader.Activate();
+	depthShader.setMat4("cascadeMatrix", lightSpace[c]);
+	stale[c] = false;
+	staticRedraws[c]++;
+	windowRedraws[c]++;
+}
+
+void CascadedShadowMap::beginDynamic(int c, Shader& depthShader)
+{
+	// Start from the static shadows, the dynamic objects are depth tested against them
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, cacheFBOs[c]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowFBOs[c]);
+	glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowFBOs[c]);
+	depthShader.Activate();
+	depthShader.setMat4("cascadeMatrix", lightSpace[c]);
+}
+
+void CascadedShadowMap::endPass(int viewportWidth, int viewportHeight, GLuint framebuffer)
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, viewportWidth, viewportHeight);
+
+	glEndQuery(GL_TIME_ELAPSED);
+	queryPending[queryFrame] = true;
+	queryFrame = (queryFrame + 1) % RING_FRAMES;
+
+	shadowCpuMs = msSince(passStart);
+
+	// Redraw rates over the last second
+	double window = msSince(windowStart);
+	if (window >= 1000.0)
+	{
+		for (int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			staticRedrawsPerSecond[c] = (float)(windowRedraws[c] * 1000.0 / window);
+			windowRedraws[c] = 0;
+		}
+		windowStart = std::chrono::steady_clock::now();
+	}
+}
+
+ShadowUniforms CascadedShadowMap::getUniforms() const
+{
+	ShadowUniforms block;
+	block.cascadeSplits = glm::vec4(0.0f);
+	block.cascadeTexel = glm::vec4(0.0f);
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		block.lightSpace[c] = lightSpace[c];
+		block.cascadeSplits[c] = splits[c];
+		block.cascadeTexel[c] = 2.0f * cachedRadius[c] / resolution;
+	}
+	block.shadowParams = glm::vec4(depthBias, normalBias, enabled ? 1.0f : 0.0f, (float)SHADOW_CASCADES);
+	return block;
+}
+
+void CascadedShadowMap::setupShader(Shader& shader)
+{
+	shader.Activate();
+	shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+}
+
+void CascadedShadowMap::bind()
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadowArray);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void CascadedShadowMap::Delete()
+{
+	if (cacheArray)
+	{
+		glDeleteFramebuffers(SHADOW_CASCADES, cacheFBOs);
+		glDeleteFramebuffers(SHADOW_CASCADES, shadowFBOs);
+		glDeleteTextures(1, &cacheArray);
+		glDeleteTextures(1, &shadowArray);
+		glDeleteQueries(RING_FRAMES, timeQueries);
+	}
+	cacheArray = shadowArray = 0;
+	for (int c = 0; c < SHADOW_CASCADES; c++)
+	{
+		cacheFBOs[c] = 0;
+		shadowFBOs[c] = 0;
+		stale[c] = true;
+	}
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		timeQueries[i] = 0;
+		queryPending[i] = false;
+	}
+}
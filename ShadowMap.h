@@ -0,0 +1,102 @@
+#ifndef SHADOW_MAP_CLASS_H
+#define SHADOW_MAP_CLASS_H
+
+#include<glad/glad.h>
+#include <glm/glm.hpp>
+#include<chrono>
+
+#include "shaderClass.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+
+// Texture unit of the cascade array, after the G-buffer targets
+#define SHADOW_MAP_UNIT 14
+
+// Cached cascades cover this much more than the camera needs, so small camera moves
+// stay inside the cached area instead of forcing a static redraw
+#define SHADOW_CACHE_PADDING 1.3f
+
+// Cascaded shadow maps for the main light, treated as a directional light.
+//
+// Every cascade owns two layers: a cache holding only the static geometry and the
+// layer the shaders sample. The cache is redrawn only when the light direction or
+// the static geometry changes, or when the camera leaves the cached area. Every
+// frame the cache is blitted into the sampled layer and the dynamic objects are
+// drawn on top of it.
+//
+// Cascades are fitted to a bounding sphere of their frustum slice and their centre
+// is snapped to whole shadow texels, so the projection only changes by texel steps
+// and the cached shadows don't shimmer while the camera moves or turns.
+class CascadedShadowMap
+{
+public:
+	int resolution;
+	// View depth covered by all cascades together
+	float shadowDistance;
+	// Blend between uniform (0) and logarithmic (1) split distances
+	float splitLambda;
+	float depthBias;
+	// Offset along the surface normal, in shadow texels
+	float normalBias;
+	bool enabled;
+
+	// Light-space matrices and split depths of the current frame
+	glm::mat4 lightSpace[SHADOW_CASCADES];
+	float splits[SHADOW_CASCADES];
+
+	// Statistics
+	int staticRedraws[SHADOW_CASCADES];         // since startup
+	float staticRedrawsPerSecond[SHADOW_CASCADES];
+	double shadowCpuMs;                          // submitting the shadow passes
+	double shadowGpuMs;                          // GPU time of the shadow passes, a few frames late
+
+	CascadedShadowMap(int resolution = 2048);
+
+	// Fits the cascades to the camera and decides which caches are stale, lightDir points towards the light
+	void update(const glm::mat4& view, float fov, float aspect, float zNear, const glm::vec3& lightDir);
+	// Forces every static cache to redraw, call when static geometry moved
+	void invalidateStatic();
+	// True when the static cache of cascade c has to be redrawn this frame
+	bool needsStatic(int c) const;
+
+	// Shadow passes of all cascades go between beginPass() and endPass(). For each cascade
+	// beginStatic() binds and clears the cache, beginDynamic() copies the cache into the
+	// sampled layer and binds that. Both hand the cascade's matrix to the depth shader.
+	void beginPass();
+	void beginStatic(int c, Shader& depthShader);
+	void beginDynamic(int c, Shader& depthShader);
+	// Rebinds framebuffer, the target the frame is drawn into
+	void endPass(int viewportWidth, int viewportHeight, GLuint framebuffer = 0);
+
+	// "Shadows" uniform block of the current frame
+	ShadowUniforms getUniforms() const;
+	// Points the shadowMap sampler of a program at its texture unit, once per program
+	void setupShader(Shader& shader);
+	void bind();
+	void Delete();
+
+private:
+	GLuint cacheArray, shadowArray;
+	GLuint cacheFBOs[SHADOW_CASCADES];
+	GLuint shadowFBOs[SHADOW_CASCADES];
+
+	// Cached light-space sphere each cascade was last rendered for
+	glm::vec3 cachedCenter[SHADOW_CASCADES];
+	float cachedRadius[SHADOW_CASCADES];
+	bool stale[SHADOW_CASCADES];
+	glm::vec3 cachedLightDir;
+	glm::mat4 lightView;
+
+	// Redraw rate bookkeeping
+	int windowRedraws[SHADOW_CASCADES];
+	std::chrono::steady_clock::time_point windowStart;
+
+	GLuint timeQueries[RING_FRAMES];
+	bool queryPending[RING_FRAMES];
+	int queryFrame;
+	std::chrono::steady_clock::time_point passStart;
+
+	void create();
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include"StaticBatcher.h"
+#include"model.h"
+#include"JobSystem.h"
+
+#include<algorithm>
+#include<chrono>
+#include<map>
+
+StaticBatcher::StaticBatcher()
+	: meshesBefore(0), meshesAfter(0), mergedMeshes(0), buildMs(0.0)
+{
+}
+
+void StaticBatcher::build(Model& model)
+{
+	auto start = std::chrono::steady_clock::now();
+	vector<Mesh>& meshes = model.meshes;
+	meshesBefore = (int)meshes.size();
+	mergedMeshes = 0;
+
+	// Groups of meshes that draw with the same material, in the order they first appear
+	std::vector<StaticBatchInput> inputs(meshes.size());
+	glm::vec3 modelLow(0.0f), modelHigh(0.0f);
+	bool bounded = false;
+	std::map<std::vector<unsigned int>, int> groupIndices;
+	std::vector<std::vector<int>> groups;
+	std::vector<int> unbatched;
+	for (int i = 0; i < (int)meshes.size(); i++)
+	{
+		const Mesh& mesh = meshes[i];
+		if (mesh.blended || mesh.indices.empty())
+		{
+			unbatched.push_back(i);
+			continue;
+		}
+		StaticBatchInput& input = inputs[i];
+		input.low = input.high = mesh.vertices[0].Position;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			input.low = glm::min(input.low, vertex.Position);
+			input.high = glm::max(input.high, vertex.Position);
+		}
+		input.vertices = (int)mesh.vertices.size();
+		modelLow = bounded ? glm::min(modelLow, input.low) : input.low;
+		modelHigh = bounded ? glm::max(modelHigh, input.high) : input.high;
+		bounded = true;
+
+		// Without a material table the mesh binds its own textures, those make the key
+		std::vector<unsigned int> key = { (unsigned int)mesh.materialIndex };
+		for (const Texture& texture : mesh.textures)
+			key.push_back(texture.id);
+		auto found = groupIndices.emplace(key, (int)groups.size());
+		if (found.second)
+			groups.emplace_back();
+		groups[found.first->second].push_back(i);
+	}
+
+	glm::vec3 size = modelHigh - modelLow;
+	float maxExtent = std::max(size.x, std::max(size.y, size.z)) / STATIC_BATCH_GRID;
+	std::vector<int> order;
+	std::vector<std::pair<int, int>> batches;
+	for (const std::vector<int>& group : groups)
+	{
+		int first = (int)order.size();
+		order.insert(order.end(), group.begin(), group.end());
+		split(inputs, order, first, (int)group.size(), STATIC_BATCH_MAX_VERTICES, maxExtent, batches);
+	}
+
+	// Batches of several meshes are merged in parallel, indices move by the vertices before them
+	std::vector<std::vector<Vertex>> batchVertices(batches.size());
+	std::vector<std::vector<unsigned int>> batchIndices(batches.size());
+	jobSystem.parallelFor((int)batches.size(), 1, [&](int begin, int end) {
+		for (int b = begin; b < end; b++)
+		{
+			if (batches[b].second == 1)
+				continue;
+			std::vector<Vertex>& vertices = batchVertices[b];
+			std::vector<unsigned int>& indices = batchIndices[b];
+			for (int i = batches[b].first; i < batches[b].first + batches[b].second; i++)
+			{
+				const Mesh& mesh = meshes[order[i]];
+				unsigned int base = (unsigned int)vertices.size();
+				vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+				for (unsigned int index : mesh.indices)
+					indices.push_back(base + index);
+			}
+		}
+	});
+
+	// GL objects are made and freed on this thread, a batch of one keeps its mesh
+	std::vector<Mesh> batched;
+	batched.reserve(batches.size() + unbatched.size());
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		int first = batches[b].first, count = batches[b].second;
+		if (count == 1)
+		{
+			batched.push_back(std::move(meshes[order[first]]));
+			continue;
+		}
+		const Mesh& source = meshes[order[first]];
+		batched.emplace_back(std::move(batchVertices[b]), std::move(batchIndices[b]), source.textures);
+		batched.back().materialIndex = source.materialIndex;
+		batched.back().alphaTested = source.alphaTested;
+		for (int i = first; i < first + count; i++)
+			meshes[order[i]].Delete();
+		mergedMeshes += count;
+	}
+	for (int i : unbatched)
+		batched.push_back(std::move(meshes[i]));
+	meshes = std::move(batched);
+	meshesAfter = (int)meshes.size();
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void StaticBatcher::split(const std::vector<StaticBatchInput>& inputs, std::vector<int>& order, int first, int count, int maxVertices, float maxExtent, std::vector<std::pair<int, int>>& batches)
+{
+	auto centre = [&](int mesh) { return (inputs[mesh].low + inputs[mesh].high) * 0.5f; };
+	glm::vec3 low = inputs[order[first]].low, high = inputs[order[first]].high;
+	glm::vec3 centreLow = centre(order[first]), centreHigh = centreLow;
+	long long vertices = 0;
+	for (int i = first; i < first + count; i++)
+	{
+		const StaticBatchInput& input = inputs[order[i]];
+		low = glm::min(low, input.low);
+		high = glm::max(high, input.high);
+		centreLow = glm::min(centreLow, centre(order[i]));
+		centreHigh = glm::max(centreHigh, centre(order[i]));
+		vertices += input.vertices;
+	}
+	glm::vec3 size = high - low;
+	if (count == 1 || (vertices <= maxVertices && std::max(size.x, std::max(size.y, size.z)) <= maxExtent))
+	{
+		batches.push_back({ first, count });
+		return;
+	}
+
+	// Halves at the median centre along the axis the centres spread most, each keeps its neighbours
+	glm::vec3 spread = centreHigh - centreLow;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+	int half = count / 2;
+	std::vector<int>::iterator begin = order.begin() + first;
+	std::nth_element(begin, begin + half, begin + count, [&](int a, int b) { return centre(a)[axis] < centre(b)[axis]; });
+	split(inputs, order, first, half, maxVertices, maxExtent, batches);
+	split(inputs, order, first + half, count - half, maxVertices, maxExtent, batches);
+}
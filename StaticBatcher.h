@@ -0,0 +1,50 @@
+#ifndef STATIC_BATCHER_CLASS_H
+#define STATIC_BATCHER_CLASS_H
+
+#include <glm/glm.hpp>
+#include<utility>
+#include<vector>
+
+class Model;
+
+// Vertices one batch may hold, a single mesh above it stays as it is
+#define STATIC_BATCH_MAX_VERTICES 65536
+// A batch spans at most the model's longest side over this, so it stays small enough to sort and cull
+#define STATIC_BATCH_GRID 4
+
+// Bounds and size of one mesh for split(), in model space
+struct StaticBatchInput {
+	glm::vec3 low, high;
+	int vertices;
+};
+
+// Load-time static batching of an imported model.
+//
+// Model::processNode() bakes the node transforms into the vertices, so meshes of one model
+// only differ by their material. build() groups the meshes by material (or by texture set
+// without a material table) and merges every group into combined vertex and index buffers,
+// one draw each. Groups are split at the median of the mesh centres along their longest
+// axis until a batch is under STATIC_BATCH_MAX_VERTICES and 1 / STATIC_BATCH_GRID of the
+// model, so the batches stay spatially coherent for depth sorting and the HLOD quadtree.
+// Blended meshes are left alone, they are sorted back to front one by one.
+class StaticBatcher
+{
+public:
+	// Report of the last build(): draws of the model before and after
+	int meshesBefore, meshesAfter;
+	// Source meshes that went into batches of more than one mesh
+	int mergedMeshes;
+	double buildMs;
+
+	StaticBatcher();
+
+	// Replaces model.meshes with the batches and frees the GL objects of the merged meshes.
+	// Needs the GL context, run it before anything keeps pointers to the meshes (HLOD::build()).
+	void build(Model& model);
+
+	// Splits order[first, first + count) into batches, appends one (first, count) range of
+	// order per batch. Pure CPU work.
+	static void split(const std::vector<StaticBatchInput>& inputs, std::vector<int>& order, int first, int count, int maxVertices, float maxExtent, std::vector<std::pair<int, int>>& batches);
+};
+
+#endif
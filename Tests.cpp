@@ -0,0 +1,341 @@
+#include<algorithm>
+#include<atomic>
+#include<cstring>
+#include<iostream>
+#include<vector>
+
+#include <glm/glm.hpp>
+
+#include "CommandList.h"
+#include "FixedTimestep.h"
+#include "FrameCapture.h"
+#include "GLStats.h"
+#include "Headless.h"
+#include "HLOD.h"
+#include "StaticBatcher.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+// Entry point of graphics-tests: checks of the engine code that runs without a GL context.
+// Prints every failed check and returns the number of failures.
+
+static int failures = 0;
+static int checks = 0;
+
+static void check(bool passed, const char* condition, const char* file, int line)
+{
+	checks++;
+	if (passed)
+		return;
+	std::cout << file << ":" << line << ": FAILED " << condition << std::endl;
+	failures++;
+}
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void testParallelFor()
+{
+	for (int count : { 0, 1, 63, 64, 1000, 100000 })
+	{
+		std::vector<std::atomic<int>> visits(count);
+		for (std::atomic<int>& visit : visits)
+			visit = 0;
+		jobSystem.parallelFor(count, 64, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				visits[i]++;
+		});
+		bool once = true;
+		for (std::atomic<int>& visit : visits)
+			once = once && visit == 1;
+		CHECK(once);
+	}
+}
+
+static void testJobDependencies()
+{
+	// Each stage reads what every job of the stage before it wrote
+	const int count = 64;
+	std::vector<int> first(count, 0), second(count, 0);
+	std::atomic<int> sum(0);
+	JobCounter firstDone, secondDone, sumDone;
+	for (int i = 0; i < count; i++)
+		jobSystem.run([&first, i]() { first[i] = i + 1; }, &firstDone);
+	for (int i = 0; i < count; i++)
+		jobSystem.runAfter(firstDone, [&first, &second, i]() { second[i] = first[i] + first[count - 1 - i]; }, &secondDone);
+	jobSystem.runAfter(secondDone, [&second, &sum]() {
+		for (int value : second)
+			sum += value;
+	}, &sumDone);
+	jobSystem.wait(sumDone);
+	CHECK(firstDone.done() && secondDone.done());
+	CHECK(sum == count * (count + 1));
+
+	// A dependency that already finished starts the job right away
+	JobCounter idle, after;
+	std::atomic<bool> ran(false);
+	jobSystem.runAfter(idle, [&ran]() { ran = true; }, &after);
+	jobSystem.wait(after);
+	CHECK(ran);
+}
+
+static void testCommandList()
+{
+	// Redundant binds within a list are dropped, draws never are
+	CommandList list;
+	for (int i = 0; i < 4; i++)
+	{
+		list.useProgram(1);
+		list.bindVertexArray(2);
+		list.bindUniformRange(1, 3, 256 * (i / 2), 144);
+		list.drawElements(36);
+	}
+	int draws = 0, programs = 0, ranges = 0;
+	for (const Command& command : list.commands)
+	{
+		draws += command.type == CMD_DRAW_ELEMENTS;
+		programs += command.type == CMD_USE_PROGRAM;
+		ranges += command.type == CMD_BIND_UNIFORM_RANGE;
+	}
+	CHECK(draws == 4);
+	CHECK(programs == 1);
+	CHECK(ranges == 2);
+
+	// Parallel recording draws the same as a serial one
+	auto record = [](CommandList& out, int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			out.useProgram(1 + i / 500);
+			out.bindVertexArray(1 + i % 3);
+			out.bindUniformRange(1, 7, 256 * i, 144);
+			out.drawElements(36 + i % 5);
+		}
+	};
+	CommandList serial, parallel;
+	record(serial, 0, 2000);
+	ParallelRecorder recorder;
+	recorder.record(parallel, 2000, 64, record);
+	CountingBackend serialCounts, parallelCounts;
+	serial.execute(serialCounts);
+	parallel.execute(parallelCounts);
+	CHECK(serialCounts.calls[CMD_DRAW_ELEMENTS] == 2000);
+	CHECK(parallelCounts.calls[CMD_DRAW_ELEMENTS] == 2000);
+	CHECK(serialCounts.elements == parallelCounts.elements);
+	CHECK(serialCounts.hash == parallelCounts.hash);
+
+	// A range that only differs in size is a different bind
+	CommandList full, partial;
+	full.bindUniformRange(1, 7, 0, 144);
+	full.drawElements(36);
+	partial.bindUniformRange(1, 7, 0, 144);
+	partial.bindUniformRange(1, 7, 0, 64);
+	partial.drawElements(36);
+	CountingBackend fullCounts, partialCounts;
+	full.execute(fullCounts);
+	partial.execute(partialCounts);
+	CHECK(partialCounts.calls[CMD_BIND_UNIFORM_RANGE] == 2);
+	CHECK(fullCounts.hash != partialCounts.hash);
+}
+
+static void testCameraPath()
+{
+	CameraPath path;
+	path.keys = { { 0.0f, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) }, { 2.0f, glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(4.0f, 0.0f, -1.0f) } };
+	glm::vec3 pos, target;
+	path.sample(1.0f, pos, target);
+	CHECK(glm::length(pos - glm::vec3(2.0f, 0.0f, 0.0f)) < 1e-5f);
+	CHECK(glm::length(target - glm::vec3(2.0f, 0.0f, -1.0f)) < 1e-5f);
+	// Outside the keys the first and last ones hold
+	path.sample(-1.0f, pos, target);
+	CHECK(pos == glm::vec3(0.0f));
+	path.sample(5.0f, pos, target);
+	CHECK(pos == glm::vec3(4.0f, 0.0f, 0.0f));
+}
+
+static void testFrameWriter()
+{
+	// Bottom row red, top row white
+	const int width = 2, height = 2;
+	unsigned char rgba[width * height * 4];
+	for (int i = 0; i < width * height; i++)
+	{
+		bool bottom = i < width;
+		unsigned char pixel[4] = { 255, (unsigned char)(bottom ? 0 : 255), (unsigned char)(bottom ? 0 : 255), 255 };
+		memcpy(rgba + i * 4, pixel, 4);
+	}
+	std::vector<unsigned char> rgb;
+	FrameWriter::flipToRGB(width, height, rgba, rgb);
+	CHECK(rgb.size() == width * height * 3);
+	CHECK(rgb[0] == 255 && rgb[1] == 255 && rgb[2] == 255);
+	CHECK(rgb[6] == 255 && rgb[7] == 0 && rgb[8] == 0);
+
+	std::vector<unsigned char> png;
+	FrameWriter::encodePNG(width, height, rgb, png);
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	CHECK(png.size() > 8 && memcmp(png.data(), signature, 8) == 0);
+
+	// White is full luma and neutral chroma
+	std::vector<unsigned char> white(width * height * 3, 255), yuv;
+	FrameWriter::encodeYUV420(width, height, white, yuv);
+	CHECK(yuv.size() == width * height + 2);
+	CHECK(yuv[0] == 255 && yuv[3] == 255);
+	CHECK(yuv[4] >= 127 && yuv[4] <= 129 && yuv[5] >= 127 && yuv[5] <= 129);
+}
+
+static void testGLStats()
+{
+	GLStats stats;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		stats.setPass(STATS_PASS_OBJECTS);
+		for (int i = 0; i <= frame; i++)
+			stats.draw(GL_TRIANGLES, 36);
+		stats.setPass(STATS_PASS_SHADOWS);
+		stats.draw(GL_TRIANGLE_STRIP, 4);
+		stats.endFrame(frame);
+	}
+	const GLStatsSummary& summary = stats.summary();
+	CHECK(summary.frames == 3);
+	CHECK(summary.last.values[STATS_PASS_OBJECTS][STAT_DRAWS] == 3);
+	CHECK(summary.last.values[STATS_PASS_OBJECTS][STAT_TRIANGLES] == 36);
+	CHECK(summary.last.values[STATS_PASS_SHADOWS][STAT_TRIANGLES] == 2);
+	CHECK(summary.min[STATS_PASS_OBJECTS][STAT_DRAWS] == 1);
+	CHECK(summary.max[STATS_PASS_COUNT][STAT_DRAWS] == 4);
+	CHECK(summary.avg[STATS_PASS_OBJECTS][STAT_DRAWS] == 2.0);
+}
+
+static void testFixedTimestep()
+{
+	// 64 ticks a second keep the arithmetic exact
+	FixedTimestep timestep(64, 4);
+	// Whole ticks run, the rest carries over as the blend factor
+	CHECK(timestep.advance(2.5 / 64) == 2);
+	CHECK(timestep.alpha() == 0.5f);
+	CHECK(timestep.advance(0.5 / 64) == 1);
+	CHECK(timestep.alpha() == 0.0f);
+	// A long frame runs maxSteps ticks and drops the rest
+	CHECK(timestep.advance(1.0) == 4);
+	CHECK(timestep.droppedSeconds == 60.0 / 64);
+	CHECK(timestep.ticks == 7);
+	CHECK(timestep.time() == 7.0 / 64);
+}
+
+static void testRadixSort()
+{
+	// Negative, positive and equal keys, equal ones keep their index order
+	RadixSort sorter;
+	std::vector<float> keys = { 3.5f, -2.0f, 0.0f, -2.0f, 100.0f, -0.25f, 3.5f, -1000.0f };
+	std::vector<int> order;
+	sorter.sort(keys, order);
+	std::vector<int> expected(keys.size());
+	for (size_t i = 0; i < expected.size(); i++)
+		expected[i] = (int)i;
+	std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+	CHECK(order == expected);
+
+	// View depths share their high bytes, the skipped passes must not change the result
+	keys.clear();
+	for (int i = 0; i < 1000; i++)
+		keys.push_back(-1.0f - (i * 7919 % 1000) * 0.001f);
+	sorter.sort(keys, order);
+	bool ascending = order.size() == keys.size();
+	for (size_t i = 1; i < order.size(); i++)
+		ascending = ascending && keys[order[i - 1]] <= keys[order[i]];
+	CHECK(ascending);
+}
+
+static void testHLODSimplify()
+{
+	// A flat 64x64 quad grid over [0, 1]^2, clustered into cells of a quarter
+	const int quads = 64;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (int y = 0; y <= quads; y++)
+	{
+		for (int x = 0; x <= quads; x++)
+		{
+			Vertex vertex = {};
+			vertex.Position = glm::vec3((float)x / quads, (float)y / quads, 0.0f);
+			vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertices.push_back(vertex);
+		}
+	}
+	for (int y = 0; y < quads; y++)
+	{
+		for (int x = 0; x < quads; x++)
+		{
+			unsigned int corner = y * (quads + 1) + x;
+			indices.insert(indices.end(), { corner, corner + 1, corner + quads + 2, corner, corner + quads + 2, corner + quads + 1 });
+		}
+	}
+	std::vector<HLODInput> inputs = { { &vertices, &indices, glm::vec2(0.25f, 0.75f) } };
+	std::vector<Vertex> simplified;
+	std::vector<unsigned int> simplifiedIndices;
+	HLOD::simplify(inputs, glm::vec3(0.0f), 0.25f, simplified, simplifiedIndices);
+
+	// At most 5x5 cells are hit, each becomes one vertex inside the grid with the input's colour
+	CHECK(simplified.size() <= 25);
+	CHECK(!simplifiedIndices.empty() && simplifiedIndices.size() % 3 == 0);
+	CHECK(simplifiedIndices.size() / 3 < indices.size() / 3 / 50);
+	bool inside = true;
+	for (const Vertex& vertex : simplified)
+		inside = inside && vertex.Position.x >= 0.0f && vertex.Position.x <= 1.0f && vertex.Normal.z == 1.0f && vertex.TexCoords == glm::vec2(0.25f, 0.75f);
+	CHECK(inside);
+}
+
+static void testStaticBatchSplit()
+{
+	// 8x8 meshes of 1000 vertices a unit apart, batches of at most 8000 vertices and 2.6 units
+	std::vector<StaticBatchInput> inputs;
+	std::vector<int> order;
+	for (int i = 0; i < 64; i++)
+	{
+		glm::vec3 centre((float)(i % 8), 0.0f, (float)(i / 8));
+		inputs.push_back({ centre - 0.25f, centre + 0.25f, 1000 });
+		order.push_back(i);
+	}
+	std::vector<std::pair<int, int>> batches;
+	StaticBatcher::split(inputs, order, 0, 64, 8000, 2.6f, batches);
+
+	// Every mesh is in exactly one batch, each batch is a compact block of neighbours
+	std::vector<int> seen(64, 0);
+	bool fits = true;
+	for (const std::pair<int, int>& batch : batches)
+	{
+		glm::vec3 low = inputs[order[batch.first]].low, high = inputs[order[batch.first]].high;
+		int vertices = 0;
+		for (int i = batch.first; i < batch.first + batch.second; i++)
+		{
+			seen[order[i]]++;
+			low = glm::min(low, inputs[order[i]].low);
+			high = glm::max(high, inputs[order[i]].high);
+			vertices += inputs[order[i]].vertices;
+		}
+		fits = fits && vertices <= 8000 && high.x - low.x <= 2.6f && high.z - low.z <= 2.6f;
+	}
+	CHECK(std::count(seen.begin(), seen.end(), 1) == 64);
+	CHECK(fits);
+	CHECK(batches.size() <= 16);
+
+	// A mesh over the vertex budget is a batch of its own
+	inputs = { { glm::vec3(0.0f), glm::vec3(1.0f), 100000 } };
+	order = { 0 };
+	batches.clear();
+	StaticBatcher::split(inputs, order, 0, 1, 8000, 2.6f, batches);
+	CHECK(batches.size() == 1 && batches[0].second == 1);
+}
+
+int main()
+{
+	testParallelFor();
+	testJobDependencies();
+	testCommandList();
+	testCameraPath();
+	testFrameWriter();
+	testGLStats();
+	testFixedTimestep();
+	testRadixSort();
+	testHLODSimplify();
+	testStaticBatchSplit();
+	std::cout << checks - failures << " of " << checks << " checks passed" << std::endl;
+	return failures;
+}
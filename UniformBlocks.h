@@ -0,0 +1,66 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// CPU mirrors of the std140 uniform blocks declared in the shaders.
+// Only 16 byte members (vec4, ivec4, mat4) are used so the C++ layout matches std140 without padding tricks.
+
+// Binding points shared by every shader program
+#define FRAME_UBO_BINDING 0
+#define OBJECT_UBO_BINDING 1
+#define MATERIAL_UBO_BINDING 2
+#define SHADOW_UBO_BINDING 3
+
+// Must match SHADOW_CASCADES in the shaders, at most 4 so the splits fit one vec4
+#define SHADOW_CASCADES 3
+
+// "Frame" block, written once per frame
+struct FrameUniforms {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+	glm::vec4 lightPos;
+	glm::vec4 lightColor;
+	// near, far, slice scale, slice bias of the light clusters
+	glm::vec4 clusterParams;
+	GLint clusterDims[4];
+	glm::vec4 screenSize;
+};
+
+// "Shadows" block, written once per frame by CascadedShadowMap
+struct ShadowUniforms {
+	glm::mat4 lightSpace[SHADOW_CASCADES];
+	// view depth where each cascade ends
+	glm::vec4 cascadeSplits;
+	// world size of one shadow texel per cascade
+	glm::vec4 cascadeTexel;
+	// depth bias, normal bias in texels, enabled, cascade count
+	glm::vec4 shadowParams;
+};
+
+// "Object" block, written once per draw
+struct ObjectUniforms {
+	glm::mat4 model;
+	// inverse transpose of the model's upper 3x3, stored as a mat4 so the columns stay 16 bytes
+	glm::mat4 normalMatrix;
+	glm::vec4 color;
+};
+
+// Normal matrix of a model matrix, computed once per object instead of per vertex.
+// Rotation with uniform scale s only needs the upper 3x3 divided by s^2, anything
+// else (non-uniform scale, shear) pays for the full inverse.
+inline glm::mat4 normalMatrix(const glm::mat4& model)
+{
+	glm::mat3 m(model);
+	float xx = glm::dot(m[0], m[0]), yy = glm::dot(m[1], m[1]), zz = glm::dot(m[2], m[2]);
+	float epsilon = 1e-4f * xx;
+	bool uniformScale = glm::abs(xx - yy) <= epsilon && glm::abs(xx - zz) <= epsilon
+		&& glm::abs(glm::dot(m[0], m[1])) <= epsilon && glm::abs(glm::dot(m[0], m[2])) <= epsilon && glm::abs(glm::dot(m[1], m[2])) <= epsilon;
+	if (uniformScale && xx > 0.0f)
+		return glm::mat4(m / xx);
+	return glm::mat4(glm::transpose(glm::inverse(m)));
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include"WeightedOIT.h"
+#include"GLStats.h"
+
+WeightedOIT::WeightedOIT()
+	: FBO(0), accum(0), weight(0), width(0), height(0), depth(0), emptyVAO(0)
+{
+}
+
+static GLuint createTarget(GLenum internalFormat, GLenum format, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_HALF_FLOAT, NULL);
+	// The composite pass reads exactly one texel per pixel
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void WeightedOIT::resize(int width, int height, GLuint depth)
+{
+	if (FBO && width == this->width && height == this->height && depth == this->depth)
+		return;
+	Delete();
+	this->width = width;
+	this->height = height;
+	this->depth = depth;
+
+	accum = createTarget(GL_RGBA16F, GL_RGBA, width, height);
+	weight = createTarget(GL_R16F, GL_RED, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Depth tests against the opaque scene, the renderbuffer belongs to the scene target
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accum, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weight, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR: weighted OIT framebuffer is incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+void WeightedOIT::begin()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, width, height);
+	// Nothing accumulated and fully revealed
+	const GLfloat clearAccum[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLfloat clearWeight[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clearAccum);
+	glClearBufferfv(GL_COLOR, 1, clearWeight);
+
+	// rgb of both targets add up, alpha multiplies by (1 - alpha)
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedOIT::setupShader(Shader& shader)
+{
+	shader.Activate();
+	shader.setInt("accumTexture", OIT_ACCUM_UNIT);
+	shader.setInt("weightTexture", OIT_WEIGHT_UNIT);
+}
+
+void WeightedOIT::composite(Shader& shader, GLuint framebuffer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glActiveTexture(GL_TEXTURE0 + OIT_ACCUM_UNIT);
+	glBindTexture(GL_TEXTURE_2D, accum);
+	glActiveTexture(GL_TEXTURE0 + OIT_WEIGHT_UNIT);
+	glBindTexture(GL_TEXTURE_2D, weight);
+	glActiveTexture(GL_TEXTURE0);
+
+	// The shader outputs the average colour and the revealage: scene * revealage + colour * (1 - revealage)
+	glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+	glDepthFunc(GL_ALWAYS);
+	shader.Activate();
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+}
+
+void WeightedOIT::Delete()
+{
+	if (FBO)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		GLuint targets[2] = { accum, weight };
+		glDeleteTextures(2, targets);
+		glDeleteVertexArrays(1, &emptyVAO);
+	}
+	FBO = accum = weight = emptyVAO = 0;
+	depth = 0;
+}
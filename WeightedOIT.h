@@ -0,0 +1,51 @@
+#ifndef WEIGHTED_OIT_CLASS_H
+#define WEIGHTED_OIT_CLASS_H
+
+#include<glad/glad.h>
+
+#include "shaderClass.h"
+
+// Units of the accumulation targets in the composite pass. Shared with the G-buffer, whose
+// lighting pass binds its own targets every frame before this one runs.
+#define OIT_ACCUM_UNIT 11
+#define OIT_WEIGHT_UNIT 12
+
+enum TransparencyMode {
+	TRANSPARENCY_SORTED = 0,
+	TRANSPARENCY_WEIGHTED = 1
+};
+
+// Targets of weighted blended order-independent transparency (McGuire and Bavoil 2013):
+//   accum   RGBA16F  rgb sum of colour * alpha * weight, a the product of (1 - alpha)
+//   weight  R16F     sum of alpha * weight
+//
+// The blended draws add into them in any order with the WEIGHTED_OIT variants of lit.frag,
+// so they need no sorting, and composite() blends the weighted average colour over the
+// scene. GL 3.3 has one blend state for all targets, which is why the revealage product
+// rides in the alpha of accum. Layers close in depth and opacity blend approximately.
+class WeightedOIT
+{
+public:
+	GLuint FBO;
+	GLuint accum, weight;
+	int width, height;
+
+	WeightedOIT();
+
+	// (Re)creates the targets around the scene's depth renderbuffer, a no-op when nothing changed
+	void resize(int width, int height, GLuint depth);
+	// Binds and clears the targets and sets the accumulation blend. Depth writes must be off.
+	void begin();
+	// Blends the transparent layers over framebuffer with a fullscreen triangle, leaves it bound
+	void composite(Shader& shader, GLuint framebuffer);
+	// Points the composite program's samplers at their units, once
+	void setupShader(Shader& shader);
+	void Delete();
+
+private:
+	GLuint depth;
+	// Core profile needs a VAO bound even when the vertex shader makes up its vertices
+	GLuint emptyVAO;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#version 330 core
+// Depth only, the prepass writes no color
+
+void main()
+{
+}
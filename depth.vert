@@ -0,0 +1,29 @@
+#version 330 core
+// Depth prepass and overdraw view. Reads only the position stream, see Mesh::depthVAO.
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterParams;   // near, far, slice scale, slice bias
+    ivec4 clusterDims;    // tiles x, tiles y, depth slices
+    vec4 screenSize;      // viewport width, height
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;
+};
+
+// Same expression as lit.vert, both invariant so the lit passes hit the prepass depth exactly
+invariant gl_Position;
+
+void main()
+{
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
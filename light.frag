@@ -1,9 +1,18 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec3 lightColor;
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterParams;   // near, far, slice scale, slice bias
+    ivec4 clusterDims;    // tiles x, tiles y, depth slices
+    vec4 screenSize;      // viewport width, height
+};
 
 void main()
 {
-    FragColor = vec4((lightColor), 1.0); 
+    FragColor = vec4((lightColor.rgb), 1.0); 
 }
\ No newline at end of file
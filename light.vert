@@ -1,9 +1,22 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterParams;   // near, far, slice scale, slice bias
+    ivec4 clusterDims;    // tiles x, tiles y, depth slices
+    vec4 screenSize;      // viewport width, height
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;
+};
 
 void main()
 {
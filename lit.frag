@@ -0,0 +1,274 @@
+#version 330 core
+// Phong lighting of everything in the scene, as one source compiled into variants.
+// ShaderPermutations inserts a #define per feature bit (ShaderPermutations.h):
+//
+//   TEXTURED           surface colour from the material table, otherwise objectColor
+//   GBUFFER            writes the G-buffer instead of shading
+//   DEFERRED_LIGHTING  fullscreen pass shading the G-buffer
+//   CLUSTERED_LIGHTS   adds the dynamic lights of the fragment's cluster
+//   SHADOWS            main light shadowed by the cascaded shadow map
+//   WEIGHTED_OIT       writes the weighted blended transparency targets instead of a colour
+
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterParams;   // near, far, slice scale, slice bias
+    ivec4 clusterDims;    // tiles x, tiles y, depth slices
+    vec4 screenSize;      // viewport width, height
+};
+
+#define SHADOW_CASCADES 3   // must match UniformBlocks.h
+
+#ifdef DEFERRED_LIGHTING
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+#else
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+#endif
+
+#ifdef GBUFFER
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+#elif defined(WEIGHTED_OIT)
+layout (location = 0) out vec4 accum;
+layout (location = 1) out vec4 weight;
+#else
+out vec4 FragColor;
+#endif
+
+#ifdef TEXTURED
+in vec2 TexCoords;
+
+#define MAX_MATERIALS 256
+
+struct Material {
+    vec4 baseColor;
+    vec4 uvRect;      // xy offset, zw scale inside the layer (atlas cells)
+    ivec4 layer;      // array, layer, atlas flag, bits of the alpha cutoff
+};
+
+layout (std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+
+uniform sampler2DArray materialArrays[8];
+uniform int materialIndex;
+
+// GLSL 3.30 only allows constant sampler array indices
+vec4 sampleArray(int array, vec3 coord)
+{
+    switch (array) {
+        case 0: return texture(materialArrays[0], coord);
+        case 1: return texture(materialArrays[1], coord);
+        case 2: return texture(materialArrays[2], coord);
+        case 3: return texture(materialArrays[3], coord);
+        case 4: return texture(materialArrays[4], coord);
+        case 5: return texture(materialArrays[5], coord);
+        case 6: return texture(materialArrays[6], coord);
+        default: return texture(materialArrays[7], coord);
+    }
+}
+
+vec4 sampleMaterial(Material mat, vec2 uv)
+{
+    if (mat.layer.x < 0)
+        return mat.baseColor;
+    // Atlas cells repeat inside their own rect, full layers use the sampler's wrap mode
+    vec2 st = mat.layer.z != 0 ? mat.uvRect.xy + fract(uv) * mat.uvRect.zw : uv;
+    return sampleArray(mat.layer.x, vec3(st, float(mat.layer.y))) * mat.baseColor;
+}
+#endif
+
+#ifdef GBUFFER
+// Octahedral mapping, a unit normal in two channels
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+#endif
+
+#ifdef DEFERRED_LIGHTING
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+// World position from the depth buffer, using the perspective terms of the projection
+vec3 reconstructPosition(vec2 uv, float depth)
+{
+    vec3 ndc = vec3(uv, depth) * 2.0 - 1.0;
+    float viewZ = -projection[3][2] / (ndc.z + projection[2][2]);
+    vec3 viewSpace = vec3(ndc.x * -viewZ / projection[0][0], ndc.y * -viewZ / projection[1][1], viewZ);
+    // view is a rigid transform, its inverse is the transposed rotation
+    return transpose(mat3(view)) * (viewSpace - view[3].xyz);
+}
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+uniform samplerBuffer lightData;     // 3 texels per light
+uniform usamplerBuffer lightGrid;    // offset, count per cluster
+uniform usamplerBuffer lightIndices;
+
+// Diffuse + specular of the clustered point/spot lights covering this fragment
+vec3 clusteredLights(vec3 fragPos, vec3 norm, vec3 viewDir, float specularStrength, float shininess)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int slice = int(max(log(depth) * clusterParams.z + clusterParams.w, 0.0));
+    ivec2 tile = ivec2(gl_FragCoord.xy / screenSize.xy * vec2(clusterDims.xy));
+    ivec3 cell = min(ivec3(tile, slice), clusterDims.xyz - 1);
+    int cluster = cell.x + clusterDims.x * (cell.y + clusterDims.y * cell.z);
+
+    uvec2 range = texelFetch(lightGrid, cluster).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 posRadius = texelFetch(lightData, light * 3);
+        vec4 colorInner = texelFetch(lightData, light * 3 + 1);
+        vec4 dirOuter = texelFetch(lightData, light * 3 + 2);
+
+        vec3 toLight = posRadius.xyz - fragPos;
+        float dist = length(toLight);
+        if (dist >= posRadius.w)
+            continue;
+        vec3 dir = toLight / dist;
+
+        // Smooth window so the light reaches exactly zero at its radius
+        float falloff = clamp(1.0 - pow(dist / posRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = falloff * falloff / (1.0 + dist * dist);
+        if (dirOuter.w > -1.5)
+            attenuation *= smoothstep(dirOuter.w, colorInner.w, dot(-dir, dirOuter.xyz));
+
+        float diff = max(dot(norm, dir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-dir, norm)), 0.0), shininess);
+        result += (diff + specularStrength * spec) * colorInner.rgb * attenuation;
+    }
+    return result;
+}
+#endif
+
+#ifdef SHADOWS
+layout (std140) uniform Shadows {
+    mat4 lightSpace[SHADOW_CASCADES];
+    vec4 cascadeSplits;   // view depth where each cascade ends
+    vec4 cascadeTexel;    // world size of one shadow texel per cascade
+    vec4 shadowParams;    // depth bias, normal bias in texels, enabled, cascade count
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+// Main light visibility, 1 lit and 0 fully shadowed
+float mainLightShadow(vec3 fragPos, vec3 norm)
+{
+    if (shadowParams.z == 0.0)
+        return 1.0;
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADES && depth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == SHADOW_CASCADES)
+        return 1.0;
+
+    // Offset along the normal by the cascade's texel size against acne on slopes
+    vec3 offsetPos = fragPos + norm * cascadeTexel[cascade] * shadowParams.y;
+    vec3 coord = (lightSpace[cascade] * vec4(offsetPos, 1.0)).xyz * 0.5 + 0.5;
+    float texel = 1.0 / float(textureSize(shadowMap, 0).x);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            lit += texture(shadowMap, vec4(coord.xy + vec2(x, y) * texel, float(cascade), coord.z - shadowParams.x));
+    return lit / 9.0;
+}
+#endif
+
+// Main light plus the optional shadow and dynamic lights, multiplied by the surface colour
+vec3 shade(vec3 albedo, vec3 fragPos, vec3 norm, float ambientStrength, float specularStrength, float shininess)
+{
+    vec3 ambient = ambientStrength * lightColor.rgb;
+
+    vec3 lightDir = normalize(lightPos.xyz - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor.rgb;
+
+    vec3 viewDir = normalize(viewPos.xyz - fragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = specularStrength * spec * lightColor.rgb;
+
+    float shadow = 1.0;
+#ifdef SHADOWS
+    shadow = mainLightShadow(fragPos, norm);
+#endif
+    vec3 lights = vec3(0.0);
+#ifdef CLUSTERED_LIGHTS
+    lights = clusteredLights(fragPos, norm, viewDir, specularStrength, shininess);
+#endif
+
+    return (ambient + shadow * (diffuse + specular) + lights) * albedo;
+}
+
+void main()
+{
+#ifdef DEFERRED_LIGHTING
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth >= 1.0)
+        discard;
+    gl_FragDepth = depth;
+
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec4 normalSpec = texelFetch(gNormal, pixel, 0);
+    vec3 fragPos = reconstructPosition(gl_FragCoord.xy / screenSize.xy, depth);
+    FragColor = vec4(shade(albedo.rgb, fragPos, decodeNormal(normalSpec.xy), albedo.a, normalSpec.z, normalSpec.w), 1.0);
+#else
+    // Material constants: textured model meshes vs plain scene objects
+#ifdef TEXTURED
+    vec4 surface = sampleMaterial(materials[materialIndex], TexCoords);
+    // Alpha tested (glTF MASK) materials cut out their texels, the cutoff is 0 for all others
+    if (surface.a < intBitsToFloat(materials[materialIndex].layer.w))
+        discard;
+    float ambientStrength = 0.3;
+    float specularStrength = 0.5;
+    float shininess = 32.0;
+#else
+    vec4 surface = objectColor;
+    float ambientStrength = 0.2;
+    float specularStrength = 0.9;
+    float shininess = 128.0;
+#endif
+    vec3 norm = normalize(Normal);
+
+#ifdef GBUFFER
+    gAlbedo = vec4(surface.rgb, ambientStrength);
+    gNormal = vec4(encodeNormal(norm), specularStrength, shininess);
+#elif defined(WEIGHTED_OIT)
+    vec3 color = shade(surface.rgb, FragPos, norm, ambientStrength, specularStrength, shininess);
+    // Depth weight of McGuire and Bavoil (equation 9), nearer and more opaque layers count more
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    float w = surface.a * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+    accum = vec4(color * surface.a * w, surface.a);
+    weight = vec4(surface.a * w);
+#else
+    FragColor = vec4(shade(surface.rgb, FragPos, norm, ambientStrength, specularStrength, shininess), surface.a);
+#endif
+#endif
+}
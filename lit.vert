@@ -0,0 +1,62 @@
+#version 330 core
+// Vertex stage of every lit program. ShaderPermutations inserts the feature defines,
+// see lit.frag for the list.
+
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterParams;   // near, far, slice scale, slice bias
+    ivec4 clusterDims;    // tiles x, tiles y, depth slices
+    vec4 screenSize;      // viewport width, height
+};
+
+#ifdef DEFERRED_LIGHTING
+
+// Fullscreen triangle generated from gl_VertexID, drawn without vertex buffers
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+
+#else
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+#ifdef TEXTURED
+layout (location = 2) in vec2 aTexCoords;
+out vec2 TexCoords;
+#endif
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;    // inverse transpose of model, computed on the CPU
+    vec4 objectColor;
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// Matches depth.vert, so the depth prepass and the lit passes compute the same depth
+invariant gl_Position;
+
+void main()
+{
+#ifdef TEXTURED
+    TexCoords = aTexCoords;
+#endif
+    FragPos = vec3(model * vec4(aPos, 1.0));
+#ifdef INVERSE_NORMAL_MATRIX
+    // Old per-vertex path, only kept as the baseline of the vertices benchmark
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+#else
+    Normal = mat3(normalMatrix) * aNormal;
+#endif
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+
+#endif
@@ -7,6 +7,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shaderClass.h"
+#include "CommandList.h"
+#include "GLStats.h"
 
 #include <string>
 #include <vector>
@@ -44,6 +46,16 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // positions only, packed into their own buffer for depth-only passes
+    unsigned int depthVAO;
+    // centre of the bounding box, to sort draws by depth
+    glm::vec3 center = glm::vec3(0.0f);
+    // index into the MaterialTable, -1 when the mesh binds its own textures
+    int materialIndex = -1;
+    // the material blends, the renderer draws the mesh in its transparent pass
+    bool blended = false;
+    // the material discards texels under an alpha cutoff, the depth prepass leaves the mesh out
+    bool alphaTested = false;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -94,9 +106,44 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render the mesh with a material selected by index, the material arrays are already bound
+    void Draw(GLint materialLocation)
+    {
+        glUniform1i(materialLocation, materialIndex);
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    // the same draw recorded into a command list, safe on any thread
+    void Record(CommandList& list, GLint materialLocation) const
+    {
+        list.setInt(materialLocation, materialIndex);
+        list.bindVertexArray(VAO);
+        list.drawElements(static_cast<GLsizei>(indices.size()));
+    }
+
+    // the depth-only draw, any program that reads just the position works
+    void RecordDepth(CommandList& list) const
+    {
+        list.bindVertexArray(depthVAO);
+        list.drawElements(static_cast<GLsizei>(indices.size()));
+    }
+
+    // frees the GL objects, e.g. once the mesh was merged into a static batch
+    void Delete()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &positionVBO);
+        VAO = depthVAO = VBO = EBO = positionVBO = 0;
+    }
+
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO, EBO, positionVBO;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -140,6 +187,25 @@ private:
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+
+        // 12 bytes a vertex instead of the whole Vertex, a depth pass fetches far less memory
+        vector<glm::vec3> positions(vertices.size());
+        glm::vec3 low(0.0f), high(0.0f);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].Position;
+            low = i ? glm::min(low, positions[i]) : positions[i];
+            high = i ? glm::max(high, positions[i]) : positions[i];
+        }
+        center = (low + high) * 0.5f;
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
         glBindVertexArray(0);
     }
 };
@@ -1,46 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-
-in vec2 TexCoords;
-in vec3 FragPos;
-in vec3 Normal;
-
-uniform sampler2D texture_diffuse1;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform vec3 viewPos;
-
-
-
-void main()
-{    
-    vec4 texColor;
-    
-    // Try to sample the texture
-    texColor = texture(texture_diffuse1, TexCoords);
-    
-   
-    
-    // Basic lighting calculation
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    
-    // Ambient lighting
-    float ambientStrength = 0.3;
-    vec3 ambient = ambientStrength * lightColor;
-    
-    // Diffuse lighting
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
-    
-    // Specular lighting
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = 0.5 * spec * lightColor;
-    
-    // Combine lighting with texture/color
-    vec3 result = (ambient + diffuse + specular) * texColor.rgb;
-    
-    FragColor = vec4(result, texColor.a);
-}
\ No newline at end of file
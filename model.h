@@ -11,6 +11,7 @@
 
 #include "mesh.h"
 #include "shaderClass.h"
+#include "Material.h"
 
 #include <string>
 #include <fstream>
@@ -22,6 +23,8 @@ using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false, class Model* model = nullptr);
 
+class HLOD;
+
 class Model
 {
 public:
@@ -31,13 +34,18 @@ public:
     vector<Texture> textures_loaded;
     vector<Mesh>    meshes;
     string directory;
+    string sourcePath;
     bool gammaCorrection;
 
     // Keep scene and importer as members for embedded texture access
     const aiScene* scene;
     Assimp::Importer importer;
+    // When set, textures are packed into the table and meshes only carry a material index
+    MaterialTable* materialTable;
+    // Proxies of distant mesh groups, built after loading, the renderer then picks meshes through it
+    HLOD* hlod = nullptr;
 
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false, MaterialTable* materials = nullptr) : gammaCorrection(gamma), materialTable(materials)
     {
         pos = glm::vec3(0.0f, 0.0f, 0.0f);
         angle = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -45,19 +53,63 @@ public:
         loadModel(path);
     }
 
+    // Geometry built in code instead of imported, meshes index into the materials of the table
+    Model(vector<Mesh> generated, MaterialTable* materials) : gammaCorrection(false), scene(nullptr), materialTable(materials)
+    {
+        pos = glm::vec3(0.0f, 0.0f, 0.0f);
+        angle = glm::vec3(0.0f, 0.0f, 0.0f);
+        meshes = std::move(generated);
+    }
+
     void Draw(Shader& shader)
     {
+        if (materialTable)
+        {
+            GLint materialLocation = glGetUniformLocation(shader.ID, "materialIndex");
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].Draw(materialLocation);
+            return;
+        }
         for (unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // Records the material table draws of meshes [begin, end), safe on any thread. Models
+    // without a table bind their own textures and can only be drawn with Draw().
+    void Record(CommandList& list, GLint materialLocation, size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; i++)
+            meshes[i].Record(list, materialLocation);
+    }
+
     unsigned int loadEmbeddedTexture(const char* path);
 
+    // Transformed vertices and indices of one mesh, pure CPU work that runs on the job system
+    static void processVertices(const aiMesh* mesh, const glm::mat4& transform, vector<Vertex>& vertices, vector<unsigned int>& indices);
+
 private:
+    // A mesh of the node tree with its accumulated transform
+    struct NodeMesh {
+        aiMesh* mesh;
+        glm::mat4 transform;
+    };
+    // Diffuse texture of a material, decoded on a job before it goes into the table
+    struct DecodedTexture {
+        bool valid = false;
+        int width = 0, height = 0;
+        vector<unsigned char> rgba;
+    };
+
     void loadModel(string const& path);
     void processNode(aiNode* node, const aiScene* scene, glm::mat4 parentTransform = glm::mat4(1.0f));
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 transform);
+    Mesh processMesh(aiMesh* mesh, const aiScene* scene, vector<Vertex>& vertices, vector<unsigned int>& indices, vector<DecodedTexture>& decoded);
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    int loadMaterial(unsigned int materialIndex, const aiScene* scene, DecodedTexture& decoded);
+    bool decodeTexture(const char* path, int& width, int& height, vector<unsigned char>& rgba);
+    // aiMaterial index -> MaterialTable index
+    std::map<unsigned int, int> materialIndices;
+    // Filled by processNode() in traversal order
+    vector<NodeMesh> nodeMeshes;
 
     // Helper function to convert aiMatrix4x4 to glm::mat4
     glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4& from) {
@@ -0,0 +1,19 @@
+#version 330 core
+// Composite of weighted blended transparency, see WeightedOIT.h. Blended over the scene
+// with GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA.
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+out vec4 FragColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumTexture, pixel, 0);
+    float revealage = accum.a;
+    // No transparent surface covers this pixel
+    if (revealage >= 1.0)
+        discard;
+    float weight = texelFetch(weightTexture, pixel, 0).r;
+    FragColor = vec4(accum.rgb / max(weight, 1e-5), revealage);
+}
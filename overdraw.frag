@@ -0,0 +1,9 @@
+#version 330 core
+// Every fragment adds the same amount with additive blending, the brighter a pixel the more
+// often it was shaded
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(0.12, 0.06, 0.02, 1.0);
+}
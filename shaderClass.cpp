@@ -1,4 +1,10 @@
 #include "shaderClass.h"
+#include "UniformBlocks.h"
+#include "ShaderCache.h"
+#include "GLExt.h"
+#include "GLStats.h"
+
+#include<chrono>
 
 std::string get_file_contents(const char* filename){
 	std::ifstream in(filename, std::ios::binary);
@@ -15,31 +21,109 @@ std::string get_file_contents(const char* filename){
 	throw(errno);
 }
 
-Shader::Shader(const char* vertexFile, const char* fragmentFile) {
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
-	// Convert the shader source strings into character arrays
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
+// Inserts the defines right after the #version line, which has to stay first
+static std::string applyDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+	size_t lineEnd = source.find('\n');
+	if (lineEnd == std::string::npos)
+		return source + "\n" + defines;
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+Shader::Shader()
+	: ID(0), buildMs(0.0), vertexShader(0), fragmentShader(0), cached(false)
+{
+}
 
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	glCompileShader(vertexShader);
-	compileErrors(vertexShader, "VERTEX");
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines)
+	: Shader()
+{
+	begin(vertexFile, fragmentFile, defines);
+	finish();
+}
 
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	glCompileShader(fragmentShader);
-	compileErrors(fragmentShader, "FRAGMENT");
+void Shader::begin(const char* vertexFile, const char* fragmentFile, const std::string& defines) {
+	auto start = std::chrono::steady_clock::now();
+	std::string vertexCode = applyDefines(get_file_contents(vertexFile), defines);
+	std::string fragmentCode = applyDefines(get_file_contents(fragmentFile), defines);
 
 	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
-	compileErrors(ID, "PROGRAM");
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// A cached binary skips compiling and linking entirely
+	cacheKey.clear();
+	cached = false;
+	if (shaderCache.enabled && glExt.programBinary)
+	{
+		cacheKey = shaderCache.makeKey(vertexCode, fragmentCode);
+		cached = shaderCache.load(ID, cacheKey);
+	}
+
+	if (!cached)
+	{
+		// Convert the shader source strings into character arrays
+		const char* vertexSource = vertexCode.c_str();
+		const char* fragmentSource = fragmentCode.c_str();
+
+		// No status queries until finish(), they would wait for the driver
+		vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &vertexSource, NULL);
+		glCompileShader(vertexShader);
+
+		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+		glCompileShader(fragmentShader);
+
+		glAttachShader(ID, vertexShader);
+		glAttachShader(ID, fragmentShader);
+		if (!cacheKey.empty())
+			glExt.ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(ID);
+	}
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Shader::isReady() {
+	if (cached || !vertexShader || !glExt.parallelShaderCompile)
+		return true;
+	GLint done = GL_FALSE;
+	glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+void Shader::finish() {
+	auto start = std::chrono::steady_clock::now();
+	if (vertexShader)
+	{
+		compileErrors(vertexShader, "VERTEX");
+		compileErrors(fragmentShader, "FRAGMENT");
+		compileErrors(ID, "PROGRAM");
+
+		glDetachShader(ID, vertexShader);
+		glDetachShader(ID, fragmentShader);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		vertexShader = fragmentShader = 0;
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+		if (linked && !cacheKey.empty())
+			shaderCache.store(ID, cacheKey);
+	}
+
+	// Block bindings are program state, a loaded binary needs them set again too
+	bindUniformBlock("Frame", FRAME_UBO_BINDING);
+	bindUniformBlock("Object", OBJECT_UBO_BINDING);
+	bindUniformBlock("Materials", MATERIAL_UBO_BINDING);
+	bindUniformBlock("Shadows", SHADOW_UBO_BINDING);
+
+	if (cached)
+		shaderCache.hits++;
+	else
+		shaderCache.misses++;
+	buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	shaderCache.totalMs += buildMs;
 }
 
 // Activates the Shader Program
@@ -52,6 +136,13 @@ void Shader::Delete(){
 	glDeleteProgram(ID);
 }
 
+void Shader::bindUniformBlock(const char* name, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(ID, name);
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, index, binding);
+}
+
 void Shader::compileErrors(unsigned int shader, const char* type)
 {
 	// Stores status of compilation
@@ -14,9 +14,25 @@ std::string get_file_contents(const char* filename);
 class Shader {
 public:
 	GLuint ID;
-	Shader(const char* vertexFile, const char* fragmentFile);
+	// CPU time spent creating the program, waits for the driver included
+	double buildMs;
+
+	// Empty, begin() creates the program
+	Shader();
+	// defines are "#define ..." lines inserted after the #version line of both stages
+	Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines = "");
+
+	// Two step creation for building many programs at once. begin() submits the compile
+	// and link without asking for their status, finish() waits for them and reports errors.
+	// With KHR_parallel_shader_compile the driver builds every begun program on its own
+	// threads and isReady() polls for completion without blocking.
+	void begin(const char* vertexFile, const char* fragmentFile, const std::string& defines = "");
+	bool isReady();
+	void finish();
 	void Activate();
 	void Delete();
+	// Points a uniform block at a binding index, blocks the program doesn't use are skipped
+	void bindUniformBlock(const char* name, GLuint binding);
 
         void setBool(const std::string& name, bool value);
 
@@ -51,6 +67,11 @@ public:
         void setMat4(const std::string& name, const glm::mat4& mat);
     
 private:
+	// Only set between begin() and finish()
+	GLuint vertexShader, fragmentShader;
+	std::string cacheKey;
+	bool cached;
+
 	// Checks if the different Shaders have compiled properly
 	void compileErrors(unsigned int shader, const char* type);
 };
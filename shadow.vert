@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 objectColor;
+};
+
+// Light-space matrix of the cascade being rendered
+uniform mat4 cascadeMatrix;
+
+void main()
+{
+    gl_Position = cascadeMatrix * model * vec4(aPos, 1.0);
+}